@@ -0,0 +1,594 @@
+/*
+ * simple_cli_bench.c
+ *
+ * Description: Microbenchmarks of Simple CLI parse/dispatch hot path.
+ *              Every case prints one result line:
+ *              {"bench":"lookup","param":100,"ops":..,"ns_per_op":..,"bytes_per_s":..,"allocs_per_op":..}
+ *              Run with "csv" argument to get CSV instead of JSON lines.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include "simple_cli.h"
+#include "simple_cli_trie.h"
+
+#define BENCH_REPEATS 			5							/*Each case is measured several times, best run is reported*/
+
+#ifndef UNUSED_PARAMETER
+	#define UNUSED_PARAMETER(x)    ((void)(x))
+#endif
+
+typedef void (*bench_f)(uint32_t param, uint64_t ops);
+
+typedef struct
+{
+	const char* 	name;
+	bench_f 		run;
+	uint32_t 		param;
+	uint64_t 		ops;						/*Operations per run*/
+	uint64_t 		bytes_per_op;				/*0 - throughput of bytes counted by the run, if any*/
+}bench_case_t;
+
+static bool csv_output;
+static volatile uintptr_t sink;					/*Keeps results of measured code alive*/
+static cli_registry_t Registry;
+SIMPLE_CLI_DEF (Session);
+
+/*Heap calls made by the measured code. Counted when linked with --wrap=malloc/calloc/realloc*/
+static uint64_t alloc_count;
+#ifdef BENCH_COUNT_ALLOCS
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t num, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __wrap_malloc(size_t size)
+{
+	++alloc_count;
+	return __real_malloc(size);
+}
+void* __wrap_calloc(size_t num, size_t size)
+{
+	++alloc_count;
+	return __real_calloc(num,size);
+}
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	++alloc_count;
+	return __real_realloc(ptr,size);
+}
+#endif
+
+static uint64_t MonotonicNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+}
+
+static uint32_t NullWrite(const char* data, size_t length)
+{
+	UNUSED_PARAMETER(data);
+	return (uint32_t)length;
+}
+
+static bool NullHandler(char *data, size_t length, void * _context)
+{
+	UNUSED_PARAMETER(_context);
+	sink+=(uintptr_t)data[0]+length;
+	return true;
+}
+
+static bool NopCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	UNUSED_PARAMETER(_context);
+	sink+=(uintptr_t)argv+self->cmd_ID;
+	return true;
+}
+
+/*Command lookup in a set of param commands*/
+static void BenchLookup(uint32_t param, uint64_t ops)
+{
+	char names[16][16];
+	for(uint32_t i=0;i<16;++i)
+		snprintf(names[i],sizeof(names[i]),"cmd%u",(unsigned)((i*7919u)%param));
+	for(uint64_t i=0;i<ops;++i)
+		sink+=(uintptr_t)FindRegistryCmd(&Registry,names[i&15]);
+}
+
+static void SetupLookup(uint32_t param)
+{
+	InitCliRegistry(&Registry);
+	cli_command_t cmd={.c_func=NopCmd};
+	for(uint32_t i=0;i<param;++i)
+	{
+		snprintf(cmd.cmd_name,sizeof(cmd.cmd_name),"cmd%u",(unsigned)i);
+		cmd.cmd_ID=(uint8_t)((i<255)?i+1:0);
+		AddRegistryCommand(&Registry,&cmd);
+	}
+}
+
+/*Unique prefix resolution through the names tree of param commands*/
+static cli_trie_t Trie;
+
+static void SetupPrefix(uint32_t param)
+{
+	SetupLookup(param);
+	BuildCliTrie(&Trie,&Registry);
+}
+
+static void BenchPrefix(uint32_t param, uint64_t ops)
+{
+	char names[16][16];
+	for(uint32_t i=0;i<16;++i)										/*"cmd1234" abbreviated by one symbol is unique*/
+	{
+		snprintf(names[i],sizeof(names[i]),"cmd%u",(unsigned)(param-1-i));
+		names[i][strlen(names[i])-1]='\0';
+	}
+	for(uint64_t i=0;i<ops;++i)
+		sink+=(uintptr_t)MatchTrieCmd(&Trie,names[i&15]);
+}
+
+/*Tokenizing, lookup and parsing of a command with all SIMCLI_MAX_ARGS options set*/
+static const char parse_line[]="config -a 12345 -b -42 -c 0x1F2E -d yes -e fast -f 2.5 -g 64k -h name.txt";
+static int32_t parse_a;
+static int32_t parse_b;
+static uint32_t parse_c;
+static bool parse_d;
+static uint8_t parse_e;
+static float parse_f;
+static uint32_t parse_g;
+static char parse_h[16];
+
+static bool ConfigCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	UNUSED_PARAMETER(_context);
+	self->args[0].value=&parse_a;
+	self->args[1].value=&parse_b;
+	self->args[2].value=&parse_c;
+	self->args[3].value=&parse_d;
+	self->args[4].value=&parse_e;
+	self->args[5].value=&parse_f;
+	self->args[6].value=&parse_g;
+	self->args[7].value=parse_h;
+	return ParseCmdArgs(argv,self)==SIM_CLI_OK;
+}
+
+static void SetupParse(uint32_t param)
+{
+	static const char* const speeds[]={"slow","fast",NULL};
+	UNUSED_PARAMETER(param);
+	InitCliRegistry(&Registry);
+	cli_command_t cmd=
+	{
+		.cmd_name="config",
+		.args_num=8,
+		.args={	{.arg_name="-a", .arg_type=ARG_UINT32},
+				{.arg_name="-b", .arg_type=ARG_INT32},
+				{.arg_name="-c", .arg_type=ARG_HEX},
+				{.arg_name="-d", .arg_type=ARG_BOOL},
+				{.arg_name="-e", .arg_type=ARG_ENUM, .enum_list=speeds},
+				{.arg_name="-f", .arg_type=ARG_FLOAT},
+				{.arg_name="-g", .arg_type=ARG_SIZE},
+				{.arg_name="-h", .arg_type=ARG_STRING, .value_size=sizeof(parse_h)}},
+		.c_func=ConfigCmd,
+		.cmd_ID=1
+	};
+	AddRegistryCommand(&Registry,&cmd);
+	InitCLIcontext(&Session,NullHandler,NullWrite,"Bench");
+	AttachCliRegistry(&Session,&Registry);
+}
+
+static void BenchParse(uint32_t param, uint64_t ops)
+{
+	char scratch[SIMCLI_MAX_CMD_LEN];
+	UNUSED_PARAMETER(param);
+	for(uint64_t i=0;i<ops;++i)
+		sink+=(uintptr_t)ProcessCommandBuf(parse_line,sizeof(parse_line)-1,scratch,sizeof(scratch),&Session);
+}
+
+#if (SIMCLI_USE_BINARY==1)
+/*Same command and values as parse_args, sent as binary frame with TLV arguments*/
+static uint8_t parse_frame[SIMCLI_MAX_CMD_LEN];
+static size_t parse_frame_size;
+
+static void SetupBinary(uint32_t param)
+{
+	cli_frame_writer_t writer;
+	uint32_t a=12345;
+	int32_t b=-42;
+	uint32_t c=0x1F2E;
+	uint8_t d=1;
+	uint8_t e=1;
+	float f=2.5f;
+	uint32_t g=64*1024;
+	SetupParse(param);
+	CliFrameBegin(&writer,parse_frame,sizeof(parse_frame),1);
+	CliFrameArg(&writer,1,&a,sizeof(a));
+	CliFrameArg(&writer,2,&b,sizeof(b));
+	CliFrameArg(&writer,3,&c,sizeof(c));
+	CliFrameArg(&writer,4,&d,sizeof(d));
+	CliFrameArg(&writer,5,&e,sizeof(e));
+	CliFrameArg(&writer,6,&f,sizeof(f));
+	CliFrameArg(&writer,7,&g,sizeof(g));
+	CliFrameArg(&writer,8,"name.txt",8);
+	parse_frame_size=CliFrameEnd(&writer);
+}
+
+static void BenchBinary(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	for(uint64_t i=0;i<ops;++i)
+		sink+=(uintptr_t)ProcessCommandFrame(parse_frame,parse_frame_size,&Session);
+}
+#endif
+
+/*Line framing of input delivered in chunks of param bytes. One op is one 4 KiB input block*/
+#define FRAME_INPUT_SIZE 		4096
+static char frame_input[FRAME_INPUT_SIZE];
+static char frame_work[FRAME_INPUT_SIZE];
+
+static void SetupFraming(uint32_t param)
+{
+	static const char line[]="sendfile -n 100 -f file.bin\r\n";
+	UNUSED_PARAMETER(param);
+	for(size_t i=0;i<FRAME_INPUT_SIZE;++i)
+		frame_input[i]=line[i%(sizeof(line)-1)];
+	InitCLIcontext(&Session,NullHandler,NullWrite,"Bench");
+}
+
+static void BenchFraming(uint32_t param, uint64_t ops)
+{
+	for(uint64_t i=0;i<ops;++i)
+	{
+		memcpy(frame_work,frame_input,FRAME_INPUT_SIZE);				/*Framer writes line terminators in place*/
+		for(size_t pos=0;pos<FRAME_INPUT_SIZE;pos+=param)
+		{
+			size_t chunk=FRAME_INPUT_SIZE-pos;
+			if(chunk>param)
+				chunk=param;
+			FeedContextHandler(&Session,&frame_work[pos],chunk);
+		}
+	}
+}
+
+/*Data context round trip: AcquireContext() followed by ReleaseContext()*/
+static Context_t bench_context;
+
+static void SetupContext(uint32_t param)
+{
+	UNUSED_PARAMETER(param);
+	strcpy(bench_context.Name,"bench");
+	bench_context.context_handler=NullHandler;
+	bench_context.bulk_handler=NULL;
+	bench_context.rx_window=0;
+	InitCLIcontext(&Session,NullHandler,NullWrite,"Bench");
+}
+
+static void BenchContext(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	for(uint64_t i=0;i<ops;++i)
+	{
+		AcquireContext(&Session,&bench_context);
+		ReleaseContext(&Session);
+	}
+}
+
+/*Bulk data flow: views of param bytes split into two segments are passed to data context*/
+#define BULK_RING_SIZE 			65536
+static char bulk_ring[BULK_RING_SIZE];
+
+static size_t BulkSink(const cli_data_view_t *view, bool *complete, void * _context)
+{
+	UNUSED_PARAMETER(_context);
+	*complete=false;
+	sink+=(uintptr_t)view->data[0][0];
+	return view->length[0]+view->length[1];
+}
+
+static void SetupBulk(uint32_t param)
+{
+	SetupContext(param);
+	bench_context.bulk_handler=BulkSink;
+	memset(bulk_ring,'x',sizeof(bulk_ring));
+	AcquireContext(&Session,&bench_context);
+}
+
+static void BenchBulk(uint32_t param, uint64_t ops)
+{
+	size_t pos=0;
+	for(uint64_t i=0;i<ops;++i)
+	{
+		cli_data_view_t view;
+		size_t first=BULK_RING_SIZE-pos;
+		if(first>param)
+			first=param;
+		view.data[0]=&bulk_ring[pos];
+		view.length[0]=first;
+		view.data[1]=bulk_ring;
+		view.length[1]=param-first;
+		CallContextBulk(&Session,&view);
+		pos=(pos+param)%BULK_RING_SIZE;
+	}
+}
+
+/*Data pipeline: chunk enters the top of param context levels and is passed down to the lowest one*/
+#define PIPE_CHUNK_SIZE 		256
+static char pipe_chunk[PIPE_CHUNK_SIZE];
+
+static bool PipeStage(char *data, size_t length, void * _context)
+{
+	data[0]++;
+	return PassDownContext(_context,data,length);
+}
+
+static bool PipeSink(char *data, size_t length, void * _context)
+{
+	UNUSED_PARAMETER(_context);
+	sink+=(uintptr_t)data[length-1];
+	return true;
+}
+
+static void SetupPipeline(uint32_t param)
+{
+	SetupContext(param);
+	bench_context.context_handler=PipeSink;
+	AcquireContext(&Session,&bench_context);
+	bench_context.context_handler=PipeStage;
+	for(uint32_t i=1;i<param;++i)
+		AcquireContext(&Session,&bench_context);
+	memset(pipe_chunk,'x',sizeof(pipe_chunk));
+}
+
+static void BenchPipeline(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	for(uint64_t i=0;i<ops;++i)
+		CallContextHandler(&Session,pipe_chunk,sizeof(pipe_chunk));
+}
+
+/*Flow control: sender streams into a data context whose handler queues data for a slow sink.
+  One op is one FLOW_TICK_NS tick of the link: sender may put FLOW_LINE_RATE bytes on it, sink drains
+  FLOW_SINK_RATE. Throughput is the rate of bytes drained by the sink, param is the receive window*/
+#define FLOW_TICK_NS 			1000
+#define FLOW_LINE_RATE 			1024
+#define FLOW_SINK_RATE 			256
+static char flow_chunk[FLOW_LINE_RATE];
+static uint32_t flow_capacity;					/*Sink queue size, bytes beyond it are lost*/
+static uint32_t flow_queue;						/*Bytes queued for the sink*/
+static uint32_t flow_credit;					/*Sender side credit*/
+static bool flow_paused;						/*Sender got XOFF*/
+static bool flow_enabled;
+static uint64_t flow_deadline;					/*End of current tick*/
+static uint64_t run_bytes;						/*Bytes moved by the run. Reported when bytes_per_op is 0*/
+
+static uint32_t FlowSender(const char* data, size_t length)
+{
+	size_t pos=0;
+	while(pos<length)
+	{
+		if((data[pos]==SIMCLI_FLOW_CREDIT)&&(pos+5<=length))
+		{
+			const uint8_t *grant=(const uint8_t*)&data[pos+1];
+			flow_credit+=(uint32_t)grant[0]|((uint32_t)grant[1]<<8)|((uint32_t)grant[2]<<16)|((uint32_t)grant[3]<<24);
+			pos+=5;
+			continue;
+		}
+		if(data[pos]==SIMCLI_FLOW_XOFF)
+			flow_paused=true;
+		else if(data[pos]==SIMCLI_FLOW_XON)
+			flow_paused=false;
+		++pos;
+	}
+	return (uint32_t)length;
+}
+
+static bool FlowSink(char *data, size_t length, void * _context)
+{
+	size_t room=flow_capacity-flow_queue;
+	if(length>room)
+		length=room;
+	sink+=(uintptr_t)data[0];
+	flow_queue+=(uint32_t)length;
+	if(flow_enabled)
+		CliFlowUpdate(_context,flow_queue);
+	return true;
+}
+
+static void SetupFlowMode(uint32_t param, bool enabled, cli_flow_mode_t mode)
+{
+	SetupContext(param);
+	InitCLIcontext(&Session,NullHandler,FlowSender,"Bench");
+	SetCliFlowMode(&Session,mode);
+	bench_context.context_handler=FlowSink;
+	bench_context.rx_window=enabled?param:0;
+	flow_capacity=param;
+	flow_queue=0;
+	flow_credit=0;
+	flow_paused=false;
+	flow_enabled=enabled;
+	memset(flow_chunk,'x',sizeof(flow_chunk));
+	AcquireContext(&Session,&bench_context);
+}
+
+static void SetupFlowPaced(uint32_t param)
+{
+	SetupFlowMode(param,false,CLI_FLOW_CREDIT);
+}
+
+static void SetupFlowCredit(uint32_t param)
+{
+	SetupFlowMode(param,true,CLI_FLOW_CREDIT);
+}
+
+static void SetupFlowXonXoff(uint32_t param)
+{
+	SetupFlowMode(param,true,CLI_FLOW_XONXOFF);
+}
+
+static void FlowTick(uint32_t send)
+{
+	if(send)
+		CallContextHandler(&Session,flow_chunk,send);
+	uint32_t drained=(flow_queue<FLOW_SINK_RATE)?flow_queue:FLOW_SINK_RATE;
+	flow_queue-=drained;
+	run_bytes+=drained;
+	if(flow_enabled)
+		CliFlowUpdate(&Session,flow_queue);
+	flow_deadline+=FLOW_TICK_NS;
+	while(MonotonicNs()<flow_deadline);
+}
+
+/*No flow control: sender can't know sink state and keeps to a safe fixed rate*/
+static void BenchFlowPaced(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	flow_deadline=MonotonicNs();
+	for(uint64_t i=0;i<ops;++i)
+		FlowTick(FLOW_SINK_RATE/2);
+}
+
+static void BenchFlowCredit(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	flow_deadline=MonotonicNs();
+	for(uint64_t i=0;i<ops;++i)
+	{
+		uint32_t send=(flow_credit<FLOW_LINE_RATE)?flow_credit:FLOW_LINE_RATE;
+		flow_credit-=send;
+		FlowTick(send);
+	}
+}
+
+static void BenchFlowXonXoff(uint32_t param, uint64_t ops)
+{
+	UNUSED_PARAMETER(param);
+	flow_deadline=MonotonicNs();
+	for(uint64_t i=0;i<ops;++i)
+		FlowTick(flow_paused?0:FLOW_LINE_RATE);
+}
+
+/*Status query that parses two options and formats counters. param 1 - response is cached*/
+static const char query_line[]="status -i 2 -v";
+static uint32_t query_port;
+static bool query_verbose;
+
+static bool StatusCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	self->args[0].value=&query_port;
+	self->args[1].value=&query_verbose;
+	if(ParseCmdArgs(argv,self)!=SIM_CLI_OK)
+		return false;
+	CliWriteStr(_context,"port ");
+	CliWriteUint(_context,query_port);
+	CliWriteStr(_context," up, rx ");
+	CliWriteUint(_context,1234567890u);
+	CliWriteStr(_context," tx ");
+	CliWriteUint(_context,987654321u);
+	CliWriteStr(_context," err 0x");
+	CliWriteHex(_context,0x1F,4);
+	CliWriteStr(_context,"\n");
+	return true;
+}
+
+static void SetupQuery(uint32_t param)
+{
+	InitCliRegistry(&Registry);
+	cli_command_t cmd=
+	{
+		.cmd_name="status",
+		.args_num=2,
+		.args={	{.arg_name="-i", .arg_type=ARG_UINT32},
+				{.arg_name="-v", .arg_type=ARG_ONLY}},
+		.c_func=StatusCmd,
+		.cmd_ID=1,
+		.cache_ttl=param?60000:0
+	};
+	AddRegistryCommand(&Registry,&cmd);
+	InitCLIcontext(&Session,NullHandler,NullWrite,"Bench");
+	AttachCliRegistry(&Session,&Registry);
+}
+
+static void BenchQuery(uint32_t param, uint64_t ops)
+{
+	char scratch[SIMCLI_MAX_CMD_LEN];
+	UNUSED_PARAMETER(param);
+	for(uint64_t i=0;i<ops;++i)
+		sink+=(uintptr_t)ProcessCommandBuf(query_line,sizeof(query_line)-1,scratch,sizeof(scratch),&Session);
+}
+
+typedef struct
+{
+	bench_case_t 	bench;
+	void 			(*setup)(uint32_t param);
+}bench_entry_t;
+
+static const bench_entry_t bench_list[]=
+{
+	{{"lookup",				BenchLookup,	10,		2000000,	0},					SetupLookup},
+	{{"lookup",				BenchLookup,	100,	2000000,	0},					SetupLookup},
+	{{"lookup",				BenchLookup,	1000,	2000000,	0},					SetupLookup},
+	{{"prefix_match",		BenchPrefix,	1000,	2000000,	0},					SetupPrefix},
+	{{"parse_args",			BenchParse,		8,		200000,		sizeof(parse_line)-1},	SetupParse},
+#if (SIMCLI_USE_BINARY==1)
+	{{"parse_binary",		BenchBinary,	8,		200000,		0},					SetupBinary},
+#endif
+	{{"line_framing",		BenchFraming,	1,		200,		FRAME_INPUT_SIZE},	SetupFraming},
+	{{"line_framing",		BenchFraming,	64,		2000,		FRAME_INPUT_SIZE},	SetupFraming},
+	{{"line_framing",		BenchFraming,	4096,	2000,		FRAME_INPUT_SIZE},	SetupFraming},
+	{{"context_round_trip",	BenchContext,	1,		2000000,	0},					SetupContext},
+	{{"bulk_flow",			BenchBulk,		512,	200000,		512},				SetupBulk},
+	{{"bulk_flow",			BenchBulk,		16384,	20000,		16384},				SetupBulk},
+	{{"context_pipeline",	BenchPipeline,	4,		2000000,	PIPE_CHUNK_SIZE},	SetupPipeline},
+	{{"query",				BenchQuery,		0,		2000000,	0},					SetupQuery},
+	{{"query_cached",		BenchQuery,		1,		2000000,	0},					SetupQuery},
+	{{"flow_paced",			BenchFlowPaced,	4096,	100000,		0},					SetupFlowPaced},
+	{{"flow_credit",		BenchFlowCredit,	4096,	100000,		0},					SetupFlowCredit},
+	{{"flow_xonxoff",		BenchFlowXonXoff,	4096,	100000,		0},					SetupFlowXonXoff},
+};
+
+static void Report(const bench_case_t *bench, uint64_t best_ns, uint64_t allocs, uint64_t bytes)
+{
+	double ns_per_op=(double)best_ns/(double)bench->ops;
+	double bytes_per_s=bench->bytes_per_op?(double)bench->bytes_per_op*1e9/ns_per_op:(double)bytes*1e9/(double)best_ns;
+	double allocs_per_op=(double)allocs/(double)bench->ops;
+	if(csv_output)
+		printf("%s,%u,%llu,%.2f,%.0f,%.3f\n",bench->name,(unsigned)bench->param,(unsigned long long)bench->ops,
+				ns_per_op,bytes_per_s,allocs_per_op);
+	else
+		printf("{\"bench\":\"%s\",\"param\":%u,\"ops\":%llu,\"ns_per_op\":%.2f,\"bytes_per_s\":%.0f,\"allocs_per_op\":%.3f}\n",
+				bench->name,(unsigned)bench->param,(unsigned long long)bench->ops,ns_per_op,bytes_per_s,allocs_per_op);
+}
+
+int main(int argc, char *argv[])
+{
+	csv_output=(argc>1)&&(strcmp(argv[1],"csv")==0);
+	if(csv_output)
+		printf("bench,param,ops,ns_per_op,bytes_per_s,allocs_per_op\n");
+	for(size_t i=0;i<sizeof(bench_list)/sizeof(bench_list[0]);++i)
+	{
+		const bench_case_t *bench=&bench_list[i].bench;
+		uint64_t best_ns=UINT64_MAX;
+		uint64_t allocs=0;
+		uint64_t bytes=0;
+		bench_list[i].setup(bench->param);
+		bench->run(bench->param,bench->ops/10);							/*Warm up*/
+		for(int r=0;r<BENCH_REPEATS;++r)
+		{
+			alloc_count=0;
+			run_bytes=0;
+			uint64_t start=MonotonicNs();
+			bench->run(bench->param,bench->ops);
+			uint64_t elapsed=MonotonicNs()-start;
+			if(elapsed<best_ns)
+			{
+				best_ns=elapsed;
+				allocs=alloc_count;
+				bytes=run_bytes;
+			}
+		}
+		Report(bench,best_ns,allocs,bytes);
+	}
+	return 0;
+}
@@ -0,0 +1,486 @@
+/*
+ * fuzz_session.c
+ *
+ * Description: Session, command set and invariant checks shared by fuzz target and stress driver.
+ *              Commands cover every argument type, nested and bulk data contexts, pipelines and
+ *              asynchronous operations. Session state is checked after every operation.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "simple_cli_trie.h"
+#include "fuzz_session.h"
+
+#ifndef UNUSED_PARAMETER
+	#define UNUSED_PARAMETER(x)    ((void)(x))
+#endif
+
+#define FUZZ_OUT_MAX 			4096			/*Max response size of "out" command*/
+
+#define FUZZ_ASSERT(cond) 																\
+	do{																					\
+		if(!(cond))																		\
+		{																				\
+			fprintf(stderr,"%s:%d: invariant failed: %s\n",__FILE__,__LINE__,#cond);	\
+			abort();																	\
+		}																				\
+	}while(0)
+
+fuzz_set_result_t FuzzSetResult;
+const char* const FuzzModes[]={"off","slow","fast",NULL};
+
+static cli_registry_t Registry;
+static cli_trie_t Trie;
+static Context_t *MainOwner;
+static uint64_t output_bytes;
+static volatile uint32_t sink;					/*Keeps output checksum alive, so every output byte is read*/
+static uint32_t bulk_left;						/*Bytes still expected by bulk context*/
+static uint32_t async_polls[SIMCLI_ASYNC_SLOTS];/*Polls left till completion, one per async slot*/
+static uint32_t size_z;
+static uint8_t size_n;
+static uint32_t size_h;
+static char size_t_str[8];
+static uint32_t set_version;					/*Changed by "set", drops cached "size" responses*/
+SIMPLE_CLI_DEF (FuzzC);
+
+static uint32_t FuzzWrite(const char *data, size_t length)
+{
+	uint32_t sum=0;
+	for(size_t i=0;i<length;++i)
+		sum+=(uint8_t)data[i];
+	sink+=sum;
+	output_bytes+=length;
+	return (uint32_t)length;
+}
+
+static bool MainHandler(char *data, size_t length, void * _context)
+{
+	UNUSED_PARAMETER(length);
+	if(ProcessCommand(data,_context)==0)
+	{
+		CliWriteStr(_context,"unknown\n");
+		return false;
+	}
+	return true;
+}
+
+static bool WriteError(CliContextManager_t * _context, const char* cmd_name, sim_cli_error err)
+{
+	CliWriteStr(_context,cmd_name);
+	CliWriteStr(_context,": error ");
+	CliWriteUint(_context,(uint64_t)err);
+	CliWriteStr(_context,"\n");
+	return false;
+}
+
+/*Values get arena storage. Arguments that are not passed read as 0*/
+static bool SetCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	sim_cli_error err=ParseCmdArgsArena(argv,self,_context);
+	if(err!=SIM_CLI_OK)
+		return WriteError(_context,self->cmd_name,err);
+	FuzzSetResult.i=*(const int32_t*)self->args[0].value;
+	memcpy(FuzzSetResult.s,self->args[1].value,sizeof(FuzzSetResult.s));
+	FuzzSetResult.u=*(const uint32_t*)self->args[2].value;
+	FuzzSetResult.l=*(const int64_t*)self->args[3].value;
+	FuzzSetResult.x=*(const uint32_t*)self->args[4].value;
+	FuzzSetResult.b=*(const bool*)self->args[5].value;
+	FuzzSetResult.e=*(const uint8_t*)self->args[6].value;
+	FuzzSetResult.f=*(const float*)self->args[7].value;
+	FUZZ_ASSERT(FuzzSetResult.s[sizeof(FuzzSetResult.s)-1]=='\0');
+	FUZZ_ASSERT(FuzzModes[FuzzSetResult.e]!=NULL);
+	FuzzSetResult.count++;
+	set_version++;
+	CliWriteStr(_context,"ok\n");
+	return true;
+}
+
+/*Values are stored in static variables*/
+static bool SizeCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	self->args[0].value=&size_z;
+	self->args[1].value=&size_n;
+	self->args[2].value=size_t_str;
+	self->args[3].value=&size_h;
+	sim_cli_error err=ParseCmdArgs(argv,self);
+	if(err!=SIM_CLI_OK)
+		return WriteError(_context,self->cmd_name,err);
+	FUZZ_ASSERT(memchr(size_t_str,'\0',sizeof(size_t_str))!=NULL);
+	CliWriteUint(_context,size_z);
+	CliWriteStr(_context,"\n");
+	return true;
+}
+
+/*Pipeline stage. Payload starting with 'q' releases the context, '>' acquires one more stage,
+  '|' passes the rest down the pipeline, '!' writes a long response. Anything else is echoed*/
+static bool StageHandler(char *data, size_t length, void * _context);
+static Context_t StageContext={"stage",StageHandler,NULL,0};
+
+static bool StageHandler(char *data, size_t length, void * _context)
+{
+	if(length==0)
+		return true;
+	char *copy=CliArenaAlloc(_context,length);						/*Rewound by context manager*/
+	if(copy)
+		memcpy(copy,data,length);
+	switch(data[0])
+	{
+		case 'q':
+			return ReleaseContext(_context);
+		case '>':
+			return AcquireContext(_context,&StageContext);
+		case '|':
+			return PassDownContext(_context,data+1,length-1);
+		case '!':
+			for(size_t i=0;i<8;++i)
+				CliWrite(_context,data,length);
+			return true;
+		default:
+			return CliWrite(_context,data,length)==length;
+	}
+}
+
+static bool PipeCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	UNUSED_PARAMETER(argv);
+	return AcquireContext(_context,&self->cmd_context);
+}
+
+static size_t BulkHandler(const cli_data_view_t *view, bool *complete, void * _context)
+{
+	UNUSED_PARAMETER(_context);
+	size_t consumed=0;
+	for(int i=0;i<2;++i)
+	{
+		size_t chunk=(view->length[i]<bulk_left)?view->length[i]:bulk_left;
+		for(size_t j=0;j<chunk;++j)
+			sink+=(uint8_t)view->data[i][j];
+		bulk_left-=(uint32_t)chunk;
+		consumed+=chunk;
+	}
+	*complete=(bulk_left==0);
+	return consumed;
+}
+
+/*Same transfer through the copying path*/
+static bool BulkContextHandler(char *data, size_t length, void * _context)
+{
+	bool complete;
+	cli_data_view_t view={{data,NULL},{length,0}};
+	BulkHandler(&view,&complete,_context);
+	if(complete)
+		ReleaseContext(_context);
+	return true;
+}
+
+static bool BulkCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	uint32_t size=0;
+	self->args[0].value=&size;
+	sim_cli_error err=ParseCmdArgs(argv,self);
+	if(err!=SIM_CLI_OK)
+		return WriteError(_context,self->cmd_name,err);
+	if(!AcquireContext(_context,&self->cmd_context))
+		return false;
+	bulk_left=size;
+	return true;
+}
+
+static cli_async_state_t AsyncStep(cli_async_t *op, void * _context)
+{
+	UNUSED_PARAMETER(_context);
+	uint32_t *left=op->user_data;
+	if(*left==0)
+		return CLI_ASYNC_DONE;
+	--*left;
+	return CLI_ASYNC_PENDING;
+}
+
+static void AsyncDone(cli_async_t *op, bool result, void * _context)
+{
+	CliWriteStr(_context,result?"bg: done ":"bg: failed ");
+	CliWriteUint(_context,op->handle);
+	CliWriteStr(_context,"\n");
+}
+
+/*Finishes after -n polls. Without -n it waits for CompleteCliAsync()*/
+static bool BgCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	uint32_t polls=0;
+	self->args[0].value=&polls;
+	sim_cli_error err=ParseCmdArgs(argv,self);
+	if(err!=SIM_CLI_OK)
+		return WriteError(_context,self->cmd_name,err);
+	cli_async_t *op=BeginCliAsync(_context,polls?AsyncStep:NULL,AsyncDone,NULL);
+	if(op==NULL)
+		return false;
+	uint32_t *left=&async_polls[op-_context->Async];
+	*left=polls;
+	op->user_data=left;
+	return true;
+}
+
+/*Response of -n bytes written in odd sized pieces, so transmit buffer fills at any position*/
+static bool OutCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	static const char pattern[]="0123456789abcdef";
+	uint32_t size=0;
+	self->args[0].value=&size;
+	sim_cli_error err=ParseCmdArgs(argv,self);
+	if(err!=SIM_CLI_OK)
+		return WriteError(_context,self->cmd_name,err);
+	if(size>FUZZ_OUT_MAX)
+		size=FUZZ_OUT_MAX;
+	for(uint32_t pos=0;pos<size;pos+=7)
+		CliWrite(_context,pattern,(size-pos<7)?size-pos:7);
+	return true;
+}
+
+static const cli_command_t FuzzCommands[]=
+{
+	{
+		.cmd_name="set",
+		.args_num=8,
+		.args={	{.arg_name="-i", .arg_type=ARG_INT32},
+				{.arg_name="-s", .arg_type=ARG_STRING, .value_size=sizeof(FuzzSetResult.s)},
+				{.arg_name="-u", .arg_type=ARG_UINT32},
+				{.arg_name="-l", .arg_type=ARG_INT64},
+				{.arg_name="-x", .arg_type=ARG_HEX},
+				{.arg_name="-b", .arg_type=ARG_BOOL},
+				{.arg_name="-e", .arg_type=ARG_ENUM, .enum_list=FuzzModes},
+				{.arg_name="-f", .arg_type=ARG_FLOAT}},
+		.c_func=SetCmd,
+		.cmd_ID=1
+	},
+	{
+		.cmd_name="size",
+		.args_num=4,
+		.args={	{.arg_name="-z", .arg_type=ARG_SIZE},
+				{.arg_name="-n", .arg_type=ARG_ONLY},
+				{.arg_name="-t", .arg_type=ARG_STRING, .value_size=sizeof(size_t_str)},
+				{.arg_name="-h", .arg_type=ARG_HEX}},
+		.c_func=SizeCmd,
+		.cmd_ID=2,
+		.cache_version=&set_version
+	},
+	{
+		.cmd_name="pipe",
+		.c_func=PipeCmd,
+		.cmd_ID=3,
+		.cmd_context={"pipe",StageHandler,NULL,0}
+	},
+	{
+		.cmd_name="bulk",
+		.args_num=1,
+		.args={	{.arg_name="-n", .arg_type=ARG_SIZE}},
+		.c_func=BulkCmd,
+		.cmd_ID=4,
+		.cmd_context={"bulk",BulkContextHandler,BulkHandler,256}
+	},
+	{
+		.cmd_name="bg",
+		.args_num=1,
+		.args={	{.arg_name="-n", .arg_type=ARG_UINT32}},
+		.c_func=BgCmd,
+		.cmd_ID=5
+	},
+	{
+		.cmd_name="out",
+		.args_num=1,
+		.args={	{.arg_name="-n", .arg_type=ARG_UINT32}},
+		.c_func=OutCmd,
+		.cmd_ID=6,
+		.cache_ttl=1000
+	}
+};
+
+void InitFuzzSession(void)
+{
+	InitCliRegistry(&Registry);
+	for(size_t i=0;i<sizeof(FuzzCommands)/sizeof(FuzzCommands[0]);++i)
+		FUZZ_ASSERT(AddRegistryCommand(&Registry,&FuzzCommands[i])!=0);
+	FUZZ_ASSERT(BuildCliTrie(&Trie,&Registry));
+	MainOwner=FuzzC.contextOwner;
+	ResetFuzzSession();
+}
+
+void ResetFuzzSession(void)
+{
+	while(ReleaseContext(&FuzzC))
+		;
+	InitCLIcontext(&FuzzC,MainHandler,FuzzWrite,"Fuzz");
+	AttachCliRegistry(&FuzzC,&Registry);
+	AttachCliTrie(&FuzzC,&Trie);
+	bulk_left=0;
+}
+
+CliContextManager_t* GetFuzzSession(void)
+{
+	return &FuzzC;
+}
+
+uint64_t FuzzOutputBytes(void)
+{
+	return output_bytes;
+}
+
+void CheckFuzzSession(void)
+{
+	const CliContextManager_t *cli=&FuzzC;
+	uint8_t level=cli->context_level;
+	FUZZ_ASSERT(level==cli->CallStack.currentSize);
+	FUZZ_ASSERT(level<=CLI_STACK_SIZE);
+	FUZZ_ASSERT(cli->CallStack.root==MainOwner);
+	FUZZ_ASSERT(cli->contextOwner==(level?&cli->CallStack.stackbuf[level-1]:MainOwner));
+	if(level>1)
+		FUZZ_ASSERT(cli->ParentOwner==&cli->CallStack.stackbuf[level-2]);
+	else
+		FUZZ_ASSERT(cli->ParentOwner==(level?MainOwner:NULL));
+	FUZZ_ASSERT(cli->Arena.used==0);									/*Scratch memory is rewound after every call*/
+	FUZZ_ASSERT(cli->Arena.peak<=cli->Arena.size);
+	FUZZ_ASSERT(cli->TxHold==0);
+	FUZZ_ASSERT(cli->PipeBase==0);										/*Pipeline stages are released by the line that made them*/
+	FUZZ_ASSERT(cli->Flow.level<=level);
+	FUZZ_ASSERT(cli->Flow.level||!cli->Flow.stopped);
+	FUZZ_ASSERT(cli->Flow.credit<=cli->Flow.window);
+	FUZZ_ASSERT(cli->TxLen==0);											/*Response is flushed when call returns*/
+	FUZZ_ASSERT(cli->LineFramer.length<sizeof(cli->LineFramer.buf));
+	uint8_t pending=0;
+	for(size_t i=0;i<SIMCLI_ASYNC_SLOTS;++i)
+	{
+		FUZZ_ASSERT(cli->Async[i].state<=CLI_ASYNC_FAILED);
+		if(cli->Async[i].state!=CLI_ASYNC_FREE)
+		{
+			FUZZ_ASSERT(cli->Async[i].handle!=0);
+			++pending;
+		}
+	}
+	FUZZ_ASSERT(pending==CliAsyncPending(cli));
+#if (SIMCLI_CACHE_SLOTS>0)
+	FUZZ_ASSERT(cli->CacheFill==NULL);									/*Response capture ends with the command*/
+	for(size_t i=0;i<SIMCLI_CACHE_SLOTS;++i)
+	{
+		const cli_cache_entry_t *entry=&cli->Cache[i];
+		FUZZ_ASSERT(entry->length<=SIMCLI_CACHE_DATA_SIZE);
+		FUZZ_ASSERT(entry->key_len<=SIMCLI_CACHE_KEY_SIZE);
+		FUZZ_ASSERT((entry->command==NULL)||(entry->used<=cli->CacheClock));
+	}
+#endif
+}
+
+/*Payload copy of exact size, so sanitizer catches reads past its end*/
+static char* CopyPayload(const uint8_t *data, size_t length)
+{
+	char *copy=malloc(length+1);
+	FUZZ_ASSERT(copy!=NULL);
+	if(length)
+		memcpy(copy,data,length);
+	copy[length]='\0';
+	return copy;
+}
+
+#if (SIMCLI_USE_BINARY==1)
+static void RunFrameOp(const uint8_t *data, size_t length)
+{
+	uint8_t frame[SIMCLI_MAX_CMD_LEN];
+	cli_frame_writer_t writer;
+	if((length==0)||!CliFrameBegin(&writer,frame,sizeof(frame),data[0]))
+		return;
+	for(size_t pos=1;pos+2<=length;)
+	{
+		size_t arg_len=data[pos+1];
+		if(arg_len>length-pos-2)
+			arg_len=length-pos-2;
+		if(!CliFrameArg(&writer,data[pos],&data[pos+2],(uint8_t)arg_len))
+			break;
+		pos+=2+arg_len;
+	}
+	size_t size=CliFrameEnd(&writer);
+	FUZZ_ASSERT(size!=0);
+	/*Frame is fed in two pieces, so line framer assembles it*/
+	size_t split=data[0]%(size+1);
+	char *copy=CopyPayload(frame,size);
+	FeedContextHandler(&FuzzC,copy,split);
+	CheckFuzzSession();
+	FeedContextHandler(&FuzzC,copy+split,size-split);
+	free(copy);
+}
+#endif
+
+static void RunFuzzOp(uint8_t op, const uint8_t *data, size_t length)
+{
+	char *copy=CopyPayload(data,length);
+	switch(op)
+	{
+		case FUZZ_OP_FEED:
+			FeedContextHandler(&FuzzC,copy,length);
+			break;
+		case FUZZ_OP_LINE:
+			ProcessCommand(copy,&FuzzC);
+			break;
+		case FUZZ_OP_CONTEXT:
+			CallContextHandler(&FuzzC,copy,length);
+			break;
+		case FUZZ_OP_BULK:
+		{
+			size_t split=length?data[0]%(length+1):0;
+			cli_data_view_t view={{copy,copy+split},{split,length-split}};
+			CallContextBulk(&FuzzC,&view);
+			break;
+		}
+#if (SIMCLI_USE_BINARY==1)
+		case FUZZ_OP_FRAME:
+			RunFrameOp(data,length);
+			break;
+		case FUZZ_OP_RAW_FRAME:
+			ProcessCommandFrame((const uint8_t*)copy,length,&FuzzC);
+			break;
+#endif
+		case FUZZ_OP_ASYNC:
+			if(length>=2)
+				CompleteCliAsync(&FuzzC,(uint16_t)(data[0]|(data[1]<<8)),(data[0]&1)==0);
+			else if(length==1)
+				CompleteCliAsync(&FuzzC,GetCliAsyncHandle(&FuzzC),(data[0]&1)==0);
+			PollCliAsync(&FuzzC);
+			break;
+		default:
+			switch(length?data[0]%4:0)
+			{
+				case 0:
+					AcquireContext(&FuzzC,&StageContext);
+					break;
+				case 1:
+					ReleaseContext(&FuzzC);
+					break;
+				case 2:
+					CliFlowUpdate(&FuzzC,(length>1)?(uint32_t)data[1]*4:0);
+					break;
+				default:
+					SetCliFlowMode(&FuzzC,(cli_flow_mode_t)(data[0]>>7));
+					break;
+			}
+			break;
+	}
+	free(copy);
+}
+
+size_t RunFuzzOps(const uint8_t *data, size_t size)
+{
+	size_t ops=0;
+	size_t pos=0;
+	while(pos+2<=size)
+	{
+		uint8_t op=data[pos]%FUZZ_OPS_NUM;
+		size_t length=data[pos+1];
+		pos+=2;
+		if(length>size-pos)
+			length=size-pos;
+		RunFuzzOp(op,&data[pos],length);
+		CheckFuzzSession();
+		pos+=length;
+		++ops;
+	}
+	return ops;
+}
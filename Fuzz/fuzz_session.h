@@ -0,0 +1,78 @@
+/*
+ * fuzz_session.h
+ *
+ * Description: Session, command set and invariant checks shared by fuzz target and stress driver.
+ *              This file is licensed under the MIT License.
+ */
+
+#ifndef SIMPLE_CLI_FUZZ_SESSION_H
+#define SIMPLE_CLI_FUZZ_SESSION_H
+
+#include "simple_cli.h"
+
+/*Operation stream. Every operation is a header byte, a length byte and length bytes of payload*/
+#define FUZZ_OP_FEED 			0				/*FeedContextHandler(): stream input, lines and binary frames*/
+#define FUZZ_OP_LINE 			1				/*ProcessCommand() of payload as one command line*/
+#define FUZZ_OP_CONTEXT 		2				/*CallContextHandler()*/
+#define FUZZ_OP_BULK 			3				/*CallContextBulk(). First payload byte sets where view is split*/
+#define FUZZ_OP_FRAME 			4				/*Valid frame: command ID, then TLV arguments (position, length, value)*/
+#define FUZZ_OP_RAW_FRAME 		5				/*ProcessCommandFrame() of payload as is*/
+#define FUZZ_OP_ASYNC 			6				/*CompleteCliAsync() with payload handle, then PollCliAsync()*/
+#define FUZZ_OP_STACK 			7				/*First byte % 4: AcquireContext(), ReleaseContext(), CliFlowUpdate(), SetCliFlowMode()*/
+#define FUZZ_OPS_NUM 			8
+
+/**
+ * @brief Values parsed by the last successful "set" command. Checked by property tests
+ */
+typedef struct
+{
+	int32_t 	i;
+	uint32_t 	u;
+	int64_t 	l;
+	uint32_t 	x;
+	bool 		b;
+	uint8_t 	e;
+	float 		f;
+	char 		s[12];
+	uint32_t 	count;							/*Number of successful "set" calls*/
+}fuzz_set_result_t;
+
+extern fuzz_set_result_t FuzzSetResult;
+extern const char* const FuzzModes[];			/*Values of "set -e"*/
+
+/**
+ * @brief Registers fuzz command set. Called once
+ */
+void InitFuzzSession(void);
+
+/**
+ * @brief Returns session to the initial state: releases contexts, drops pending operations and unfinished input
+ */
+void ResetFuzzSession(void);
+
+/**
+ * @brief Executes operation stream. Session invariants are checked after every operation,
+ * violation aborts the process so fuzzer or sanitizer reports the input
+ *
+ * @param data 	[in] Operation stream
+ * @param size 	[in] Stream size
+ * @return Number of executed operations
+ */
+size_t RunFuzzOps(const uint8_t *data, size_t size);
+
+/**
+ * @brief Aborts when session state is inconsistent
+ */
+void CheckFuzzSession(void);
+
+/**
+ * @brief Returns session object
+ */
+CliContextManager_t* GetFuzzSession(void);
+
+/**
+ * @brief Returns number of response bytes written by the session since InitFuzzSession()
+ */
+uint64_t FuzzOutputBytes(void);
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * simple_cli_fuzz.c
+ *
+ * Description: Fuzz target of Simple CLI. Input is an operation stream, see FUZZ_OP_* in fuzz_session.h.
+ *              Built with SIMCLI_LIBFUZZER it is a libFuzzer target. Otherwise main() runs every file
+ *              given in arguments (or stdin) once, so the same binary is used by AFL and for replay of
+ *              crash inputs and corpora. Replay prints one result line in bench format.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+#include "fuzz_session.h"
+
+#define FUZZ_MAX_INPUT 			(1024*1024)			/*Longer replay inputs are cut*/
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static bool initialized;
+	if(!initialized)
+	{
+		InitFuzzSession();
+		initialized=true;
+	}
+	ResetFuzzSession();
+	RunFuzzOps(data,size);
+	return 0;
+}
+
+#ifndef SIMCLI_LIBFUZZER
+static uint64_t MonotonicNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+}
+
+static size_t ReadInput(FILE *file, uint8_t *buf)
+{
+	size_t size=0;
+	size_t num;
+	while((size<FUZZ_MAX_INPUT)&&((num=fread(&buf[size],1,FUZZ_MAX_INPUT-size,file))>0))
+		size+=num;
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	static uint8_t input[FUZZ_MAX_INPUT];
+	uint64_t bytes=0;
+	uint64_t elapsed=0;
+	int runs=0;
+	for(int i=1;(i<argc)||(runs==0);++i)
+	{
+		FILE *file=(i<argc)?fopen(argv[i],"rb"):stdin;
+		if(file==NULL)
+		{
+			fprintf(stderr,"Can't open %s\n",argv[i]);
+			return 1;
+		}
+		size_t size=ReadInput(file,input);
+		if(file!=stdin)
+			fclose(file);
+		uint64_t start=MonotonicNs();
+		LLVMFuzzerTestOneInput(input,size);
+		elapsed+=MonotonicNs()-start;
+		bytes+=size;
+		++runs;
+	}
+	double ns_per_op=(double)elapsed/(double)runs;
+	double bytes_per_s=elapsed?(double)bytes*1e9/(double)elapsed:0.0;
+	printf("{\"bench\":\"fuzz_replay\",\"param\":0,\"ops\":%d,\"ns_per_op\":%.2f,\"bytes_per_s\":%.0f}\n",
+			runs,ns_per_op,bytes_per_s);
+	return 0;
+}
+#endif
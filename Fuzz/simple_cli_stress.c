@@ -0,0 +1,315 @@
+/*
+ * simple_cli_stress.c
+ *
+ * Description: Randomized stress driver of Simple CLI parser and context manager.
+ *              "parse" case checks that values parsed from random text command lines and from the
+ *              same arguments sent as binary frame match the generated ones. "ops" case runs random
+ *              operation streams of the fuzz target: command lines, data context input, bulk views,
+ *              frames, async completions and context acquire/release. Session invariants are checked
+ *              after every operation. Every case prints one result line in bench format.
+ *              Usage: simple_cli_stress [iterations] [seed]
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "fuzz_session.h"
+
+#define STRESS_ITERATIONS 		200000					/*Default number of iterations of each case*/
+#define STRESS_STREAM_SIZE 		1024					/*Max size of random operation stream*/
+
+static uint64_t rng_state;
+
+static uint64_t MonotonicNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+}
+
+/*xorshift64*/
+static uint64_t Random(void)
+{
+	rng_state^=rng_state<<13;
+	rng_state^=rng_state>>7;
+	rng_state^=rng_state<<17;
+	return rng_state;
+}
+
+static uint32_t RandomBelow(uint32_t limit)
+{
+	return (uint32_t)(Random()%limit);
+}
+
+static void Report(const char* name, uint64_t seed, uint64_t ops, uint64_t bytes, uint64_t elapsed_ns)
+{
+	double ns_per_op=(double)elapsed_ns/(double)ops;
+	double bytes_per_s=(double)bytes*1e9/(double)elapsed_ns;
+	printf("{\"bench\":\"%s\",\"param\":%llu,\"ops\":%llu,\"ns_per_op\":%.2f,\"bytes_per_s\":%.0f}\n",
+			name,(unsigned long long)seed,(unsigned long long)ops,ns_per_op,bytes_per_s);
+}
+
+static void Fail(const char* name, uint64_t iteration, const char* input)
+{
+	fprintf(stderr,"%s: property failed at iteration %llu: %s\n",name,(unsigned long long)iteration,input);
+	abort();
+}
+
+/*Arguments of "set" command*/
+typedef struct
+{
+	int32_t 	i;
+	uint32_t 	u;
+	int64_t 	l;
+	uint32_t 	x;
+	bool 		b;
+	uint8_t 	e;
+	float 		f;
+	char 		s[16];
+}stress_set_args_t;
+
+static void RandomSetArgs(stress_set_args_t *args)
+{
+	static const char symbols[]="abcdefghijklmnopqrstuvwxyz0123456789._";
+	args->i=(int32_t)(uint32_t)Random();
+	args->u=(uint32_t)Random();
+	args->l=(int64_t)Random();
+	args->x=(uint32_t)Random();
+	args->b=Random()&1;
+	args->e=(uint8_t)RandomBelow(3);
+	args->f=(float)((int32_t)RandomBelow(80000)-40000)/4.0f;	/*Quarters have exact decimal form*/
+	size_t length=1+RandomBelow(sizeof(args->s)-2);				/*Up to 14 symbols: longer than 11 must fail*/
+	for(size_t i=0;i<length;++i)
+		args->s[i]=symbols[RandomBelow(sizeof(symbols)-1)];
+	args->s[length]='\0';
+}
+
+static int FormatSetLine(char *line, size_t size, const stress_set_args_t *args)
+{
+	static const char* const bool_true[]={"1","true","on","yes"};
+	static const char* const bool_false[]={"0","false","off","no"};
+	char parts[8][32];
+	snprintf(parts[0],sizeof(parts[0]),"-i %d",(int)args->i);
+	snprintf(parts[1],sizeof(parts[1]),"-s %s",args->s);
+	snprintf(parts[2],sizeof(parts[2]),"-u %u",(unsigned)args->u);
+	snprintf(parts[3],sizeof(parts[3]),"-l %lld",(long long)args->l);
+	snprintf(parts[4],sizeof(parts[4]),(Random()&1)?"-x 0x%X":"-x %x",(unsigned)args->x);
+	snprintf(parts[5],sizeof(parts[5]),"-b %s",args->b?bool_true[RandomBelow(4)]:bool_false[RandomBelow(4)]);
+	snprintf(parts[6],sizeof(parts[6]),"-e %s",FuzzModes[args->e]);
+	snprintf(parts[7],sizeof(parts[7]),"-f %.2f",(double)args->f);
+	for(int i=7;i>0;--i)											/*Arguments go in random order*/
+	{
+		int j=(int)RandomBelow((uint32_t)i+1);
+		char tmp[32];
+		memcpy(tmp,parts[i],sizeof(tmp));
+		memcpy(parts[i],parts[j],sizeof(tmp));
+		memcpy(parts[j],tmp,sizeof(tmp));
+	}
+	return snprintf(line,size,"set %s %s %s %s %s %s %s %s",parts[0],parts[1],parts[2],parts[3],
+					parts[4],parts[5],parts[6],parts[7]);
+}
+
+static bool SameSetResult(const stress_set_args_t *args)
+{
+	const fuzz_set_result_t *res=&FuzzSetResult;
+	float df=res->f-args->f;
+	return (res->i==args->i)&&(res->u==args->u)&&(res->l==args->l)&&(res->x==args->x)&&(res->b==args->b)&&
+			(res->e==args->e)&&(df<0.001f)&&(df>-0.001f)&&(strcmp(res->s,args->s)==0);
+}
+
+#if (SIMCLI_USE_BINARY==1)
+static void PutLe(uint8_t *buf, uint64_t value, uint8_t length)
+{
+	for(uint8_t i=0;i<length;++i)
+		buf[i]=(uint8_t)(value>>(8*i));
+}
+
+/*Operation stream with one FUZZ_OP_FRAME operation of "set" command*/
+static size_t FormatSetFrameOp(uint8_t *ops, const stress_set_args_t *args)
+{
+	uint8_t *p=&ops[3];
+	uint32_t f_bits;
+	memcpy(&f_bits,&args->f,sizeof(f_bits));
+	ops[0]=FUZZ_OP_FRAME;
+	ops[2]=1;														/*Command ID*/
+	p[0]=1;	p[1]=4;	PutLe(&p[2],(uint32_t)args->i,4);	p+=6;
+	p[0]=2;	p[1]=(uint8_t)strlen(args->s);	memcpy(&p[2],args->s,p[1]);	p+=2+p[1];
+	p[0]=3;	p[1]=4;	PutLe(&p[2],args->u,4);				p+=6;
+	p[0]=4;	p[1]=8;	PutLe(&p[2],(uint64_t)args->l,8);	p+=10;
+	p[0]=5;	p[1]=4;	PutLe(&p[2],args->x,4);				p+=6;
+	p[0]=6;	p[1]=1;	p[2]=args->b;						p+=3;
+	p[0]=7;	p[1]=1;	p[2]=args->e;						p+=3;
+	p[0]=8;	p[1]=4;	PutLe(&p[2],f_bits,4);				p+=6;
+	ops[1]=(uint8_t)(p-&ops[2]);
+	return (size_t)(p-ops);
+}
+#endif
+
+/*Random set of values goes through text and binary paths, parsed values must match*/
+static void StressParse(uint64_t seed, uint64_t iterations)
+{
+	char line[SIMCLI_MAX_CMD_LEN];
+	uint8_t ops[2+SIMCLI_MAX_CMD_LEN];
+	uint64_t bytes=0;
+	uint64_t calls=0;
+	ResetFuzzSession();
+	uint64_t start=MonotonicNs();
+	for(uint64_t n=0;n<iterations;++n)
+	{
+		stress_set_args_t args;
+		RandomSetArgs(&args);
+		bool valid=strlen(args.s)<sizeof(FuzzSetResult.s);
+		int length=FormatSetLine(line,sizeof(line)-2,&args);
+		uint32_t count=FuzzSetResult.count;
+		if(n&1)														/*Command line through FeedContextHandler*/
+		{
+			memcpy(&line[length],"\r\n",3);
+			ops[0]=FUZZ_OP_FEED;
+			ops[1]=(uint8_t)(length+2);
+			memcpy(&ops[2],line,(size_t)length+2);
+			RunFuzzOps(ops,(size_t)length+4);
+			line[length]='\0';
+		}
+		else
+		{
+			ops[0]=FUZZ_OP_LINE;
+			ops[1]=(uint8_t)length;
+			memcpy(&ops[2],line,(size_t)length);
+			RunFuzzOps(ops,(size_t)length+2);
+		}
+		bytes+=(uint64_t)length;
+		++calls;
+		if((FuzzSetResult.count!=count+valid)||(valid&&!SameSetResult(&args)))
+			Fail("stress_parse",n,line);
+#if (SIMCLI_USE_BINARY==1)
+		size_t size=FormatSetFrameOp(ops,&args);
+		RunFuzzOps(ops,size);
+		bytes+=size;
+		++calls;
+		if((FuzzSetResult.count!=count+2*valid)||(valid&&!SameSetResult(&args)))
+			Fail("stress_parse_frame",n,line);
+#endif
+	}
+	Report("stress_parse",seed,calls,bytes,MonotonicNs()-start);
+}
+
+/*Cached "out" responses: repeated query gives the same response as the first call*/
+static void StressCache(uint64_t seed, uint64_t iterations)
+{
+	uint8_t ops[2+SIMCLI_MAX_CMD_LEN];
+	uint64_t bytes=0;
+	ResetFuzzSession();
+	uint64_t start=MonotonicNs();
+	for(uint64_t n=0;n<iterations;++n)
+	{
+		uint32_t size=RandomBelow(256);
+		int length=snprintf((char*)&ops[2],SIMCLI_MAX_CMD_LEN,"out %s-n %u",RandomBelow(2)?" ":"",(unsigned)size);
+		ops[0]=FUZZ_OP_LINE;
+		ops[1]=(uint8_t)length;
+		uint64_t before=FuzzOutputBytes();
+		RunFuzzOps(ops,(size_t)length+2);
+		if(FuzzOutputBytes()-before!=size)
+			Fail("stress_cache",n,(const char*)&ops[2]);
+		bytes+=size;
+	}
+	Report("stress_cache",seed,iterations,bytes,MonotonicNs()-start);
+}
+
+static size_t PutText(uint8_t *buf, size_t size, const char* text)
+{
+	size_t length=strlen(text);
+	if(length>size)
+		length=size;
+	memcpy(buf,text,length);
+	return length;
+}
+
+/*Payload that is likely to reach deep states: valid commands and stage controls, mixed with garbage*/
+static size_t RandomPayload(uint8_t op, uint8_t *buf)
+{
+	static const char* const lines[]=
+	{
+		"pipe","pi","bulk -n 100","bulk -n 1k","bg -n 3","bg","out -n 600","out -n 33",
+		"size -z 4k -n -t abc -h 0x1f","size -t abcdefgh","set -i 12 -e fast","set -s","se -i -1",
+		"set -f 1e3 -u 4294967296","bulk -n","unknown -x","out -n 600 | pipe","out -n 40 | bulk -n 20 | pipe",
+		"bg -n 2 | pipe","set -i 1 | size"
+	};
+	static const char* const stage[]={"q",">","|","|q","|>","!abc","||x","data\r\n"};
+	size_t length=RandomBelow(64);
+	switch(op)
+	{
+		case FUZZ_OP_FEED:
+		case FUZZ_OP_LINE:
+			if(RandomBelow(4))
+			{
+				length=PutText(buf,255,lines[RandomBelow(sizeof(lines)/sizeof(lines[0]))]);
+				if(op==FUZZ_OP_FEED)
+					buf[length++]=(Random()&1)?'\n':'\r';
+				return length;
+			}
+			break;
+		case FUZZ_OP_CONTEXT:
+			if(RandomBelow(4))
+				return PutText(buf,255,stage[RandomBelow(sizeof(stage)/sizeof(stage[0]))]);
+			break;
+		case FUZZ_OP_FRAME:
+			length=1+RandomBelow(24);
+			for(size_t i=0;i<length;++i)
+				buf[i]=(uint8_t)Random();
+			buf[0]=(uint8_t)(1+RandomBelow(6));							/*Existing command*/
+			if(length>2)
+			{
+				buf[1]=(uint8_t)(1+RandomBelow(8));						/*Existing argument*/
+				buf[2]=(uint8_t)RandomBelow((uint32_t)length-2);
+			}
+			return length;
+		case FUZZ_OP_ASYNC:
+			return RandomBelow(3);
+		default:
+			break;
+	}
+	for(size_t i=0;i<length;++i)
+		buf[i]=(uint8_t)Random();
+	return length;
+}
+
+/*Random operation streams, session is reset before each of them*/
+static void StressOps(uint64_t seed, uint64_t iterations)
+{
+	uint8_t stream[STRESS_STREAM_SIZE];
+	uint64_t ops=0;
+	uint64_t bytes=0;
+	uint64_t start=MonotonicNs();
+	for(uint64_t n=0;n<iterations;)
+	{
+		size_t size=0;
+		while((size+2+255<=sizeof(stream))&&(n<iterations))
+		{
+			uint8_t op=(uint8_t)RandomBelow(FUZZ_OPS_NUM);
+			size_t length=RandomPayload(op,&stream[size+2]);
+			stream[size]=op;
+			stream[size+1]=(uint8_t)length;
+			size+=2+length;
+			++n;
+		}
+		ResetFuzzSession();
+		ops+=RunFuzzOps(stream,size);
+		bytes+=size;
+	}
+	Report("stress_ops",seed,ops,bytes,MonotonicNs()-start);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t iterations=(argc>1)?strtoull(argv[1],NULL,0):STRESS_ITERATIONS;
+	uint64_t seed=(argc>2)?strtoull(argv[2],NULL,0):(uint64_t)time(NULL);
+	rng_state=seed?seed:1;
+	InitFuzzSession();
+	StressParse(seed,iterations);
+	StressCache(seed,iterations);
+	StressOps(seed,iterations);
+	fprintf(stderr,"Response bytes: %llu\n",(unsigned long long)FuzzOutputBytes());
+	return 0;
+}
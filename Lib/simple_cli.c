@@ -1,176 +1,1914 @@
 #include "string.h"
 #include "simple_cli.h"
+#include "simple_cli_trie.h"
 
-static uint8_t NumCommandsStored = 0;
-cli_command_t cli_command_list [SIMCLI_MAX_COMMANDS];
+static cli_registry_t DefaultRegistry;						/*Command set used by AddNewCommand() and sessions without own registry*/
+
+typedef char hash_size_check_t[((SIMCLI_HASH_SIZE & (SIMCLI_HASH_SIZE - 1)) == 0 && SIMCLI_HASH_SIZE > SIMCLI_MAX_COMMANDS) ? 1 : -1];
 
 #ifndef UNUSED_PARAMETER
 	#define UNUSED_PARAMETER(X)  ((void)(X))
 #endif
 
-#define CLI_CHECK_NULL(_ret_code)   	\
-	if(_ret_code==0)					\
-		return false;					
+#define CLI_CHECK_NULL(_ret_code)   	\
+	if(_ret_code==0)					\
+		return false;					
+
+#if (SIMCLI_USE_STATS==1)
+	#ifndef SIMCLI_STATS_TIME
+		#if defined(__unix__)
+			#include "time.h"
+			static uint32_t StatsTime(void)
+			{
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC,&ts);
+				return (uint32_t)((uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec);
+			}
+			#define SIMCLI_STATS_TIME() 		StatsTime()
+		#else
+			#error "Define SIMCLI_STATS_TIME() that returns uint32_t timestamp in ticks"
+		#endif
+	#endif
+	#ifndef SIMCLI_STATS_HOLD_TIME
+		#if defined(__unix__)
+			#include "time.h"
+			static uint32_t StatsHoldTime(void)
+			{
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC,&ts);
+				return (uint32_t)((uint64_t)ts.tv_sec*1000ULL+(uint64_t)ts.tv_nsec/1000000ULL);
+			}
+			#define SIMCLI_STATS_HOLD_TIME() 	StatsHoldTime()
+		#else
+			#error "Define SIMCLI_STATS_HOLD_TIME() that returns uint32_t timestamp in milliseconds"
+		#endif
+	#endif
+
+	static cli_stats_t CliStats;
+
+	#define STATS_ADD(_field,_value) 		__atomic_fetch_add(&(_field),(_value),__ATOMIC_RELAXED)
+	#define STATS_SLOT(_cmd_ID) 			(((_cmd_ID)<SIMCLI_STATS_IDS)?(_cmd_ID):0)
+
+	static uint8_t StatsBucket(uint32_t ticks)
+	{
+		uint8_t bucket=0;
+		while((ticks>>=2)&&(bucket<SIMCLI_STATS_BUCKETS-1))
+			++bucket;
+		return bucket;
+	}
+
+	static void CountContextBytes(const CliContextManager_t *_context, uint8_t level, size_t length)
+	{
+		if(level==0)
+			STATS_ADD(CliStats.main_bytes,length);
+		else
+			STATS_ADD(CliStats.cmd[STATS_SLOT(_context->ContextCmdID[level-1])].context_bytes,length);
+	}
+	#define STATS_CONTEXT_BYTES(_context,_level,_length) 	CountContextBytes((_context),(_level),(_length))
+	#define STATS_NOW() 					SIMCLI_STATS_TIME()
+	#define STATS_CACHE_HIT(_cmd_ID) 		STATS_ADD(CliStats.cmd[STATS_SLOT(_cmd_ID)].cache_hits,1)
+#else
+	#define STATS_CONTEXT_BYTES(_context,_level,_length)
+	#define STATS_NOW() 					0u
+	#define STATS_CACHE_HIT(_cmd_ID)
+#endif
+
+#if (SIMCLI_CACHE_SLOTS>0)
+	#ifndef SIMCLI_CACHE_TIME
+		#if defined(__unix__)
+			#include "time.h"
+			static uint32_t CacheTime(void)
+			{
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC,&ts);
+				return (uint32_t)((uint64_t)ts.tv_sec*1000ULL+(uint64_t)ts.tv_nsec/1000000ULL);
+			}
+			#define SIMCLI_CACHE_TIME() 		CacheTime()
+		#else
+			#error "Define SIMCLI_CACHE_TIME() that returns uint32_t timestamp in milliseconds"
+		#endif
+	#endif
+
+	static uint32_t CacheEpoch;								/*Incremented by InvalidateCliCache(NULL), drops entries of all sessions*/
+#endif
+
+static bool IsArgDelimiter(char symbol)
+{
+	return (symbol=='\r')||(symbol=='\n')||((symbol!='\0')&&strchr(SIMCLI_ARGS_DELIMITER,symbol));
+}
+
+int TokenizeCmdLine(char* line, size_t length, cli_token_t* tokens, size_t max_tokens)
+{
+	size_t rd=0, wr=0;
+	int num_tokens=0;
+	while(rd<length)
+	{
+		if(IsArgDelimiter(line[rd]))
+		{
+			++rd;
+			continue;
+		}
+		if((size_t)num_tokens>=max_tokens)
+			return -1;
+		char quote='\0';
+		tokens[num_tokens].ptr=&line[wr];
+		size_t start=wr;
+		while(rd<length)
+		{
+			char symbol=line[rd];
+			if(quote)
+			{
+				++rd;
+				if(symbol==quote)
+				{
+					quote='\0';
+					continue;
+				}
+			}
+			else
+			{
+				if(IsArgDelimiter(symbol))
+					break;
+				++rd;
+				if((symbol=='"')||(symbol=='\''))
+				{
+					quote=symbol;
+					continue;
+				}
+			}
+			if((symbol=='\\')&&(rd<length))		/*Escaped symbol is taken as is*/
+				symbol=line[rd++];
+			line[wr++]=symbol;
+		}
+		if(quote)
+			return -1;								/*Unterminated quote*/
+		tokens[num_tokens].length=wr-start;
+		++num_tokens;
+		/*Output never overtakes input, so terminator overwrites either used delimiter or line[length]*/
+		line[wr++]='\0';
+		if(rd<length)
+			++rd;
+	}
+	return num_tokens;
+}
+
+
+/*FNV-1a hash of command or argument name*/
+uint32_t CliHashName(const char* name, uint32_t seed)
+{
+	uint32_t hash=seed;
+	while(*name)
+	{
+		hash^=(uint8_t)*name++;
+		hash*=0x01000193u;
+	}
+	return hash;
+}
+
+static uint32_t HashName(const char* name)
+{
+	return CliHashName(name,SIMCLI_HASH_SEED);
+}
+
+bool CompileCmdArgs(const cli_command_t* cmd, uint8_t *arg_index)
+{
+	memset(arg_index,0,SIMCLI_ARG_HASH_SIZE);
+	if(cmd->args_num>SIMCLI_MAX_ARGS)
+		return false;
+	for(uint8_t i=0;i<cmd->args_num;++i)
+	{
+		const char *name=cmd->args[i].arg_name;
+		if((name[0]=='\0')||!memchr(name,'\0',sizeof(cmd->args[i].arg_name)))
+			return false;
+		if((cmd->args[i].arg_type==ARG_ENUM)&&(cmd->args[i].enum_list==NULL))
+			return false;
+		uint32_t slot=HashName(name)&(SIMCLI_ARG_HASH_SIZE-1);
+		while(arg_index[slot])
+		{
+			if(strcmp(cmd->args[arg_index[slot]-1].arg_name,name)==0)
+				return false;									/*Duplicate argument name*/
+			slot=(slot+1)&(SIMCLI_ARG_HASH_SIZE-1);
+		}
+		arg_index[slot]=(uint8_t)(i+1);
+	}
+	return true;
+}
+
+/*Argument of command by full name or by unique prefix. call==NULL - command description outside of dispatch, no index*/
+static const cmd_arg_t* LookupCmdArg(const cli_command_t* command, const cli_cmd_call_t *call, const char* name)
+{
+	if(call==NULL)
+	{
+		for(uint8_t i=0;(i<command->args_num)&&(i<SIMCLI_MAX_ARGS);++i)
+		{
+			if(strcmp(command->args[i].arg_name,name)==0)
+				return &command->args[i];
+		}
+		return NULL;
+	}
+	uint32_t slot=HashName(name)&(SIMCLI_ARG_HASH_SIZE-1);
+	while(call->arg_index[slot])
+	{
+		const cmd_arg_t *arg=&command->args[call->arg_index[slot]-1];
+		if(strcmp(arg->arg_name,name)==0)
+			return arg;
+		slot=(slot+1)&(SIMCLI_ARG_HASH_SIZE-1);
+	}
+	if(call->trie)													/*Abbreviated argument name*/
+	{
+		uint8_t pos=MatchTrieArg(call->trie,command,name);
+		if(pos&&(pos<=command->args_num)&&(strncmp(command->args[pos-1].arg_name,name,strlen(name))==0))
+			return &command->args[pos-1];
+	}
+	return NULL;
+}
+
+static cmd_arg_t* FindCmdArg(cli_command_t* self, const char* name)
+{
+	return (cmd_arg_t*)(uintptr_t)LookupCmdArg(self,self->call,name);
+}
+
+/*Locale independent conversion of the whole string to unsigned value not greater than max_val*/
+static sim_cli_error StrToUnsigned(const char* str, uint8_t base, uint64_t max_val, uint64_t* result)
+{
+	uint64_t value=0;
+	if(*str=='\0')
+		return SIM_CLI_ARG_BAD_VALUE;
+	for(;*str;++str)
+	{
+		uint8_t digit;
+		if((*str>='0')&&(*str<='9'))
+			digit=(uint8_t)(*str-'0');
+		else if((base==16)&&(*str>='a')&&(*str<='f'))
+			digit=(uint8_t)(*str-'a'+10);
+		else if((base==16)&&(*str>='A')&&(*str<='F'))
+			digit=(uint8_t)(*str-'A'+10);
+		else
+			return SIM_CLI_ARG_BAD_VALUE;
+		if((digit>max_val)||(value>(max_val-digit)/base))
+			return SIM_CLI_ARG_OUT_OF_RANGE;
+		value=value*base+digit;
+	}
+	*result=value;
+	return SIM_CLI_OK;
+}
+
+static sim_cli_error StrToSigned(const char* str, uint64_t max_val, int64_t* result)
+{
+	bool negative=(*str=='-');
+	uint64_t magnitude;
+	if((*str=='-')||(*str=='+'))
+		++str;
+	sim_cli_error err=StrToUnsigned(str,10,negative?max_val+1:max_val,&magnitude);
+	if(err!=SIM_CLI_OK)
+		return err;
+	/*-(2^63) is representable, its magnitude is not*/
+	*result=negative?(int64_t)(0-magnitude):(int64_t)magnitude;
+	return SIM_CLI_OK;
+}
+
+static sim_cli_error StrToSize(const char* str, uint32_t* result)
+{
+	char digits[12];
+	uint8_t shift=0;
+	size_t len=strlen(str);
+	if(len&&((str[len-1]=='B')||(str[len-1]=='b')))
+		--len;
+	if(len)
+	{
+		switch(str[len-1])
+		{
+			case 'k': case 'K': shift=10; --len; break;
+			case 'm': case 'M': shift=20; --len; break;
+			case 'g': case 'G': shift=30; --len; break;
+			default: break;
+		}
+	}
+	if(len>=sizeof(digits))
+		return SIM_CLI_ARG_OUT_OF_RANGE;
+	memcpy(digits,str,len);
+	digits[len]='\0';
+	uint64_t value;
+	sim_cli_error err=StrToUnsigned(digits,10,UINT32_MAX>>shift,&value);
+	if(err==SIM_CLI_OK)
+		*result=(uint32_t)(value<<shift);
+	return err;
+}
+
+static sim_cli_error StrToFloat(const char* str, float* result)
+{
+	bool negative=false;
+	uint64_t mantissa=0;
+	int32_t exponent=0;
+	bool has_digits=false;
+	if((*str=='-')||(*str=='+'))
+		negative=(*str++=='-');
+	for(;(*str>='0')&&(*str<='9');++str,has_digits=true)
+	{
+		if(mantissa<100000000000000000ULL)
+			mantissa=mantissa*10+(uint64_t)(*str-'0');
+		else
+			++exponent;											/*Digits beyond precision only scale the value*/
+	}
+	if(*str=='.')
+	{
+		for(++str;(*str>='0')&&(*str<='9');++str,has_digits=true)
+		{
+			if(mantissa<100000000000000000ULL)
+			{
+				mantissa=mantissa*10+(uint64_t)(*str-'0');
+				--exponent;
+			}
+		}
+	}
+	if(!has_digits)
+		return SIM_CLI_ARG_BAD_VALUE;
+	if((*str=='e')||(*str=='E'))
+	{
+		int64_t exp_val;
+		sim_cli_error err=StrToSigned(str+1,1000,&exp_val);
+		if(err!=SIM_CLI_OK)
+			return err==SIM_CLI_ARG_OUT_OF_RANGE?err:SIM_CLI_ARG_BAD_VALUE;
+		exponent+=(int32_t)exp_val;
+	}
+	else if(*str)
+		return SIM_CLI_ARG_BAD_VALUE;
+
+	double value=(double)mantissa;
+	if(mantissa)
+	{
+		if(exponent>38)											/*Mantissa is at least 1*/
+			return SIM_CLI_ARG_OUT_OF_RANGE;
+		if(exponent<-80)										/*Below float precision*/
+			value=0.0;
+		else
+		{
+			double power=1.0;
+			for(int32_t i=(exponent<0)?-exponent:exponent;i>0;--i)
+				power*=10.0;
+			value=(exponent<0)?value/power:value*power;
+		}
+		if(value>3.402823466e38)
+			return SIM_CLI_ARG_OUT_OF_RANGE;
+	}
+	*result=(float)(negative?-value:value);
+	return SIM_CLI_OK;
+}
+
+static sim_cli_error StrToBool(const char* str, bool* result)
+{
+	static const char* const true_list[]={"1","true","on","yes"};
+	static const char* const false_list[]={"0","false","off","no"};
+	for(size_t i=0;i<sizeof(true_list)/sizeof(true_list[0]);++i)
+	{
+		if(strcmp(str,true_list[i])==0)
+		{
+			*result=true;
+			return SIM_CLI_OK;
+		}
+		if(strcmp(str,false_list[i])==0)
+		{
+			*result=false;
+			return SIM_CLI_OK;
+		}
+	}
+	return SIM_CLI_ARG_BAD_VALUE;
+}
+
+/*Converts value string according to argument type and stores it at arg->value*/
+static sim_cli_error SetArgValue(const cmd_arg_t* arg, const char* str)
+{
+	sim_cli_error err=SIM_CLI_OK;
+	uint64_t u_val=0;
+	int64_t s_val=0;
+	switch (arg->arg_type)
+	{
+		case ARG_ONLY:
+			break;
+		case ARG_STRING:
+		{
+			size_t len=strlen(str);
+			if(arg->value_size&&(len>=arg->value_size))
+				return SIM_CLI_ARG_TOO_LONG;
+			memcpy(arg->value,str,len+1);
+			break;
+		}
+		case ARG_INT32:
+			if((err=StrToSigned(str,INT32_MAX,&s_val))==SIM_CLI_OK)
+				*(int32_t*)(arg->value)=(int32_t)s_val;
+			break;
+		case ARG_INT64:
+			if((err=StrToSigned(str,INT64_MAX,&s_val))==SIM_CLI_OK)
+				*(int64_t*)(arg->value)=s_val;
+			break;
+		case ARG_UINT32:
+			if((err=StrToUnsigned(str,10,UINT32_MAX,&u_val))==SIM_CLI_OK)
+				*(uint32_t*)(arg->value)=(uint32_t)u_val;
+			break;
+		case ARG_HEX:
+			if((str[0]=='0')&&((str[1]=='x')||(str[1]=='X')))
+				str+=2;
+			if((err=StrToUnsigned(str,16,UINT32_MAX,&u_val))==SIM_CLI_OK)
+				*(uint32_t*)(arg->value)=(uint32_t)u_val;
+			break;
+		case ARG_BOOL:
+			err=StrToBool(str,(bool*)arg->value);
+			break;
+		case ARG_ENUM:
+			err=SIM_CLI_ARG_BAD_VALUE;
+			for(uint8_t i=0;arg->enum_list&&arg->enum_list[i];++i)
+			{
+				if(strcmp(str,arg->enum_list[i])==0)
+				{
+					*(uint8_t*)(arg->value)=i;
+					err=SIM_CLI_OK;
+					break;
+				}
+			}
+			break;
+		case ARG_FLOAT:
+			err=StrToFloat(str,(float*)arg->value);
+			break;
+		case ARG_SIZE:
+			err=StrToSize(str,(uint32_t*)arg->value);
+			break;
+		default:
+			err=SIM_CLI_ARG_BAD_VALUE;
+			break;
+	}
+	return err;
+}
+
+#if (SIMCLI_USE_BINARY==1)
+/*Little-endian number of up to 8 bytes*/
+static uint64_t TlvNumber(const uint8_t *value, uint8_t length)
+{
+	uint64_t num=0;
+	for(uint8_t i=length;i>0;--i)
+		num=(num<<8)|value[i-1];
+	return num;
+}
+
+/*Stores TLV value in argument destination. No string conversion*/
+static sim_cli_error SetTlvValue(cmd_arg_t *arg, const uint8_t *value, uint8_t length)
+{
+	switch(arg->arg_type)
+	{
+		case ARG_ONLY:
+			if(length!=0)
+				return SIM_CLI_ARG_BAD_VALUE;
+			*(uint8_t*)(arg->value)=1;
+			return SIM_CLI_OK;
+		case ARG_STRING:
+			if(arg->value_size&&(length>=arg->value_size))
+				return SIM_CLI_ARG_TOO_LONG;
+			memcpy(arg->value,value,length);
+			((char*)arg->value)[length]='\0';
+			return SIM_CLI_OK;
+		case ARG_INT64:
+			if(length!=sizeof(int64_t))
+				return SIM_CLI_ARG_BAD_VALUE;
+			*(int64_t*)(arg->value)=(int64_t)TlvNumber(value,length);
+			return SIM_CLI_OK;
+		case ARG_BOOL:
+			if((length!=1)||(value[0]>1))
+				return SIM_CLI_ARG_BAD_VALUE;
+			*(bool*)(arg->value)=(value[0]==1);
+			return SIM_CLI_OK;
+		case ARG_ENUM:
+			if(length!=1)
+				return SIM_CLI_ARG_BAD_VALUE;
+			for(uint8_t i=0;arg->enum_list&&arg->enum_list[i];++i)
+			{
+				if(i==value[0])
+				{
+					*(uint8_t*)(arg->value)=i;
+					return SIM_CLI_OK;
+				}
+			}
+			return SIM_CLI_ARG_OUT_OF_RANGE;
+		case ARG_FLOAT:
+		{
+			if(length!=sizeof(float))
+				return SIM_CLI_ARG_BAD_VALUE;
+			uint32_t bits=(uint32_t)TlvNumber(value,length);
+			memcpy(arg->value,&bits,sizeof(float));
+			return SIM_CLI_OK;
+		}
+		default:													/*ARG_INT32, ARG_UINT32, ARG_HEX, ARG_SIZE*/
+			if(length!=sizeof(uint32_t))
+				return SIM_CLI_ARG_BAD_VALUE;
+			*(uint32_t*)(arg->value)=(uint32_t)TlvNumber(value,length);
+			return SIM_CLI_OK;
+	}
+}
+
+/*TLV arguments of binary frame: args[] position + 1, value length, value*/
+static sim_cli_error ParseTlvArgs(cli_command_t* self)
+{
+	uint16_t pos=0;
+	while(pos<self->call->tlv_length)
+	{
+		if(self->call->tlv_length-pos<2)
+			return SIM_CLI_ARG_MISSING_VALUE;
+		uint8_t tag=self->call->tlv_args[pos];
+		uint8_t length=self->call->tlv_args[pos+1];
+		if((tag==0)||(tag>self->args_num))
+			return SIM_CLI_ARG_UNKNOWN;
+		if(length>self->call->tlv_length-pos-2)
+			return SIM_CLI_ARG_MISSING_VALUE;
+		sim_cli_error err=SetTlvValue(&self->args[tag-1],&self->call->tlv_args[pos+2],length);
+		if(err!=SIM_CLI_OK)
+			return err;
+		pos=(uint16_t)(pos+2+length);
+	}
+	return SIM_CLI_OK;
+}
+
+/*Longest TLV value of argument at args[] position tag-1*/
+static uint8_t TlvArgLength(const cli_command_t* self, uint8_t tag)
+{
+	uint8_t max_len=0;
+	for(uint16_t pos=0;pos+2<=self->call->tlv_length;pos=(uint16_t)(pos+2+self->call->tlv_args[pos+1]))
+	{
+		if((self->call->tlv_args[pos]==tag)&&(self->call->tlv_args[pos+1]>max_len))
+			max_len=self->call->tlv_args[pos+1];
+	}
+	return max_len;
+}
+#endif
+
+static sim_cli_error ParseArgs(char **argv, cli_command_t* self)
+{
+	uint8_t arg_num=0;
+#if (SIMCLI_USE_BINARY==1)
+	if(self->call&&self->call->tlv_args)
+		return ParseTlvArgs(self);
+#endif
+	while(argv[arg_num])
+	{
+		cmd_arg_t *arg=FindCmdArg(self,argv[arg_num]);
+		if(arg==NULL)
+		{
+			//TODO: debug message
+			return SIM_CLI_ARG_UNKNOWN;
+		}
+		if(arg->arg_type==ARG_ONLY)
+		{
+			*(uint8_t*)(arg->value)=1;
+			arg_num+=1;
+			continue;
+		}
+		const char *value_str=argv[arg_num+1];
+		if((value_str==NULL)||((arg->arg_type==ARG_STRING)&&(*value_str=='-')))
+		{
+			//TODO: debug message
+			return SIM_CLI_ARG_MISSING_VALUE;
+		}
+		sim_cli_error err=SetArgValue(arg,value_str);
+		if(err!=SIM_CLI_OK)
+			return err;
+		arg_num+=2;
+	}
+	return SIM_CLI_OK;
+}
+
+sim_cli_error ParseCmdArgs(char **argv, cli_command_t* self)
+{
+#if (SIMCLI_USE_STATS==1)
+	uint32_t start=SIMCLI_STATS_TIME();
+	sim_cli_error err=ParseArgs(argv,self);
+	if(self->call)
+		self->call->parse_ticks+=SIMCLI_STATS_TIME()-start;
+	STATS_ADD(CliStats.errors[err],1);
+	return err;
+#else
+	return ParseArgs(argv,self);
+#endif
+}
+
+/*Storage size of argument value. Unlimited string gets room for the longest received value*/
+static size_t ArgValueSize(cli_command_t* self, const cmd_arg_t *arg, char **argv)
+{
+	size_t size=1;
+	switch(arg->arg_type)
+	{
+		case ARG_STRING:
+			if(arg->value_size)
+				return arg->value_size;
+#if (SIMCLI_USE_BINARY==1)
+			if(self->call&&self->call->tlv_args)
+				return (size_t)TlvArgLength(self,(uint8_t)(arg-self->args+1))+1;
+#endif
+			for(uint8_t i=0;argv[i]&&argv[i+1];++i)
+			{
+				if((FindCmdArg(self,argv[i])==arg)&&(strlen(argv[i+1])>=size))
+					size=strlen(argv[i+1])+1;
+			}
+			return size;
+		case ARG_INT32:
+			return sizeof(int32_t);
+		case ARG_INT64:
+			return sizeof(int64_t);
+		case ARG_UINT32:
+		case ARG_HEX:
+		case ARG_SIZE:
+			return sizeof(uint32_t);
+		case ARG_BOOL:
+			return sizeof(bool);
+		case ARG_FLOAT:
+			return sizeof(float);
+		default:
+			return sizeof(uint8_t);								/*ARG_ONLY, ARG_ENUM*/
+	}
+}
+
+sim_cli_error ParseCmdArgsArena(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	for(uint8_t i=0;i<self->args_num;++i)
+	{
+		cmd_arg_t *arg=&self->args[i];
+		if(arg->value)
+			continue;
+		size_t size=ArgValueSize(self,arg,argv);
+		arg->value=CliArenaAlloc(_context,size);
+		if(arg->value==NULL)
+			return SIM_CLI_NO_MEMORY;
+		memset(arg->value,0,size);
+	}
+	return ParseCmdArgs(argv,self);
+}
+
+bool InitCliRegistry(cli_registry_t *registry)
+{
+	CLI_CHECK_NULL(registry);
+	memset(registry,0,sizeof(*registry));
+	return true;
+}
+
+/*Returns position of the command in registry + 1, 0 - not found. Only hot[] entries are touched*/
+static cli_cmd_index_t LookupCmdName(const cli_registry_t *registry, const char* cmd_name)
+{
+	uint32_t hash=HashName(cmd_name);
+	uint32_t slot=hash&(SIMCLI_HASH_SIZE-1);
+#if (SIMCLI_PERFECT_HASH==1)
+	cli_cmd_index_t index=registry->name_index[slot];
+	if(index&&(registry->hot[index-1].name_hash==hash)&&(strcmp(registry->hot[index-1].cmd_name, cmd_name)==0))
+		return index;
+#else
+	while(registry->name_index[slot])
+	{
+		cli_cmd_index_t index=registry->name_index[slot];
+		const cli_cmd_hot_t *hot=&registry->hot[index-1];
+		if((hot->name_hash==hash)&&(strcmp(hot->cmd_name, cmd_name)==0))
+			return index;
+		slot=(slot+1)&(SIMCLI_HASH_SIZE-1);
+	}
+#endif
+	return 0;
+}
+
+/*Returns position of the command in const table + 1, 0 - not found. Single probe*/
+static uint16_t LookupTableName(const cli_command_table_t *table, const char* cmd_name)
+{
+	if(table==NULL)
+		return 0;
+	uint32_t hash=CliHashName(cmd_name,table->seed);
+	uint16_t index=table->name_index[hash&(table->hash_size-1)];
+	if(index&&(table->hot[index-1].name_hash==hash)&&(strcmp(table->hot[index-1].cmd_name,cmd_name)==0))
+		return index;
+	return 0;
+}
+
+/*Finds command in const table of the registry, then in its RAM part. Returns lookup entry*/
+static const cli_cmd_hot_t* ResolveCmd(const cli_registry_t *registry, const char* cmd_name, const cli_command_t **command, const uint8_t **arg_index)
+{
+	uint16_t table_index=LookupTableName(registry->table,cmd_name);
+	if(table_index)
+	{
+		*command=&registry->table->commands[table_index-1];
+		*arg_index=registry->table->arg_index[table_index-1];
+		return &registry->table->hot[table_index-1];
+	}
+	cli_cmd_index_t index=LookupCmdName(registry,cmd_name);
+	if(index==0)
+		return NULL;
+	*command=registry->cold[index-1];
+	*arg_index=registry->arg_index[index-1];
+	return &registry->hot[index-1];
+}
+
+#if (SIMCLI_USE_BINARY==1)
+/*Finds command by ID in const table of the registry, then in its RAM part. Returns lookup entry*/
+static const cli_cmd_hot_t* ResolveCmdID(const cli_registry_t *registry, uint8_t cmd_ID, const cli_command_t **command, const uint8_t **arg_index)
+{
+	if(cmd_ID==0)
+		return NULL;
+	if(registry->table&&registry->table->id_index[cmd_ID])
+	{
+		uint16_t table_index=registry->table->id_index[cmd_ID];
+		*command=&registry->table->commands[table_index-1];
+		*arg_index=registry->table->arg_index[table_index-1];
+		return &registry->table->hot[table_index-1];
+	}
+	cli_cmd_index_t index=registry->id_index[cmd_ID];
+	if(index==0)
+		return NULL;
+	*command=registry->cold[index-1];
+	*arg_index=registry->arg_index[index-1];
+	return &registry->hot[index-1];
+}
+#endif
+
+/*Fills lookup tables for command description that stays valid while the registry is used*/
+static uint16_t RegisterCommand(cli_registry_t *registry, const cli_command_t *command)
+{
+	if((command->cmd_ID&&registry->id_index[command->cmd_ID])||(command->c_func==NULL)){
+		return 0;}
+	if(registry->table&&(LookupTableName(registry->table,command->cmd_name)||
+		(command->cmd_ID&&registry->table->id_index[command->cmd_ID])))
+		return 0;												/*Name or ID is used by const command set*/
+	if(registry->count>=SIMCLI_MAX_COMMANDS)
+		return 0;
+	/*Name must be non-empty and terminated inside cmd_name[]*/
+	if((command->cmd_name[0]=='\0')||!memchr(command->cmd_name,'\0',sizeof(command->cmd_name)))
+		return 0;
+
+	uint32_t hash=HashName(command->cmd_name);
+	uint32_t slot=hash&(SIMCLI_HASH_SIZE-1);
+	while(registry->name_index[slot])
+	{
+		if(strcmp(registry->hot[registry->name_index[slot]-1].cmd_name,command->cmd_name)==0)
+			return 0;											/*Name is already used*/
+#if (SIMCLI_PERFECT_HASH==1)
+		return 0;												/*Seed doesn't give perfect hash for this command set*/
+#endif
+		slot=(slot+1)&(SIMCLI_HASH_SIZE-1);
+	}
+	if(!CompileCmdArgs(command,registry->arg_index[registry->count]))
+		return 0;
+
+	cli_cmd_hot_t *hot=&registry->hot[registry->count];
+	hot->c_func=command->c_func;
+	hot->name_hash=hash;
+	hot->cmd_ID=command->cmd_ID;
+	memcpy(hot->cmd_name,command->cmd_name,sizeof(hot->cmd_name));
+	registry->cold[registry->count]=command;
+	registry->name_index[slot]=(cli_cmd_index_t)(registry->count+1);
+	if(command->cmd_ID)											/*Commands without ID are found by name only*/
+		registry->id_index[command->cmd_ID]=(cli_cmd_index_t)(registry->count+1);
+	return ++registry->count;
+}
+
+uint16_t AddRegistryCommand(cli_registry_t *registry, const cli_command_t *new_command)
+{
+	if((registry==NULL)||(new_command==NULL))
+		return 0;
+#if (SIMCLI_COMMAND_COPIES > 0)
+	if(registry->copies>=SIMCLI_COMMAND_COPIES)
+		return 0;
+	cli_command_t *stored=&registry->copy_pool[registry->copies];
+	*stored=*new_command;
+	stored->call=NULL;
+	uint16_t count=RegisterCommand(registry,stored);
+	if(count)
+		registry->copies++;
+	return count;
+#else
+	return 0;
+#endif
+}
+
+uint16_t AddRegistryCommandRef(cli_registry_t *registry, const cli_command_t *command)
+{
+	if((registry==NULL)||(command==NULL))
+		return 0;
+	return RegisterCommand(registry,command);
+}
+
+bool SetRegistryTable(cli_registry_t *registry, const cli_command_table_t *table)
+{
+	if(registry==NULL)
+		registry=&DefaultRegistry;
+	CLI_CHECK_NULL(table);
+	if(registry->count||(table->hash_size==0)||(table->hash_size&(table->hash_size-1)))
+		return false;
+	registry->table=table;
+	return true;
+}
+
+const cli_command_t* FindRegistryCmd(const cli_registry_t *registry, const char* cmd_name)
+{
+	const cli_command_t *command;
+	const uint8_t *arg_index;
+	if(registry==NULL)
+		registry=&DefaultRegistry;
+	if((cmd_name==NULL)||(ResolveCmd(registry,cmd_name,&command,&arg_index)==NULL))
+		return NULL;
+	return command;
+}
+
+const cli_command_t* FindRegistryCmdByID(const cli_registry_t *registry, uint8_t cmdID)
+{
+	if(registry==NULL)
+		registry=&DefaultRegistry;
+	if(registry->table&&registry->table->id_index[cmdID])
+		return &registry->table->commands[registry->table->id_index[cmdID]-1];
+	if(registry->id_index[cmdID]==0)
+		return NULL;
+	return registry->cold[registry->id_index[cmdID]-1];
+}
+
+uint8_t AddNewCommand(cli_command_t new_command)
+{
+	return (uint8_t)AddRegistryCommand(&DefaultRegistry,&new_command);
+}
+
+const cli_command_t* FindCmd(const char* cmd_name)
+{
+	return FindRegistryCmd(&DefaultRegistry,cmd_name);
+}
+
+/*Word-at-a-time search of the first CR or LF symbol*/
+static char* FindLineEnd(char *data, size_t length)
+{
+	const uint64_t ones=0x0101010101010101ULL;
+	const uint64_t highs=0x8080808080808080ULL;
+	size_t i=0;
+	for(;i+sizeof(uint64_t)<=length;i+=sizeof(uint64_t))
+	{
+		uint64_t word,lf,cr;
+		memcpy(&word,data+i,sizeof(word));
+		lf=word^(ones*'\n');
+		cr=word^(ones*'\r');
+		if((((lf-ones)&~lf)|((cr-ones)&~cr))&highs)
+			break;
+	}
+	for(;i<length;++i)
+	{
+		if((data[i]=='\n')||(data[i]=='\r'))
+			return &data[i];
+	}
+	return NULL;
+}
+
+/*Dispatcher's copy of command. Command function binds its argument variables in self, so registry stays
+  read-only. Only fields a call uses are copied: cmd_info and args[] slots above args_num stay cold.
+  Argument index and other per-call state are referenced through call, not copied*/
+static void BindCmdCall(cli_command_t *self, const cli_command_t *command, cli_cmd_call_t *call)
+{
+	uint8_t args_num=(command->args_num<SIMCLI_MAX_ARGS)?command->args_num:SIMCLI_MAX_ARGS;
+	memcpy(self->cmd_name,command->cmd_name,sizeof(self->cmd_name));
+	self->args_num=args_num;
+	memcpy(self->args,command->args,args_num*sizeof(self->args[0]));
+	self->c_func=command->c_func;
+	self->cmd_info[0]='\0';
+	self->cmd_ID=command->cmd_ID;
+	self->cmd_context=command->cmd_context;
+	self->cache_ttl=command->cache_ttl;
+	self->cache_version=command->cache_version;
+	self->call=call;
+}
+
+/*Calls command function. self is the per-call copy of command description, start - time when parsing began*/
+static bool RunCmd(cmd_function_t c_func, cli_command_t *self, char **argv, CliContextManager_t * _context, uint32_t start)
+{
+	if(_context)
+	{
+		_context->CmdID=self->cmd_ID;
+		_context->AsyncStarted=0;
+	}
+#if (SIMCLI_USE_STATS==1)
+	cli_cmd_stats_t *stats=&CliStats.cmd[STATS_SLOT(self->cmd_ID)];
+	uint32_t dispatch=SIMCLI_STATS_TIME();
+	self->call->parse_ticks=0;
+	if(_context)
+		_context->StatsCmdID=self->cmd_ID;
+#else
+	UNUSED_PARAMETER(start);
+#endif
+	bool cmd_res=c_func(argv,self,_context);						/*Calling command function*/
+#if (SIMCLI_USE_STATS==1)
+	uint32_t exec_ticks=SIMCLI_STATS_TIME()-dispatch-self->call->parse_ticks;
+	STATS_ADD(stats->calls,1);
+	if(!cmd_res)
+		STATS_ADD(stats->failures,1);
+	STATS_ADD(stats->parse_hist[StatsBucket(dispatch-start+self->call->parse_ticks)],1);
+	STATS_ADD(stats->exec_hist[StatsBucket(exec_ticks)],1);
+#endif
+	return cmd_res;
+}
+
+#if (SIMCLI_CACHE_SLOTS>0)
+/*Cache key: argument tokens, each one followed by '\0', so quoted "a b" and two tokens a b differ.
+  Tokenizer has already dropped extra delimiters and quotes. Abbreviated argument names are replaced
+  with full ones the way ParseCmdArgs() finds them, values are kept as is. Returns false when arguments don't fit*/
+static bool MakeCacheKey(const cli_command_t *command, const cli_cmd_call_t *call, const cli_token_t *tokens, int num_tokens, cli_cache_entry_t *key)
+{
+	uint32_t hash=SIMCLI_HASH_SEED;
+	size_t len=0;
+	bool value=false;
+	for(int i=1;i<num_tokens;++i)
+	{
+		const char *token=tokens[i].ptr;
+		const cmd_arg_t *arg=value?NULL:LookupCmdArg(command,call,token);
+		value=false;
+		if(arg)
+		{
+			token=arg->arg_name;
+			value=(arg->arg_type!=ARG_ONLY);
+		}
+		size_t token_len=strlen(token)+1;
+		if(token_len>SIMCLI_CACHE_KEY_SIZE-len)
+			return false;
+		memcpy(&key->key[len],token,token_len);
+		len+=token_len;
+	}
+	for(size_t i=0;i<len;++i)
+		hash=(hash^(uint8_t)key->key[i])*0x01000193u;
+	key->hash=hash;
+	key->key_len=(uint8_t)len;
+	return true;
+}
+
+static bool CacheEntryValid(const cli_cache_entry_t *entry, uint32_t now, uint32_t epoch)
+{
+	const cli_command_t *command=entry->command;
+	if(entry->epoch!=epoch)
+		return false;
+	if(command->cache_ttl&&((uint32_t)(now-entry->stamp)>=command->cache_ttl))
+		return false;
+	return (command->cache_version==NULL)||(__atomic_load_n(command->cache_version,__ATOMIC_RELAXED)==entry->version);
+}
+
+/*Looks for response of command with key. Stale entries are freed on the way*/
+static cli_cache_entry_t* FindCacheEntry(CliContextManager_t * _context, const cli_command_t *command, const cli_cache_entry_t *key)
+{
+	uint32_t now=SIMCLI_CACHE_TIME();
+	uint32_t epoch=__atomic_load_n(&CacheEpoch,__ATOMIC_RELAXED);
+	cli_cache_entry_t *found=NULL;
+	for(size_t i=0;i<SIMCLI_CACHE_SLOTS;++i)
+	{
+		cli_cache_entry_t *entry=&_context->Cache[i];
+		if(entry->command&&!CacheEntryValid(entry,now,epoch))
+			entry->command=NULL;
+		if((entry->command==command)&&(entry->hash==key->hash)&&(entry->key_len==key->key_len)&&
+			(memcmp(entry->key,key->key,key->key_len)==0))
+			found=entry;
+	}
+	return found;
+}
+
+/*Free slot or the least recently used one*/
+static cli_cache_entry_t* CacheVictim(CliContextManager_t * _context)
+{
+	cli_cache_entry_t *victim=&_context->Cache[0];
+	for(size_t i=0;(i<SIMCLI_CACHE_SLOTS)&&victim->command;++i)
+	{
+		cli_cache_entry_t *entry=&_context->Cache[i];
+		if((entry->command==NULL)||(entry->used<victim->used))
+			victim=entry;
+	}
+	return victim;
+}
+
+/*Keeps response gathered by CliWrite() in CachePending if the command finished synchronously and didn't
+  keep a data context. Only then a slot is taken, so failed or oversized responses don't evict anything*/
+static void StoreCacheEntry(CliContextManager_t * _context, const cli_command_t *command, bool cmd_res, uint8_t level)
+{
+	const cli_cache_entry_t *pending=_context->CacheFill;			/*Reset when response didn't fit*/
+	_context->CacheFill=NULL;
+	if((pending==NULL)||!cmd_res||(_context->context_level!=level)||_context->AsyncStarted)
+		return;
+	cli_cache_entry_t *entry=CacheVictim(_context);
+	entry->hash=pending->hash;
+	entry->key_len=pending->key_len;
+	memcpy(entry->key,pending->key,pending->key_len);
+	entry->length=pending->length;
+	memcpy(entry->data,pending->data,pending->length);
+	entry->stamp=SIMCLI_CACHE_TIME();
+	entry->epoch=__atomic_load_n(&CacheEpoch,__ATOMIC_RELAXED);
+	entry->version=command->cache_version?__atomic_load_n(command->cache_version,__ATOMIC_RELAXED):0;
+	entry->used=++_context->CacheClock;
+	entry->command=command;
+}
+
+static void CacheResponse(CliContextManager_t * _context, const char* data, size_t length)
+{
+	cli_cache_entry_t *entry=_context->CacheFill;
+	if(length>(size_t)(SIMCLI_CACHE_DATA_SIZE-entry->length))
+	{
+		_context->CacheFill=NULL;									/*Response is too long to cache*/
+		return;
+	}
+	memcpy(&entry->data[entry->length],data,length);
+	entry->length=(uint16_t)(entry->length+length);
+}
+#endif
+
+static int8_t DispatchCmd(const char* input_str, size_t length, char* scratch, size_t scratch_size, CliContextManager_t * _context)
+{
+	cli_token_t tokens[SIMCLI_MAX_TOKENS];
+	char *arg_list[SIMCLI_MAX_TOKENS+1];
+	const cli_registry_t *registry=&DefaultRegistry;
+
+	if((input_str==NULL)||(scratch==NULL)||(length>=scratch_size))
+		return 0;
+	uint32_t start=STATS_NOW();
+	if(scratch!=input_str)
+		memcpy(scratch,input_str,length);
+
+	int num_tokens=TokenizeCmdLine(scratch,length,tokens,SIMCLI_MAX_TOKENS);
+	if(num_tokens<=0)
+		return 0;
+	if(_context&&_context->registry)
+		registry=_context->registry;
+	const cli_command_t *command;
+	const uint8_t *arg_index;
+	const cli_cmd_hot_t *hot=ResolveCmd(registry,tokens[0].ptr,&command,&arg_index);	/*Looking for element in list of stored commands*/
+	if((hot==NULL)&&_context&&_context->trie)						/*Abbreviated command name*/
+	{
+		const cli_command_t *full=MatchTrieCmd(_context->trie,tokens[0].ptr);
+		if(full)
+			hot=ResolveCmd(registry,full->cmd_name,&command,&arg_index);
+	}
+	if(hot==NULL)
+		return 0;
+	for(int i=1;i<num_tokens;++i)
+		arg_list[i-1]=tokens[i].ptr;
+	arg_list[num_tokens-1]=NULL;
+	cli_cmd_call_t call={.arg_index=arg_index, .trie=_context?_context->trie:NULL};
+#if (SIMCLI_CACHE_SLOTS>0)
+	bool fill=false;
+	uint8_t level=_context?_context->context_level:0;
+	if(_context&&(command->cache_ttl||command->cache_version)&&(_context->PipeBase==0)&&(_context->CacheFill==NULL)&&
+		MakeCacheKey(command,&call,tokens,num_tokens,&_context->CachePending))
+	{
+		cli_cache_entry_t *entry=FindCacheEntry(_context,command,&_context->CachePending);
+		if(entry)													/*Repeated query: stored response, no parsing and no command call*/
+		{
+			STATS_CACHE_HIT(command->cmd_ID);
+			entry->used=++_context->CacheClock;
+			CliWrite(_context,entry->data,entry->length);
+			if(_context->TxHold==0)
+				CliFlush(_context);
+			return (int8_t)command->cmd_ID;
+		}
+		_context->CachePending.length=0;							/*Cached entries stay until the response is stored*/
+		_context->CacheFill=&_context->CachePending;
+		fill=true;
+	}
+#endif
+	cli_command_t self;
+	BindCmdCall(&self,command,&call);
+	bool cmd_res=RunCmd(hot->c_func,&self,arg_list,_context,start);
+#if (SIMCLI_CACHE_SLOTS>0)
+	if(fill)
+		StoreCacheEntry(_context,command,cmd_res,level);
+#endif
+	if(_context&&(_context->TxHold==0))								/*Response is complete*/
+		CliFlush(_context);
+	return cmd_res?(int8_t)self.cmd_ID:0;
+}
+
+static Context_t* LevelOwner(CliContextManager_t *CLI_cont, uint8_t level)
+{
+	return level?&CLI_cont->CallStack.stackbuf[level-1]:CLI_cont->CallStack.root;
+}
+
+/*Pipeline: output of the writer at DispatchLevel goes to the stage one level below. Writer's buffer
+  is lent to the stage, not copied. Returns number of bytes the stage accepted*/
+static uint32_t PipeWrite(CliContextManager_t * _context, const char* data, size_t length)
+{
+	uint8_t level=(uint8_t)(_context->DispatchLevel-1);
+	if(level>_context->context_level)
+		return 0;													/*Stage is released*/
+	Context_t *stage=LevelOwner(_context,level);
+	char *shared=(char*)(uintptr_t)data;
+	size_t accepted=length;
+	size_t mark=CliArenaMark(_context);
+	STATS_CONTEXT_BYTES(_context,level,length);
+	_context->DispatchLevel=level;
+	if(stage->bulk_handler)
+	{
+		bool complete=false;
+		cli_data_view_t view={{shared,NULL},{length,0}};
+		accepted=stage->bulk_handler(&view,&complete,_context);
+		if(complete)												/*Stage takes no more data. Its stack copy is detached*/
+		{
+			stage->bulk_handler=NULL;
+			stage->context_handler=NULL;
+		}
+	}
+	else if((stage->context_handler==NULL)||!stage->context_handler(shared,length,_context))
+		accepted=0;
+	_context->DispatchLevel=(uint8_t)(level+1);
+	CliArenaRewind(_context,mark);
+	return (uint32_t)accepted;
+}
+
+/*Offset of the next pipe separator: unquoted and unescaped '|' that stands as a separate word.
+  Quotes and escapes are followed the same way as in TokenizeCmdLine(). length - no separator*/
+static size_t FindPipe(const char* line, size_t length)
+{
+	char quote='\0';
+	bool word_start=true;
+	for(size_t pos=0;pos<length;++pos)
+	{
+		char symbol=line[pos];
+		if(quote)
+		{
+			if(symbol==quote)
+				quote='\0';
+			else if(symbol=='\\')
+				++pos;
+		}
+		else if(IsArgDelimiter(symbol))
+		{
+			word_start=true;
+			continue;
+		}
+		else if((symbol=='|')&&word_start&&((pos+1==length)||IsArgDelimiter(line[pos+1])))
+			return pos;
+		else if((symbol=='"')||(symbol=='\''))
+			quote=symbol;
+		else if(symbol=='\\')
+			++pos;
+		word_start=false;
+	}
+	return length;
+}
+
+/*Runs "cmd1 | cmd2 | ..." line. Commands after the first one are run from the last to the second,
+  each of them must acquire data context that becomes a pipeline stage. Then the first command runs,
+  its output flows down the stages through PipeWrite(). At the end every open stage gets a zero
+  length call and all stages are released*/
+static int8_t RunPipeline(const char* input_str, size_t length, size_t first_sep, char* scratch, size_t scratch_size, CliContextManager_t * _context)
+{
+	size_t seps[CLI_STACK_SIZE+1];
+	size_t stages=0;
+	if((_context==NULL)||_context->PipeBase||(input_str==NULL)||(scratch==NULL)||(length>=scratch_size))
+		return 0;														/*Pipelines are not nested*/
+	for(size_t pos=first_sep;pos<length;pos+=1+FindPipe(&input_str[pos+1],length-pos-1))
+	{
+		if(stages>=(size_t)(CLI_STACK_SIZE-_context->context_level))
+			return 0;
+		seps[stages++]=pos;
+	}
+	seps[stages]=length;
+	uint8_t base=(uint8_t)(_context->context_level+1);
+	uint8_t dispatch_level=_context->DispatchLevel;
+	bool ok=true;
+	for(size_t i=stages;ok&&(i>0);--i)								/*Last command becomes the lowest stage*/
+	{
+		size_t start=seps[i-1]+1;
+		uint8_t level=_context->context_level;
+		ok=DispatchCmd(&input_str[start],seps[i]-start,&scratch[start],scratch_size-start,_context)&&
+			(_context->context_level==level+1);
+	}
+	int8_t res=0;
+	uint8_t top=_context->context_level;
+	if(ok)
+	{
+		_context->PipeBase=base;
+		_context->DispatchLevel=(uint8_t)(top+1);					/*First command writes into the top stage*/
+		res=DispatchCmd(input_str,seps[0],scratch,scratch_size,_context);
+		if(_context->context_level!=top)							/*First command can't keep own context*/
+			res=0;
+		for(uint8_t level=top;level>=base;--level)					/*End of stream*/
+		{
+			_context->DispatchLevel=(uint8_t)(level+1);
+			PipeWrite(_context,&scratch[length],0);
+		}
+		_context->PipeBase=0;
+	}
+	while((_context->context_level>=base)&&ReleaseContext(_context))	/*Detached stages too*/
+		;
+	_context->DispatchLevel=dispatch_level;
+	return res;
+}
+
+int8_t ProcessCommandBuf(const char* input_str, size_t length, char* scratch, size_t scratch_size, CliContextManager_t * _context)
+{
+	size_t mark=CliArenaMark(_context);
+	size_t sep=(input_str&&memchr(input_str,'|',length))?FindPipe(input_str,length):length;
+	int8_t res=(sep<length)?RunPipeline(input_str,length,sep,scratch,scratch_size,_context):
+							DispatchCmd(input_str,length,scratch,scratch_size,_context);
+	CliArenaRewind(_context,mark);									/*Releases scratch memory of the command*/
+	return res;
+}
+
+/*Tokenizes a copy of line made in session arena*/
+static int8_t ProcessLineCopy(const char* line, size_t length, CliContextManager_t * _context)
+{
+	if(length>=SIMCLI_MAX_CMD_LEN)
+		return 0;
+	size_t mark=CliArenaMark(_context);
+	char *scratch=CliArenaAlloc(_context,length+1);
+	int8_t res;
+	if(scratch)
+		res=ProcessCommandBuf(line,length,scratch,length+1,_context);
+	else
+	{
+		char duplicate_str[SIMCLI_MAX_CMD_LEN];
+		res=ProcessCommandBuf(line,length,duplicate_str,sizeof(duplicate_str),_context);
+	}
+	CliArenaRewind(_context,mark);
+	return res;
+}
+
+int8_t ProcessCommand(const char* input_str, CliContextManager_t * _context)
+{
+	CLI_CHECK_NULL(input_str);
+	return ProcessLineCopy(input_str,strlen(input_str),_context);
+}
+
+/*Result of one command line of a batch. Returns false to stop the batch*/
+typedef bool (*batch_result_f)(const char* cmd_name, size_t offset, int8_t result, void *state);
+
+/*Copies first word of line before it is tokenized in place. Longer words are cut to size-1 symbols*/
+static void CopyFirstWord(const char* line, size_t length, char* word, size_t size)
+{
+	size_t pos=0;
+	size_t len=0;
+	while((pos<length)&&IsArgDelimiter(line[pos]))
+		++pos;
+	while((pos<length)&&(len+1<size)&&!IsArgDelimiter(line[pos]))
+		word[len++]=line[pos++];
+	word[len]='\0';
+}
+
+/*Walks batch in place: command lines are dispatched, data context sections are lent to the context.
+  Returns number of walked bytes, it is less than length when data context stops consuming data*/
+static size_t WalkBatch(CliContextManager_t * _context, char* batch, size_t length, batch_result_f on_result, void *state, uint64_t *payload_bytes)
+{
+	size_t offset=0;
+	_context->TxHold++;
+	while(offset<length)
+	{
+		char *line=batch+offset;
+		size_t left=length-offset;
+		char *end=FindLineEnd(line,left);
+		size_t line_len=end?(size_t)(end-line):left;
+		size_t used=line_len;
+		if(end)
+			used+=((*end=='\r')&&(line_len+1<left)&&(end[1]=='\n'))?2:1;
+
+		if(_context->context_level)										/*Context acquired inside the batch*/
+		{
+			if(_context->contextOwner->bulk_handler)
+			{
+				cli_data_view_t view={{line,NULL},{left,0}};
+				used=CallContextBulk(_context,&view);
+				if(used==0)
+					break;
+			}
+			else
+				CallContextHandler(_context,line,used);
+			*payload_bytes+=used;
+		}
+		else if(line_len)
+		{
+			int8_t res;
+			char cmd_name[sizeof(((cli_command_t*)0)->cmd_name)];
+			CopyFirstWord(line,line_len,cmd_name,sizeof(cmd_name));
+			if(end)
+				res=ProcessCommandBuf(line,line_len,line,line_len+1,_context);
+			else														/*Last line without line ending*/
+				res=ProcessLineCopy(line,line_len,_context);
+			if(!on_result(cmd_name,offset,res,state))
+			{
+				offset+=used;
+				break;
+			}
+		}
+		offset+=used;
+	}
+	_context->TxHold--;
+	if(_context->TxHold==0)
+		CliFlush(_context);
+	return offset;
+}
+
+typedef struct
+{
+	int8_t* 	results;
+	size_t 		num;
+	size_t 		max;
+}batch_results_t;
+
+static bool StoreBatchResult(const char* cmd_name, size_t offset, int8_t result, void *state)
+{
+	batch_results_t *res=state;
+	UNUSED_PARAMETER(cmd_name);
+	UNUSED_PARAMETER(offset);
+	res->results[res->num++]=result;
+	return res->num<res->max;
+}
+
+size_t ProcessCommandBatch(CliContextManager_t * _context, char* batch, size_t length, int8_t* results, size_t max_results)
+{
+	batch_results_t res={results,0,max_results};
+	uint64_t payload_bytes=0;
+	if((_context==NULL)||(batch==NULL)||(results==NULL)||(max_results==0))
+		return 0;
+	WalkBatch(_context,batch,length,StoreBatchResult,&res,&payload_bytes);
+	return res.num;
+}
+
+typedef struct
+{
+	cli_script_error_f 		on_error;
+	void* 					user_data;
+	cli_script_report_t* 	report;
+}script_state_t;
+
+static bool CountScriptResult(const char* cmd_name, size_t offset, int8_t result, void *state)
+{
+	script_state_t *script=state;
+	script->report->commands++;
+	if(result)
+		return true;
+	script->report->errors++;
+	return (script->on_error==NULL)||script->on_error(offset,cmd_name,script->user_data);
+}
+
+bool RunCliScript(CliContextManager_t * _context, char* script, size_t length, cli_script_error_f on_error, void *user_data, cli_script_report_t *report)
+{
+	cli_script_report_t local;
+	CLI_CHECK_NULL(_context);
+	CLI_CHECK_NULL(script);
+	if(report==NULL)
+		report=&local;
+	memset(report,0,sizeof(*report));
+	script_state_t state={on_error,user_data,report};
+	report->processed=WalkBatch(_context,script,length,CountScriptResult,&state,&report->payload_bytes);
+	return (report->errors==0)&&(report->processed==length);
+}
+
+#if (SIMCLI_USE_BINARY==1)
+/*Sends binary response frame: SIMCLI_BIN_SYNC, payload length, cmd_ID, status, data, CRC-16*/
+static void SendFrame(CliContextManager_t * _context, uint8_t cmd_ID, uint8_t status, const char* data, size_t length)
+{
+	uint8_t header[SIMCLI_BIN_HEADER+2];
+	uint8_t tail[2];
+	header[0]=SIMCLI_BIN_SYNC;
+	header[1]=(uint8_t)(length+2);
+	header[2]=(uint8_t)((length+2)>>8);
+	header[3]=cmd_ID;
+	header[4]=status;
+	uint16_t crc=CliCrc16(&header[1],sizeof(header)-1,0xFFFF);
+	crc=CliCrc16((const uint8_t*)data,length,crc);
+	tail[0]=(uint8_t)crc;
+	tail[1]=(uint8_t)(crc>>8);
+	if(_context->stdoutVecFunc)
+	{
+		cli_iovec_t iov[3];
+		uint8_t iovcnt=0;
+		iov[iovcnt].base=(const char*)header;
+		iov[iovcnt++].length=sizeof(header);
+		if(length)
+		{
+			iov[iovcnt].base=data;
+			iov[iovcnt++].length=length;
+		}
+		iov[iovcnt].base=(const char*)tail;
+		iov[iovcnt++].length=sizeof(tail);
+		_context->stdoutVecFunc(iov,iovcnt,_context);
+	}
+	else
+	{
+		_context->stdoutFunc((const char*)header,sizeof(header));
+		if(length)
+			_context->stdoutFunc(data,length);
+		_context->stdoutFunc((const char*)tail,sizeof(tail));
+	}
+}
+#endif
+
+/*Sends transmit buffer followed by extra data in one output call if possible*/
+static void FlushTx(CliContextManager_t * _context, const char* extra, size_t extra_len)
+{
+#if (SIMCLI_USE_BINARY==1)
+	if(_context->TxFramed)											/*Response of binary command*/
+	{
+		if(_context->TxLen)
+			SendFrame(_context,_context->CmdID,CLI_BIN_MORE,_context->TxBuf,_context->TxLen);
+		while(extra_len)
+		{
+			size_t chunk=(extra_len>SIMCLI_BIN_MAX_DATA)?SIMCLI_BIN_MAX_DATA:extra_len;
+			SendFrame(_context,_context->CmdID,CLI_BIN_MORE,extra,chunk);
+			extra+=chunk;
+			extra_len-=chunk;
+		}
+		_context->TxLen=0;
+		return;
+	}
+#endif
+	if(_context->stdoutVecFunc)
+	{
+		cli_iovec_t iov[2];
+		uint8_t iovcnt=0;
+		if(_context->TxLen)
+		{
+			iov[iovcnt].base=_context->TxBuf;
+			iov[iovcnt++].length=_context->TxLen;
+		}
+		if(extra_len)
+		{
+			iov[iovcnt].base=extra;
+			iov[iovcnt++].length=extra_len;
+		}
+		if(iovcnt)
+			_context->stdoutVecFunc(iov,iovcnt,_context);
+	}
+	else
+	{
+		if(_context->TxLen)
+			_context->stdoutFunc(_context->TxBuf,_context->TxLen);
+		if(extra_len)
+			_context->stdoutFunc(extra,extra_len);
+	}
+	_context->TxLen=0;
+}
+
+uint32_t CliWrite(CliContextManager_t * _context, const char* data, size_t length)
+{
+	if((_context==NULL)||(data==NULL))
+		return 0;
+	if(_context->PipeBase&&(_context->DispatchLevel>_context->PipeBase))
+		return PipeWrite(_context,data,length);
+#if (SIMCLI_CACHE_SLOTS>0)
+	if(_context->CacheFill)
+		CacheResponse(_context,data,length);
+#endif
+	if(_context->TxLen+length>sizeof(_context->TxBuf))
+	{
+		if(length>sizeof(_context->TxBuf)/2)						/*Large data goes out right after buffer contents*/
+		{
+			FlushTx(_context,data,length);
+			return (uint32_t)length;
+		}
+		FlushTx(_context,NULL,0);
+	}
+	memcpy(&_context->TxBuf[_context->TxLen],data,length);
+	_context->TxLen=(uint16_t)(_context->TxLen+length);
+	return (uint32_t)length;
+}
+
+uint32_t CliWriteStr(CliContextManager_t * _context, const char* str)
+{
+	if(str==NULL)
+		return 0;
+	return CliWrite(_context,str,strlen(str));
+}
 
-char* GetNextArgument(char* input_string, const char* delimiter)
+uint32_t CliWriteUint(CliContextManager_t * _context, uint64_t value)
 {
-    return strtok(input_string, delimiter); // Tokenize using delimiter
+	char digits[20];
+	size_t pos=sizeof(digits);
+	do
+	{
+		digits[--pos]=(char)('0'+value%10);
+		value/=10;
+	}while(value);
+	return CliWrite(_context,&digits[pos],sizeof(digits)-pos);
 }
 
+uint32_t CliWriteInt(CliContextManager_t * _context, int64_t value)
+{
+	if(value>=0)
+		return CliWriteUint(_context,(uint64_t)value);
+	if(CliWrite(_context,"-",1)==0)
+		return 0;
+	return 1+CliWriteUint(_context,0-(uint64_t)value);
+}
 
-sim_cli_error ParseCmdArgs(char **argv, cli_command_t* self)
+uint32_t CliWriteHex(CliContextManager_t * _context, uint32_t value, uint8_t digits)
 {
-    uint8_t arg_num=0;
-    bool arg_found;
-    while(argv[arg_num])
-    {
-        arg_found=0;
-        for(int i=0;i<self->args_num;++i)
-        {
-            if(strcmp(argv[arg_num],self->args[i].arg_name)==0)
-            {
-                arg_found=1;
-                switch (self->args[i].arg_type)
-                {
-                    case ARG_ONLY:
-                        *(uint8_t*)(self->args[i].value)=1;
-                        arg_num+=1;
-                        break;
-                    case ARG_STRING:
-                        if (argv[arg_num+1]&&(*argv[arg_num+1]!='-'))
-                        {
-							memcpy((uint32_t*)self->args[i].value,argv[arg_num+1],strlen(argv[arg_num+1])+1);
-                            arg_num+=2;
-                        }
-                        else
-                        {
-                            			//TODO: debug message
-							return SIM_CLI_ARG_MISSING_VALUE;
-                        }
-                        break;
-                    case ARG_INT32:
-                        if (argv[arg_num+1])
-                            {
-                            char* endptr;
-                            int32_t arg_val=strtol(argv[arg_num+1],&endptr,10);
-                            if((argv[arg_num+1])==endptr)
-                            {
-                                			//TODO: debug message
-								return SIM_CLI_ARG_BAD_VALUE;
-                            }
-                            *(int32_t*)(self->args[i].value)=arg_val;
-                            arg_num+=2;
-                            }
-                        break; //exit switch
-                }    
-            break;  //exit for cycle
-            }
-        }
-        if(!arg_found)
-        {
-			//TODO: debug message
-            return SIM_CLI_ARG_UNKNOWN;
-        }
-    }
-    return SIM_CLI_OK;
+	static const char hex_digits[]="0123456789ABCDEF";
+	char out[8];
+	size_t pos=sizeof(out);
+	if(digits>sizeof(out))
+		digits=sizeof(out);
+	do
+	{
+		out[--pos]=hex_digits[value&0x0F];
+		value>>=4;
+	}while(value||(sizeof(out)-pos<digits));
+	return CliWrite(_context,&out[pos],sizeof(out)-pos);
 }
 
-uint8_t AddNewCommand(cli_command_t new_command)
+bool CliFlush(CliContextManager_t * _context)
 {
-    if(FindCmdByID(new_command.cmd_ID)||(new_command.c_func==NULL)){
-        return 0;}
-	if(NumCommandsStored>=SIMCLI_MAX_COMMANDS)
-		return 0;
-    cli_command_list[NumCommandsStored++]=new_command;
-    return ++NumCommandsStored;
+	CLI_CHECK_NULL(_context);
+	FlushTx(_context,NULL,0);
+	return true;
 }
 
-cli_command_t* FindCmd(char* cmd_name)
+/*Flow control message goes out at once, after pending response data*/
+static void FlowSend(CliContextManager_t * _context, const char* msg, size_t length)
 {
-    for(int i =0; i<NumCommandsStored;++i)
-    {
-        if(strcmp(cli_command_list[i].cmd_name, cmd_name)==0)
-            return &cli_command_list[i];
-    }
-    return NULL;
+	FlushTx(_context,msg,length);
 }
 
-int8_t ProcessCommand(const char* input_str, CliContextManager_t * _context)
+/*Sends window update or XON/XOFF for current buffer level of the handler*/
+static void FlowCheck(CliContextManager_t * _context)
+{
+	cli_flow_t *flow=&_context->Flow;
+	if(flow->level==0)
+		return;
+	uint32_t buffered=(flow->buffered<flow->window)?flow->buffered:flow->window;
+	if(flow->mode==CLI_FLOW_XONXOFF)
+	{
+		char msg=0;
+		if(!flow->stopped&&(buffered>=flow->window-flow->window/4))
+			msg=SIMCLI_FLOW_XOFF;
+		else if(flow->stopped&&(buffered<=flow->window/4))
+			msg=SIMCLI_FLOW_XON;
+		if(msg)
+		{
+			flow->stopped=(msg==SIMCLI_FLOW_XOFF);
+			FlowSend(_context,&msg,1);
+		}
+		return;
+	}
+	uint32_t room=flow->window-buffered;
+	if(room<=flow->credit)
+		return;
+	uint32_t grant=room-flow->credit;
+	if((flow->credit>=flow->window/4)&&(grant<flow->window/4))		/*Sender has credit left, small updates are merged*/
+		return;
+	char msg[5]={(char)SIMCLI_FLOW_CREDIT,(char)grant,(char)(grant>>8),(char)(grant>>16),(char)(grant>>24)};
+	flow->credit+=grant;
+	FlowSend(_context,msg,sizeof(msg));
+}
+
+/*Bytes delivered to the context at level*/
+static void FlowReceived(CliContextManager_t * _context, uint8_t level, size_t length)
+{
+	cli_flow_t *flow=&_context->Flow;
+	if((flow->level==0)||(flow->level!=level))
+		return;
+	if(length>flow->credit)
+	{
+		flow->overrun+=(uint32_t)(length-flow->credit);
+		flow->credit=0;
+	}
+	else
+		flow->credit-=(uint32_t)length;
+}
+
+bool SetCliFlowMode(CliContextManager_t * _context, cli_flow_mode_t mode)
+{
+	CLI_CHECK_NULL(_context);
+	if(mode>CLI_FLOW_XONXOFF)
+		return false;
+	_context->Flow.mode=(uint8_t)mode;
+	return true;
+}
+
+bool CliFlowUpdate(CliContextManager_t * _context, uint32_t buffered)
+{
+	CLI_CHECK_NULL(_context);
+	if(_context->Flow.level==0)
+		return false;
+	_context->Flow.buffered=buffered;
+	FlowCheck(_context);
+	return true;
+}
+
+void InvalidateCliCache(CliContextManager_t * _context, const char* cmd_name)
 {
-    char * token=NULL;
-    char *arg_list[SIMCLI_MAX_ARGS+2];
-	cli_command_t *command;
-#if (USE_STATIC_ALLOCATION==1)
-	char* duplicate_str[SIMCLI_MAX_CMD_LEN];
+#if (SIMCLI_CACHE_SLOTS>0)
+	if(_context==NULL)
+	{
+		__atomic_fetch_add(&CacheEpoch,1,__ATOMIC_RELAXED);
+		return;
+	}
+	for(size_t i=0;i<SIMCLI_CACHE_SLOTS;++i)
+	{
+		cli_cache_entry_t *entry=&_context->Cache[i];
+		if(entry->command&&((cmd_name==NULL)||(strcmp(entry->command->cmd_name,cmd_name)==0)))
+			entry->command=NULL;
+	}
 #else
-    memset(arg_list,0,sizeof(arg_list));
-	char* duplicate_str=malloc(strlen(input_str)+2);
+	UNUSED_PARAMETER(_context);
+	UNUSED_PARAMETER(cmd_name);
 #endif
-    strcpy(duplicate_str,input_str);
-	
-    char * end_pos = strchr(duplicate_str, '\0');
-    if(*(end_pos-1)=='\n'||*(end_pos-1)=='\r')
+}
+
+#if (SIMCLI_USE_BINARY==1)
+uint16_t CliCrc16(const uint8_t* data, size_t length, uint16_t crc)
+{
+	for(size_t i=0;i<length;++i)
 	{
-		*(end_pos-1)='\0';
-		if(*(end_pos-2)=='\n'||*(end_pos-2)=='\r')
-			*(end_pos-2)='\0';
+		uint8_t x=(uint8_t)((crc>>8)^data[i]);
+		x^=(uint8_t)(x>>4);
+		crc=(uint16_t)((crc<<8)^((uint16_t)x<<12)^((uint16_t)x<<5)^x);
 	}
-	
-    token =  GetNextArgument(duplicate_str,SIMCLI_ARGS_DELIMITER);
-    if(token)
-    {
-        command=FindCmd(token);								/*Looking for element in list of stored commands*/
-        if(command)
-        {
-            			//TODO: debug message
-			int i=0;
-            token = GetNextArgument(NULL," ");
-            while(token)
-            {
-                arg_list[i] = token;
-                ++i;
-            token = GetNextArgument(NULL,SIMCLI_ARGS_DELIMITER);
-            }
-            if(command->c_func(arg_list,command,_context))  /*Calling command function*/
-			{
-#if (USE_STATIC_ALLOCATION==0)		
-				free (duplicate_str);
+	return crc;
+}
+
+/*Sends last frame of binary command response with data left in transmit buffer*/
+static void EndFramedResponse(CliContextManager_t * _context, uint8_t cmd_ID, uint8_t status)
+{
+	_context->TxFramed=false;
+	SendFrame(_context,cmd_ID,status,_context->TxBuf,_context->TxLen);
+	_context->TxLen=0;
+}
+
+int8_t ProcessCommandFrame(const uint8_t* frame, size_t length, CliContextManager_t * _context)
+{
+	const cli_registry_t *registry=&DefaultRegistry;
+	if((frame==NULL)||(_context==NULL)||(length<SIMCLI_BIN_OVERHEAD+1)||(frame[0]!=SIMCLI_BIN_SYNC))
+		return 0;
+	uint32_t start=STATS_NOW();
+	size_t payload=(size_t)frame[1]|((size_t)frame[2]<<8);
+	uint8_t cmd_ID=frame[SIMCLI_BIN_HEADER];
+	FlushTx(_context,NULL,0);										/*Text output goes before the response*/
+	if((payload+SIMCLI_BIN_OVERHEAD!=length)||
+		(CliCrc16(&frame[1],length-3,0xFFFF)!=(uint16_t)(frame[length-2]|(frame[length-1]<<8))))
+	{
+		SendFrame(_context,cmd_ID,CLI_BIN_BAD_FRAME,NULL,0);
+		return 0;
+	}
+	if(_context->registry)
+		registry=_context->registry;
+	const cli_command_t *command;
+	const uint8_t *arg_index;
+	const cli_cmd_hot_t *hot=ResolveCmdID(registry,cmd_ID,&command,&arg_index);
+	if(hot==NULL)
+	{
+		SendFrame(_context,cmd_ID,CLI_BIN_UNKNOWN_CMD,NULL,0);
+		return 0;
+	}
+	char *arg_list[1]={NULL};
+	cli_command_t self;
+	cli_cmd_call_t call={.arg_index=arg_index, .tlv_args=&frame[SIMCLI_BIN_HEADER+1], .tlv_length=(uint16_t)(payload-1)};	/*Arguments by position, no trie*/
+	BindCmdCall(&self,command,&call);
+	size_t mark=CliArenaMark(_context);
+	_context->TxFramed=true;
+	bool cmd_res=RunCmd(hot->c_func,&self,arg_list,_context,start);
+	uint8_t status=cmd_res?CLI_BIN_OK:CLI_BIN_FAILED;
+	if(cmd_res&&_context->AsyncStarted)								/*Completion callback sends the final status*/
+		status=CLI_BIN_MORE;
+	EndFramedResponse(_context,cmd_ID,status);
+	CliArenaRewind(_context,mark);
+	return cmd_res?(int8_t)cmd_ID:0;
+}
+
+bool CliFrameBegin(cli_frame_writer_t *writer, uint8_t *buf, size_t size, uint8_t cmd_ID)
+{
+	CLI_CHECK_NULL(writer);
+	CLI_CHECK_NULL(buf);
+	if(size<SIMCLI_BIN_OVERHEAD+1)
+		return false;
+	writer->buf=buf;
+	writer->size=size;
+	buf[0]=SIMCLI_BIN_SYNC;
+	buf[SIMCLI_BIN_HEADER]=cmd_ID;
+	writer->length=SIMCLI_BIN_HEADER+1;
+	return true;
+}
+
+bool CliFrameArg(cli_frame_writer_t *writer, uint8_t arg_pos, const void *value, uint8_t length)
+{
+	CLI_CHECK_NULL(writer);
+	if((length&&(value==NULL))||(writer->length+2u+length+2u>writer->size))
+		return false;
+	writer->buf[writer->length]=arg_pos;
+	writer->buf[writer->length+1]=length;
+	if(length)
+		memcpy(&writer->buf[writer->length+2],value,length);
+	writer->length+=2u+length;
+	return true;
+}
+
+size_t CliFrameEnd(cli_frame_writer_t *writer)
+{
+	if((writer==NULL)||(writer->length+2>writer->size)||(writer->length-SIMCLI_BIN_HEADER>0xFFFF))
+		return 0;
+	size_t payload=writer->length-SIMCLI_BIN_HEADER;
+	writer->buf[1]=(uint8_t)payload;
+	writer->buf[2]=(uint8_t)(payload>>8);
+	uint16_t crc=CliCrc16(&writer->buf[1],writer->length-1,0xFFFF);
+	writer->buf[writer->length]=(uint8_t)crc;
+	writer->buf[writer->length+1]=(uint8_t)(crc>>8);
+	return writer->length+2;
+}
 #endif
-                return (int8_t)command->cmd_ID;
-			}
-        }
-    }
 
-#if (USE_STATIC_ALLOCATION==0)
-    free (duplicate_str);
+bool SetCliVectorOutput(CliContextManager_t *ctrl_context_ptr, stdout_vec_f stdout_vec_func, void *user_data)
+{
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	ctrl_context_ptr->stdoutVecFunc=stdout_vec_func;
+	ctrl_context_ptr->userData=user_data;
+	return true;
+}
+
+bool SetCliArena(CliContextManager_t *ctrl_context_ptr, void *block, size_t size)
+{
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	ctrl_context_ptr->Arena.base=block;
+	ctrl_context_ptr->Arena.size=block?size:0;
+	ctrl_context_ptr->Arena.used=0;
+	ctrl_context_ptr->Arena.peak=0;
+	return true;
+}
+
+void* CliArenaAlloc(CliContextManager_t * _context, size_t size)
+{
+	if((_context==NULL)||(_context->Arena.base==NULL))
+		return NULL;
+	cli_arena_t *arena=&_context->Arena;
+	size_t pad=(size_t)(0u-(uintptr_t)(arena->base+arena->used))&(SIMCLI_ARENA_ALIGN-1);
+	size_t free_size=arena->size-arena->used;
+	if((pad>free_size)||(size>free_size-pad))
+		return NULL;
+	void *ptr=arena->base+arena->used+pad;
+	arena->used+=pad+size;									/*Bump*/
+	if(arena->used>arena->peak)
+		arena->peak=arena->used;
+	return ptr;
+}
+
+size_t CliArenaMark(const CliContextManager_t * _context)
+{
+	return _context?_context->Arena.used:0;
+}
+
+void CliArenaRewind(CliContextManager_t * _context, size_t mark)
+{
+	if(_context&&(mark<_context->Arena.used))
+		_context->Arena.used=mark;
+}
+
+cli_async_t* BeginCliAsync(CliContextManager_t * _context, cli_async_step_f step, cli_async_done_f on_done, void *user_data)
+{
+	if(_context==NULL)
+		return NULL;
+	for(uint8_t i=0;i<SIMCLI_ASYNC_SLOTS;++i)
+	{
+		cli_async_t *op=&_context->Async[i];
+		if(op->state!=CLI_ASYNC_FREE)
+			continue;
+		if(++_context->AsyncSeq==0)								/*0 - no operation*/
+			_context->AsyncSeq=1;
+		op->step=step;
+		op->on_done=on_done;
+		op->user_data=user_data;
+		op->handle=_context->AsyncSeq;
+		op->cmd_ID=_context->CmdID;
+#if (SIMCLI_USE_BINARY==1)
+		op->framed=_context->TxFramed;
+#endif
+		op->state=CLI_ASYNC_PENDING;
+		_context->AsyncStarted=op->handle;
+		return op;
+	}
+	return NULL;
+}
+
+bool CompleteCliAsync(CliContextManager_t * _context, uint16_t handle, bool result)
+{
+	CLI_CHECK_NULL(_context);
+	for(uint8_t i=0;i<SIMCLI_ASYNC_SLOTS;++i)
+	{
+		cli_async_t *op=&_context->Async[i];
+		if((op->state==CLI_ASYNC_PENDING)&&(op->handle==handle))
+		{
+			op->state=result?CLI_ASYNC_DONE:CLI_ASYNC_FAILED;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint8_t PollCliAsync(CliContextManager_t * _context)
+{
+	uint8_t pending=0;
+	if(_context==NULL)
+		return 0;
+	for(uint8_t i=0;i<SIMCLI_ASYNC_SLOTS;++i)
+	{
+		cli_async_t *op=&_context->Async[i];
+		if((op->state==CLI_ASYNC_PENDING)&&op->step)
+			op->state=(uint8_t)op->step(op,_context);
+		if((op->state==CLI_ASYNC_DONE)||(op->state==CLI_ASYNC_FAILED))
+		{
+			size_t mark=CliArenaMark(_context);
+#if (SIMCLI_USE_BINARY==1)
+			if(op->framed)
+			{
+				FlushTx(_context,NULL,0);
+				_context->TxFramed=true;
+				_context->CmdID=op->cmd_ID;
+			}
 #endif
-    return 0;
+			if(op->on_done)
+				op->on_done(op,op->state==CLI_ASYNC_DONE,_context);
+#if (SIMCLI_USE_BINARY==1)
+			if(op->framed)
+				EndFramedResponse(_context,op->cmd_ID,(op->state==CLI_ASYNC_DONE)?CLI_BIN_OK:CLI_BIN_FAILED);
+#endif
+			CliArenaRewind(_context,mark);
+			op->state=CLI_ASYNC_FREE;
+		}
+		else if(op->state==CLI_ASYNC_PENDING)
+			pending++;
+	}
+	if(_context->TxHold==0)
+		CliFlush(_context);
+	return pending;
 }
 
-cli_command_t* FindCmdByID(uint8_t cmdID)
+uint8_t CliAsyncPending(const CliContextManager_t * _context)
 {
-    for(int i = 0; i<NumCommandsStored;++i)
-        if(cli_command_list[i].cmd_ID==cmdID)
-            return &cli_command_list[i];
-    return NULL;
+	uint8_t pending=0;
+	for(uint8_t i=0;_context&&(i<SIMCLI_ASYNC_SLOTS);++i)
+	{
+		if(_context->Async[i].state!=CLI_ASYNC_FREE)
+			pending++;
+	}
+	return pending;
+}
+
+uint16_t GetCliAsyncHandle(const CliContextManager_t * _context)
+{
+	return _context?_context->AsyncStarted:0;
+}
+
+const cli_command_t* FindCmdByID(uint8_t cmdID)
+{
+	return FindRegistryCmdByID(&DefaultRegistry,cmdID);
+}
+
+bool AttachCliRegistry(CliContextManager_t *ctrl_context_ptr, const cli_registry_t *registry)
+{
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	ctrl_context_ptr->registry=registry;
+	return true;
+}
+
+const cli_registry_t* GetCliRegistry(const CliContextManager_t *ctrl_context_ptr)
+{
+	if(ctrl_context_ptr&&ctrl_context_ptr->registry)
+		return ctrl_context_ptr->registry;
+	return &DefaultRegistry;
 }
 
-Context_t * PullContextStack(context_stack_t *_stack)
+bool AttachCliTrie(CliContextManager_t *ctrl_context_ptr, const struct cli_trie_t *trie)
 {
-	CLI_CHECK_NULL(_stack);
-	CLI_CHECK_NULL(_stack->currentSize);
-	return _stack->stackbuf[_stack->currentSize--];
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	ctrl_context_ptr->trie=trie;
+	return true;
+}
+
+Context_t* PullContextStack(context_stack_t *_stack)
+{
+	if((_stack==NULL)||(_stack->currentSize==0))
+		return NULL;
+	return &_stack->stackbuf[--_stack->currentSize];
 }
 
+/*Context handler of the level. Level 0 - main context*/
 bool ReleaseContext( CliContextManager_t *CLI_cont)
 {
 	
 	CLI_CHECK_NULL(CLI_cont);
-	CLI_CHECK_NULL(CLI_cont->ParentOwner);
-	CLI_cont->context_level-=1;
+	if(CLI_cont->PipeBase)											/*Running pipeline. Stages are popped by RunPipeline()*/
+	{
+		uint8_t level=CLI_cont->DispatchLevel;
+		if((level<CLI_cont->PipeBase)||(level>CLI_cont->context_level))
+			return false;											/*Caller is not a stage*/
+		Context_t *stage=LevelOwner(CLI_cont,level);
+		stage->bulk_handler=NULL;
+		stage->context_handler=NULL;
+		return true;
+	}
+	if(PullContextStack(&CLI_cont->CallStack)==NULL)
+		return false;										//TODO: debug message
+#if (SIMCLI_USE_STATS==1)
+	uint8_t level=(uint8_t)(CLI_cont->context_level-1);
+	uint32_t hold_ms=SIMCLI_STATS_HOLD_TIME()-CLI_cont->ContextStart[level];
+	STATS_ADD(CliStats.cmd[STATS_SLOT(CLI_cont->ContextCmdID[level])].hold_hist[StatsBucket(hold_ms)],1);
+#endif
+	CLI_cont->context_level=CLI_cont->CallStack.currentSize;
 	CLI_cont->contextOwner=CLI_cont->ParentOwner;
-	CLI_cont->ParentOwner=PullContextStack(&CLI_cont->CallStack);
-				//TODO: debug message
+	if(CLI_cont->Flow.level>CLI_cont->context_level)				/*Flow controlled transfer is over*/
+	{
+		if(CLI_cont->Flow.stopped)
+		{
+			char msg=SIMCLI_FLOW_XON;
+			FlowSend(CLI_cont,&msg,1);
+		}
+		CLI_cont->Flow.level=0;
+		CLI_cont->Flow.stopped=false;
+	}
+	CLI_cont->ParentOwner=CLI_cont->context_level?LevelOwner(CLI_cont,(uint8_t)(CLI_cont->context_level-1)):NULL;
+	if(CLI_cont->TxHold==0)
+		CliFlush(CLI_cont);
 	return true;
 }
 
@@ -189,8 +1927,38 @@ bool InitCLIcontext( CliContextManager_t *ctrl_context_ptr,context_handler_f han
 	strcpy(ctrl_context_ptr->contextOwner->Name,context_name);
 	ctrl_context_ptr->contextOwner->context_handler=handlerfunc;
 	ctrl_context_ptr->CallStack.currentSize=0;
+	ctrl_context_ptr->CallStack.root=ctrl_context_ptr->contextOwner;
+	ctrl_context_ptr->DispatchLevel=0;
+	ctrl_context_ptr->PipeBase=0;
+	memset(&ctrl_context_ptr->Flow,0,sizeof(ctrl_context_ptr->Flow));
+	ctrl_context_ptr->CmdID=0;
+#if (SIMCLI_USE_BINARY==1)
+	ctrl_context_ptr->TxFramed=false;
+#endif
+	ctrl_context_ptr->AsyncStarted=0;
+	memset(ctrl_context_ptr->Async,0,sizeof(ctrl_context_ptr->Async));
+#if (SIMCLI_CACHE_SLOTS>0)
+	ctrl_context_ptr->CacheClock=0;
+	ctrl_context_ptr->CacheFill=NULL;
+	memset(&ctrl_context_ptr->CachePending,0,sizeof(ctrl_context_ptr->CachePending));
+	memset(ctrl_context_ptr->Cache,0,sizeof(ctrl_context_ptr->Cache));
+#endif
 	ctrl_context_ptr->ParentOwner=NULL;
 	ctrl_context_ptr->context_level=0;
+	ctrl_context_ptr->registry=NULL;
+	ctrl_context_ptr->trie=NULL;
+	ctrl_context_ptr->stdoutVecFunc=NULL;
+	ctrl_context_ptr->TxHold=0;
+	ctrl_context_ptr->TxLen=0;
+#if (SIMCLI_ARENA_SIZE>0)
+	SetCliArena(ctrl_context_ptr,ctrl_context_ptr->ArenaBuf,sizeof(ctrl_context_ptr->ArenaBuf));
+#else
+	SetCliArena(ctrl_context_ptr,NULL,0);
+#endif
+#if (SIMCLI_USE_STATS==1)
+	ctrl_context_ptr->StatsCmdID=0;
+#endif
+	memset(&ctrl_context_ptr->LineFramer,0,sizeof(ctrl_context_ptr->LineFramer));
 	if(stdout_func)
 		ctrl_context_ptr->stdoutFunc=stdout_func;
 	else
@@ -202,28 +1970,418 @@ bool CallContextHandler(CliContextManager_t *ctrl_context_ptr, char *data, size_
 {
 	CLI_CHECK_NULL(ctrl_context_ptr);
 	CLI_CHECK_NULL(data);
-	ctrl_context_ptr->contextOwner->context_handler(data,length, ctrl_context_ptr);
+	STATS_CONTEXT_BYTES(ctrl_context_ptr,ctrl_context_ptr->context_level,length);
+	ctrl_context_ptr->DispatchLevel=ctrl_context_ptr->context_level;
+	FlowReceived(ctrl_context_ptr,ctrl_context_ptr->context_level,length);
+	size_t mark=CliArenaMark(ctrl_context_ptr);
+	if(ctrl_context_ptr->contextOwner->context_handler)				/*Context can have bulk_handler only*/
+		ctrl_context_ptr->contextOwner->context_handler(data,length, ctrl_context_ptr);
+	CliArenaRewind(ctrl_context_ptr,mark);
+	FlowCheck(ctrl_context_ptr);
+	if(ctrl_context_ptr->TxHold==0)
+		CliFlush(ctrl_context_ptr);
 	return true;
 }
 
-bool PushContextStack(context_stack_t *_stack, Context_t *_context)
+bool PassDownContext(CliContextManager_t *ctrl_context_ptr, char *data, size_t length)
 {
-	if(_stack->currentSize+1>=CLI_STACK_SIZE)
-		return false;
-	CLI_CHECK_NULL(_stack);
-	CLI_CHECK_NULL(_context);
-	_stack->stackbuf[++_stack->currentSize]=_context;
-	return true;
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	CLI_CHECK_NULL(data);
+	uint8_t level=ctrl_context_ptr->DispatchLevel;
+	if((level<2)||(level>ctrl_context_ptr->context_level))
+		return false;											/*No pipeline level below*/
+	Context_t *next=LevelOwner(ctrl_context_ptr,(uint8_t)(level-1));
+	if(next->context_handler==NULL)
+		return false;											/*Level takes bulk data only or is detached*/
+	STATS_CONTEXT_BYTES(ctrl_context_ptr,level-1,length);
+	ctrl_context_ptr->DispatchLevel=(uint8_t)(level-1);
+	bool ret=next->context_handler(data,length,ctrl_context_ptr);
+	ctrl_context_ptr->DispatchLevel=level;
+	return ret;
+}
+
+static size_t BulkToContext(CliContextManager_t *ctrl_context_ptr, const cli_data_view_t *view)
+{
+	if((ctrl_context_ptr==NULL)||(view==NULL)||(ctrl_context_ptr->context_level==0))
+		return 0;
+	Context_t *owner=ctrl_context_ptr->contextOwner;
+	uint8_t level=ctrl_context_ptr->context_level;
+	size_t consumed=0;
+	STATS_CONTEXT_BYTES(ctrl_context_ptr,ctrl_context_ptr->context_level,view->length[0]+view->length[1]);
+	ctrl_context_ptr->DispatchLevel=ctrl_context_ptr->context_level;
+	size_t mark=CliArenaMark(ctrl_context_ptr);
+	if(owner->bulk_handler==NULL)
+	{
+		for(int i=0;(i<2)&&(ctrl_context_ptr->contextOwner==owner);++i)
+		{
+			FlowReceived(ctrl_context_ptr,level,view->length[i]);
+			if(view->length[i]&&owner->context_handler)
+				owner->context_handler(view->data[i],view->length[i],ctrl_context_ptr);
+			consumed+=view->length[i];
+		}
+		CliArenaRewind(ctrl_context_ptr,mark);
+		FlowCheck(ctrl_context_ptr);
+		return consumed;
+	}
+	bool complete=false;
+	consumed=owner->bulk_handler(view,&complete,ctrl_context_ptr);
+	if(consumed>view->length[0]+view->length[1])					/*Handler can't take more than it was lent*/
+		consumed=view->length[0]+view->length[1];
+	CliArenaRewind(ctrl_context_ptr,mark);
+	FlowReceived(ctrl_context_ptr,level,consumed);
+	if(complete&&(ctrl_context_ptr->contextOwner==owner))
+		ReleaseContext(ctrl_context_ptr);
+	FlowCheck(ctrl_context_ptr);
+	return consumed;
+}
+
+#if (SIMCLI_USE_BINARY==1)
+/*Size of binary frame with given header*/
+static size_t BinFrameSize(const char *header)
+{
+	return ((size_t)(uint8_t)header[1]|((size_t)(uint8_t)header[2]<<8))+SIMCLI_BIN_OVERHEAD;
+}
+
+/*Assembles binary frame in line buffer and executes it. Returns number of used bytes*/
+static size_t FeedFrame(CliContextManager_t *ctrl_context_ptr, char *data, size_t length)
+{
+	cli_line_framer_t *framer=&ctrl_context_ptr->LineFramer;
+	size_t used;
+	if(framer->frame_skip)										/*Rest of too long frame*/
+	{
+		used=(length<framer->frame_skip)?length:framer->frame_skip;
+		framer->frame_skip-=(uint32_t)used;
+		return used;
+	}
+	if((framer->length==0)&&(length>=SIMCLI_BIN_HEADER))
+	{
+		size_t size=BinFrameSize(data);
+		if((size<=length)&&(size<=sizeof(framer->buf)))			/*Whole frame is inside data. No copy*/
+		{
+			ProcessCommandFrame((const uint8_t*)data,size,ctrl_context_ptr);
+			return size;
+		}
+	}
+	size_t need=(framer->length<SIMCLI_BIN_HEADER)?SIMCLI_BIN_HEADER:BinFrameSize(framer->buf);
+	used=need-framer->length;
+	if(used>length)
+		used=length;
+	memcpy(&framer->buf[framer->length],data,used);
+	framer->length=(uint16_t)(framer->length+used);
+	framer->binary=true;
+	if(framer->length<need)
+		return used;
+	if(need==SIMCLI_BIN_HEADER)									/*Header is complete*/
+	{
+		size_t size=BinFrameSize(framer->buf);
+		if(size<=sizeof(framer->buf))
+			return used;
+		FlushTx(ctrl_context_ptr,NULL,0);
+		SendFrame(ctrl_context_ptr,0,CLI_BIN_TOO_LONG,NULL,0);
+		framer->frame_skip=(uint32_t)(size-SIMCLI_BIN_HEADER);
+	}
+	else
+		ProcessCommandFrame((const uint8_t*)framer->buf,need,ctrl_context_ptr);
+	framer->length=0;
+	framer->binary=false;
+	return used;
+}
+#endif
+
+/*Splits input into lines, frames and data context payload. left - bytes not taken because
+  bulk handler of data context consumed nothing, they must be fed again*/
+static bool FeedInput(CliContextManager_t *ctrl_context_ptr, char *data, size_t length, size_t *left)
+{
+	*left=length;
+	CLI_CHECK_NULL(data);
+	*left=0;
+	cli_line_framer_t *framer=&ctrl_context_ptr->LineFramer;
+	bool ret=true;
+	while(length)
+	{
+		if(framer->skip_lf)
+		{
+			framer->skip_lf=false;
+			if(*data=='\n')
+			{
+				++data;
+				--length;
+				continue;
+			}
+		}
+		if(ctrl_context_ptr->context_level)						/*Data context receives raw payload*/
+		{
+			if(ctrl_context_ptr->contextOwner->bulk_handler==NULL)
+				return CallContextHandler(ctrl_context_ptr,data,length);
+			cli_data_view_t view={{data,NULL},{length,0}};
+			size_t consumed=BulkToContext(ctrl_context_ptr,&view);
+			if(consumed==0)
+			{
+				*left=length;
+				return false;
+			}
+			data+=consumed;
+			length-=consumed;
+			continue;
+		}
+#if (SIMCLI_USE_BINARY==1)
+		if(framer->binary||framer->frame_skip||
+			((framer->length==0)&&!framer->overflow&&((uint8_t)*data==SIMCLI_BIN_SYNC)))
+		{
+			size_t used=FeedFrame(ctrl_context_ptr,data,length);
+			data+=used;
+			length-=used;
+			continue;
+		}
+#endif
+		char *end=FindLineEnd(data,length);
+		size_t line_len=end?(size_t)(end-data):length;
+		bool is_cr=end&&(*end=='\r');
+		if(!framer->overflow&&(framer->length+line_len<sizeof(framer->buf)))
+		{
+			if(end&&(framer->length==0))						/*Whole line is inside data. No copy*/
+			{
+				*end='\0';
+				if(line_len)
+				{
+					framer->line_count++;
+					STATS_CONTEXT_BYTES(ctrl_context_ptr,0,line_len);
+					ctrl_context_ptr->DispatchLevel=0;
+					ctrl_context_ptr->contextOwner->context_handler(data,line_len,ctrl_context_ptr);
+				}
+			}
+			else
+			{
+				memcpy(&framer->buf[framer->length],data,line_len);
+				framer->length=(uint16_t)(framer->length+line_len);
+				if(end)
+				{
+					size_t full_len=framer->length;
+					framer->buf[full_len]='\0';
+					framer->length=0;
+					framer->line_count++;
+					STATS_CONTEXT_BYTES(ctrl_context_ptr,0,full_len);
+					ctrl_context_ptr->DispatchLevel=0;
+					ctrl_context_ptr->contextOwner->context_handler(framer->buf,full_len,ctrl_context_ptr);
+				}
+			}
+		}
+		else
+		{
+			framer->overflow=true;
+			framer->length=0;
+		}
+		if(!end)
+			break;
+		if(framer->overflow)
+		{
+			framer->overflow=false;
+			ret=false;
+		}
+		framer->skip_lf=is_cr;
+		data+=line_len+1;
+		length-=line_len+1;
+	}
+	return ret;
+}
+
+size_t CallContextBulk(CliContextManager_t *ctrl_context_ptr, const cli_data_view_t *view)
+{
+	size_t consumed=BulkToContext(ctrl_context_ptr,view);
+	if(ctrl_context_ptr&&(ctrl_context_ptr->TxHold==0))
+		CliFlush(ctrl_context_ptr);
+	return consumed;
+}
+
+bool FeedContextHandler(CliContextManager_t *ctrl_context_ptr, char *data, size_t length)
+{
+	CLI_CHECK_NULL(ctrl_context_ptr);
+	size_t left;
+	bool ret=FeedInput(ctrl_context_ptr,data,length,&left);
+	if(ctrl_context_ptr->TxHold==0)
+		CliFlush(ctrl_context_ptr);
+	return ret;
+}
+
+size_t FeedContextInput(CliContextManager_t *ctrl_context_ptr, char *data, size_t length)
+{
+	if(ctrl_context_ptr==NULL)
+		return 0;
+	size_t left;
+	FeedInput(ctrl_context_ptr,data,length,&left);
+	if(ctrl_context_ptr->TxHold==0)
+		CliFlush(ctrl_context_ptr);
+	return length-left;
+}
+
+Context_t* PushContextStack(context_stack_t *_stack, const Context_t *_context)
+{
+	if((_stack==NULL)||(_context==NULL)||(_stack->currentSize>=CLI_STACK_SIZE))
+		return NULL;
+	Context_t *top=&_stack->stackbuf[_stack->currentSize++];
+	*top=*_context;
+	return top;
 }
 
 bool AcquireContext(CliContextManager_t *context_ptr, Context_t *_context)
 {
 	CLI_CHECK_NULL(context_ptr);
 	CLI_CHECK_NULL(_context);
-	PushContextStack(&context_ptr->CallStack,context_ptr->ParentOwner);
+	if(context_ptr->context_level==0)
+		context_ptr->CallStack.root=context_ptr->contextOwner;
+	/*Context is kept by value: it can belong to per-call copy of the command*/
+	Context_t *top=PushContextStack(&context_ptr->CallStack,_context);
+	if(top==NULL)
+		return false;
 	context_ptr->ParentOwner=context_ptr->contextOwner;
-	context_ptr->contextOwner=_context;
-	context_ptr->context_level++;
+	context_ptr->contextOwner=top;
+#if (SIMCLI_USE_STATS==1)
+	context_ptr->ContextCmdID[context_ptr->context_level]=context_ptr->StatsCmdID;
+	context_ptr->ContextStart[context_ptr->context_level]=SIMCLI_STATS_HOLD_TIME();
+	STATS_ADD(CliStats.cmd[STATS_SLOT(context_ptr->StatsCmdID)].acquires,1);
+#endif
+	context_ptr->context_level=context_ptr->CallStack.currentSize;
+	if(top->rx_window)												/*Sender gets the first window*/
+	{
+		cli_flow_t *flow=&context_ptr->Flow;
+		flow->level=context_ptr->context_level;
+		flow->window=top->rx_window;
+		flow->credit=0;
+		flow->buffered=0;
+		flow->overrun=0;
+		flow->stopped=false;
+		FlowCheck(context_ptr);
+	}
+	return true;
+}
+
+#if (SIMCLI_USE_STATS==1)
+static void LoadCounters(uint32_t *dst, const uint32_t *src, size_t num)
+{
+	for(size_t i=0;i<num;++i)
+		dst[i]=__atomic_load_n(&src[i],__ATOMIC_RELAXED);
+}
+
+static void ClearCounters(uint32_t *dst, size_t num)
+{
+	for(size_t i=0;i<num;++i)
+		__atomic_store_n(&dst[i],0,__ATOMIC_RELAXED);
+}
+
+static void LoadCmdStats(cli_cmd_stats_t *dst, const cli_cmd_stats_t *src)
+{
+	dst->calls=__atomic_load_n(&src->calls,__ATOMIC_RELAXED);
+	dst->failures=__atomic_load_n(&src->failures,__ATOMIC_RELAXED);
+	dst->cache_hits=__atomic_load_n(&src->cache_hits,__ATOMIC_RELAXED);
+	dst->acquires=__atomic_load_n(&src->acquires,__ATOMIC_RELAXED);
+	dst->context_bytes=__atomic_load_n(&src->context_bytes,__ATOMIC_RELAXED);
+	LoadCounters(dst->parse_hist,src->parse_hist,SIMCLI_STATS_BUCKETS);
+	LoadCounters(dst->exec_hist,src->exec_hist,SIMCLI_STATS_BUCKETS);
+	LoadCounters(dst->hold_hist,src->hold_hist,SIMCLI_STATS_BUCKETS);
+}
+
+bool GetCliStats(cli_stats_t *snapshot)
+{
+	CLI_CHECK_NULL(snapshot);
+	LoadCounters(snapshot->errors,CliStats.errors,SIMCLI_ERRORS_NUM);
+	snapshot->main_bytes=__atomic_load_n(&CliStats.main_bytes,__ATOMIC_RELAXED);
+	for(size_t i=0;i<SIMCLI_STATS_IDS;++i)
+		LoadCmdStats(&snapshot->cmd[i],&CliStats.cmd[i]);
+	return true;
+}
+
+void ResetCliStats(void)
+{
+	ClearCounters(CliStats.errors,SIMCLI_ERRORS_NUM);
+	__atomic_store_n(&CliStats.main_bytes,0,__ATOMIC_RELAXED);
+	for(size_t i=0;i<SIMCLI_STATS_IDS;++i)
+	{
+		cli_cmd_stats_t *cmd=&CliStats.cmd[i];
+		__atomic_store_n(&cmd->calls,0,__ATOMIC_RELAXED);
+		__atomic_store_n(&cmd->failures,0,__ATOMIC_RELAXED);
+		__atomic_store_n(&cmd->cache_hits,0,__ATOMIC_RELAXED);
+		__atomic_store_n(&cmd->acquires,0,__ATOMIC_RELAXED);
+		__atomic_store_n(&cmd->context_bytes,0,__ATOMIC_RELAXED);
+		ClearCounters(cmd->parse_hist,SIMCLI_STATS_BUCKETS);
+		ClearCounters(cmd->exec_hist,SIMCLI_STATS_BUCKETS);
+		ClearCounters(cmd->hold_hist,SIMCLI_STATS_BUCKETS);
+	}
+}
+
+static void WriteHistogram(CliContextManager_t * _context, const char* name, const uint32_t *hist)
+{
+	CliWriteStr(_context,name);
+	for(uint8_t b=0;b<SIMCLI_STATS_BUCKETS;++b)
+	{
+		if(hist[b]==0)
+			continue;
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,b);
+		CliWrite(_context,":",1);
+		CliWriteUint(_context,hist[b]);
+	}
+	CliWrite(_context,"\n",1);
+}
+
+/*Prints "ID calls failures cache_hits acquires context_bytes" line and histograms (bucket:count) of every called command*/
+static bool StatsCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	cli_cmd_stats_t stats;											/*Snapshot of one command. Whole cli_stats_t is too large for stack*/
+	uint8_t reset=0;
+	self->args[0].value=&reset;
+	if(ParseCmdArgs(argv,self)!=SIM_CLI_OK)
+		return false;
+	if(reset)
+	{
+		ResetCliStats();
+		return true;
+	}
+	CliWriteStr(_context,"errors:");
+	for(uint8_t i=0;i<SIMCLI_ERRORS_NUM;++i)
+	{
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,__atomic_load_n(&CliStats.errors[i],__ATOMIC_RELAXED));
+	}
+	CliWriteStr(_context,"\nmain bytes: ");
+	CliWriteUint(_context,__atomic_load_n(&CliStats.main_bytes,__ATOMIC_RELAXED));
+	CliWriteStr(_context,"\nid calls fail hits acq bytes\n");
+	for(uint16_t id=0;id<SIMCLI_STATS_IDS;++id)
+	{
+		if((__atomic_load_n(&CliStats.cmd[id].calls,__ATOMIC_RELAXED)==0)&&(__atomic_load_n(&CliStats.cmd[id].cache_hits,__ATOMIC_RELAXED)==0))
+			continue;
+		LoadCmdStats(&stats,&CliStats.cmd[id]);
+		CliWriteUint(_context,id);
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,stats.calls);
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,stats.failures);
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,stats.cache_hits);
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,stats.acquires);
+		CliWrite(_context," ",1);
+		CliWriteUint(_context,stats.context_bytes);
+		CliWrite(_context,"\n",1);
+		WriteHistogram(_context," parse:",stats.parse_hist);
+		WriteHistogram(_context," exec:",stats.exec_hist);
+		if(stats.acquires)
+			WriteHistogram(_context," hold:",stats.hold_hist);
+	}
 	return true;
 }
 
+uint16_t AddStatsCommand(cli_registry_t *registry, uint8_t cmd_ID)
+{
+	cli_command_t stats=
+	{
+		.cmd_name="stats",
+		.args_num=1,
+		.args={{.arg_name="-r", .arg_type=ARG_ONLY}},
+		.c_func=StatsCmd,
+		.cmd_info="Prints command statistics, -r clears them",
+		.cmd_ID=cmd_ID
+	};
+	return AddRegistryCommand(registry?registry:&DefaultRegistry,&stats);
+}
+#endif
+
@@ -43,24 +43,141 @@
 /*Forward declarations*/
 struct cli_command_t;
 typedef struct cli_command_t cli_command_s; 
+struct cli_registry_t;
+typedef struct cli_registry_t cli_registry_t;
+struct cli_trie_t;
 
 #ifndef USE_STATIC_ALLOCATION                     		
-    #define USE_STATIC_ALLOCATION 		0					/*Use static memory allocation only. Command length will be limited to SIMCLI_MAX_CMD_LEN*/
+    #define USE_STATIC_ALLOCATION 		0					/*Use static memory allocation only*/
 #endif
 
-#if (USE_STATIC_ALLOCATION==0)
-	#define SIMCLI_MAX_CMD_LEN 			128          	    /*Max length of a single command line with arguments*/
+#ifndef SIMCLI_MAX_CMD_LEN
+	#define SIMCLI_MAX_CMD_LEN 			128          	    /*Max length of a single command line with arguments. Size of ProcessCommand() scratch buffer*/
 #endif
 
 #ifndef SIMCLI_MAX_COMMANDS                     			/*Max commands number that can be is your system*/
     #define SIMCLI_MAX_COMMANDS 		10
 #endif
 
+#ifndef SIMCLI_COMMAND_COPIES
+	#define SIMCLI_COMMAND_COPIES 		SIMCLI_MAX_COMMANDS	/*Commands that can be added by copy (AddNewCommand(), AddRegistryCommand()).
+															  Decrease it when commands are added by reference to const tables*/
+#endif
+
+#if (SIMCLI_MAX_COMMANDS < 255)
+	typedef uint8_t 	cli_cmd_index_t;					/*Index type in command dispatch tables. Holds command position + 1, 0 - empty slot*/
+#else
+	typedef uint16_t 	cli_cmd_index_t;
+#endif
+
+#ifndef SIMCLI_HASH_SIZE									/*Number of slots in command name hash index. Power of 2, at least twice SIMCLI_MAX_COMMANDS*/
+	#if (SIMCLI_MAX_COMMANDS <= 8)
+		#define SIMCLI_HASH_SIZE 		16
+	#elif (SIMCLI_MAX_COMMANDS <= 16)
+		#define SIMCLI_HASH_SIZE 		32
+	#elif (SIMCLI_MAX_COMMANDS <= 32)
+		#define SIMCLI_HASH_SIZE 		64
+	#elif (SIMCLI_MAX_COMMANDS <= 64)
+		#define SIMCLI_HASH_SIZE 		128
+	#elif (SIMCLI_MAX_COMMANDS <= 128)
+		#define SIMCLI_HASH_SIZE 		256
+	#elif (SIMCLI_MAX_COMMANDS <= 256)
+		#define SIMCLI_HASH_SIZE 		512
+	#elif (SIMCLI_MAX_COMMANDS <= 512)
+		#define SIMCLI_HASH_SIZE 		1024
+	#elif (SIMCLI_MAX_COMMANDS <= 1024)
+		#define SIMCLI_HASH_SIZE 		2048
+	#else
+		#define SIMCLI_HASH_SIZE 		4096
+	#endif
+#endif
+
+#ifndef SIMCLI_HASH_SEED
+	#define SIMCLI_HASH_SEED 			0x811C9DC5u			/*Initial value of command name hash (FNV-1a offset basis)*/
+#endif
+
+#ifndef SIMCLI_PERFECT_HASH
+	#define SIMCLI_PERFECT_HASH 		0					/*1 - command set is fixed and SIMCLI_HASH_SEED maps every name to its own slot.
+															  Lookup makes a single probe, AddNewCommand() rejects colliding names*/
+#endif
+
 #define SIMCLI_MAX_ARGS 				8              		/*Max number of arguments in a single command*/
-#define CLI_STACK_SIZE  				4					/*Max number of CLI context levels*/
+#define SIMCLI_ARG_HASH_SIZE 			16					/*Slots in per-command argument name index. Power of 2, greater than SIMCLI_MAX_ARGS*/
+#define SIMCLI_MAX_TOKENS 				(2*SIMCLI_MAX_ARGS+1)	/*Max number of tokens in command line: command name, arguments and their values*/
+#ifndef CLI_STACK_SIZE
+	#define CLI_STACK_SIZE  			4					/*Max number of acquired data contexts (nesting depth). 1..254*/
+#endif
+
+#if (CLI_STACK_SIZE<1)||(CLI_STACK_SIZE>254)
+	#error "CLI_STACK_SIZE must be in 1..254 range"
+#endif
+
+#ifndef SIMCLI_TX_BUF_SIZE
+	#define SIMCLI_TX_BUF_SIZE 			256					/*Size of session buffer that gathers response data*/
+#endif
+
+#ifndef SIMCLI_ARENA_SIZE
+	#define SIMCLI_ARENA_SIZE 			(2*SIMCLI_MAX_CMD_LEN)	/*Size of session scratch arena. 0 - no inline block, it is set by SetCliArena()*/
+#endif
+#define SIMCLI_ARENA_ALIGN 				8					/*Alignment of arena allocations. Power of 2*/
+
+#ifndef SIMCLI_ASYNC_SLOTS
+	#define SIMCLI_ASYNC_SLOTS 			4					/*Max number of pending asynchronous commands per session*/
+#endif
+
+#ifndef SIMCLI_USE_BINARY
+	#define SIMCLI_USE_BINARY 			1					/*1 - binary command frames are accepted on the same input as text lines*/
+#endif
+
+#if (SIMCLI_USE_BINARY==1)
+	#define SIMCLI_BIN_SYNC 			0xA5				/*First byte of binary frame. Text lines never start with it*/
+	#define SIMCLI_BIN_HEADER 			3					/*Sync byte and 16-bit payload length*/
+	#define SIMCLI_BIN_OVERHEAD 		5					/*Header and CRC-16*/
+	#define SIMCLI_BIN_MAX_DATA 		0xFFFD				/*Max response data in one frame*/
+#endif
+
+#ifndef SIMCLI_FLOW_XON
+	#define SIMCLI_FLOW_XON 			0x11				/*Flow control: sender may resume*/
+	#define SIMCLI_FLOW_XOFF 			0x13				/*Flow control: sender must pause*/
+	#define SIMCLI_FLOW_CREDIT 			0x12				/*Flow control: first byte of window update*/
+#endif
 
 #define SIMCLI_ARGS_DELIMITER 			" "					/*Symbols that separate arguments in command line*/
 
+#ifndef SIMCLI_USE_STATS
+	#define SIMCLI_USE_STATS 			0					/*1 - per-command call counters, latency histograms and data context statistics*/
+#endif
+
+#if (SIMCLI_USE_STATS==1)
+	#ifndef SIMCLI_STATS_IDS
+		#define SIMCLI_STATS_IDS 		64					/*Commands with cmd_ID below this value get own counters, the rest share slot 0*/
+	#endif
+	#define SIMCLI_STATS_BUCKETS 		16					/*Histogram bucket b counts durations of 4^b..4^(b+1)-1 ticks*/
+	/*SIMCLI_STATS_TIME() returns uint32_t timestamp in ticks, it times parsing and command execution. Durations must be
+	  shorter than 2^32 ticks. Defaults to CLOCK_MONOTONIC nanoseconds on POSIX hosts (4.29 s), on other targets define
+	  it to read a cycle counter or a free running timer.
+	  SIMCLI_STATS_HOLD_TIME() returns uint32_t timestamp in milliseconds, it times context holds, which can last for
+	  minutes. Defaults to CLOCK_MONOTONIC milliseconds on POSIX hosts, on other targets define it to read a tick counter*/
+#endif
+
+#ifndef SIMCLI_CACHE_SLOTS
+	#define SIMCLI_CACHE_SLOTS 			0					/*Cached responses of query commands per session, LRU replacement. 0 - no response cache*/
+#endif
+
+#if (SIMCLI_CACHE_SLOTS>0)
+	#ifndef SIMCLI_CACHE_DATA_SIZE
+		#define SIMCLI_CACHE_DATA_SIZE 	128					/*Max size of cached response. Longer responses are not cached*/
+	#endif
+	#ifndef SIMCLI_CACHE_KEY_SIZE
+		#define SIMCLI_CACHE_KEY_SIZE 	32					/*Max size of normalized arguments. Commands with longer arguments are not cached*/
+	#endif
+	#if (SIMCLI_CACHE_DATA_SIZE>0xFFFF)||(SIMCLI_CACHE_KEY_SIZE>0xFF)
+		#error "SIMCLI_CACHE_DATA_SIZE must be below 65536 and SIMCLI_CACHE_KEY_SIZE below 256"
+	#endif
+	/*SIMCLI_CACHE_TIME() returns uint32_t timestamp in milliseconds for cache_ttl. Defaults to CLOCK_MONOTONIC on POSIX hosts,
+	  on other targets define it to read a millisecond tick counter*/
+#endif
+
 #define SIMPLE_CLI_DEF(_name)                           \
     static Context_t _context_;							\
 	static CliContextManager_t _name = {		       		\
@@ -73,9 +190,16 @@ typedef struct cli_command_t cli_command_s;
  */
 typedef enum
 {
-      ARG_ONLY = 0         			/*Plain argument without values*/
+      ARG_ONLY = 0         			/*Plain argument without values. Sets uint8_t value to 1*/
     , ARG_INT32           			/*Argument must be followed by int32 format value*/
-    , ARG_STRING     				/*Argument must be followed by string format value*/
+    , ARG_STRING     				/*Argument must be followed by string format value. Limited by value_size if it is set*/
+    , ARG_UINT32          			/*Argument must be followed by uint32 format value*/
+    , ARG_INT64           			/*Argument must be followed by int64 format value*/
+    , ARG_HEX             			/*Argument must be followed by hexadecimal value with optional 0x prefix. Stored as uint32_t*/
+    , ARG_BOOL            			/*Argument must be followed by 1/0, true/false, on/off or yes/no. Stored as bool*/
+    , ARG_ENUM            			/*Argument must be followed by one of enum_list[] strings. Its position is stored as uint8_t*/
+    , ARG_FLOAT           			/*Argument must be followed by decimal value with optional fraction and exponent. Stored as float*/
+    , ARG_SIZE            			/*Argument must be followed by byte size with optional k, M or G suffix (4k, 1M). Stored as uint32_t*/
 }arg_type_t;
 
 /**
@@ -88,8 +212,38 @@ typedef enum
 	, SIM_CLI_ARG_UNKNOWN			/*Parsed argument not from command args list*/
 	, SIM_CLI_ARG_BAD_VALUE			/*Bad value is passed after argument*/
 	, SIM_CLI_ARG_MISSING_VALUE		/*No value after argument*/
+	, SIM_CLI_ARG_OUT_OF_RANGE		/*Value doesn't fit into argument type*/
+	, SIM_CLI_ARG_TOO_LONG			/*String value doesn't fit into value_size bytes*/
+	, SIM_CLI_NO_MEMORY				/*Session arena has no room for argument values*/
 }sim_cli_error;
 
+#if (SIMCLI_USE_BINARY==1)
+/**
+ * @brief Status byte of binary response frame
+ */
+typedef enum
+{
+	  CLI_BIN_OK = 0				/*Command succeeded. Last frame of response*/
+	, CLI_BIN_FAILED				/*Command function returned false. Last frame of response*/
+	, CLI_BIN_MORE					/*Part of response, more frames follow*/
+	, CLI_BIN_BAD_FRAME				/*Wrong CRC or payload length*/
+	, CLI_BIN_UNKNOWN_CMD			/*No command with cmd_ID of the frame*/
+	, CLI_BIN_TOO_LONG				/*Frame doesn't fit into SIMCLI_MAX_CMD_LEN bytes*/
+}cli_bin_status_t;
+
+/**
+ * @brief Builds binary request frame
+ */
+typedef struct
+{
+	uint8_t* 	buf;				/*Frame buffer*/
+	size_t 		size;				/*Size of frame buffer*/
+	size_t 		length;				/*Bytes written*/
+}cli_frame_writer_t;
+#endif
+
+#define SIMCLI_ERRORS_NUM 				(SIM_CLI_NO_MEMORY+1)	/*Number of sim_cli_error codes*/
+
 /**
  * @brief Contains info about command argument
  * 
@@ -97,10 +251,22 @@ typedef enum
 typedef struct
 {
     char 		arg_name[10];       /*Name of the argument: Ex: -n or -help*/
+    uint16_t 	value_size;			/*ARG_STRING: size of value buffer including '\0'. 0 - not limited*/
     arg_type_t 	arg_type;        	/*Type of the value that expected to be after argument. */
     void* 		value;            	/*Place for the pointer to command argument value.*/
+    const char* const* enum_list;	/*ARG_ENUM: NULL-terminated list of allowed values*/
 }cmd_arg_t;
 
+/**
+ * @brief Argument view produced by TokenizeCmdLine()
+ * 
+ */
+typedef struct
+{
+	char* 		ptr;				/*First character of the argument. Argument is '\0'-terminated*/
+	size_t 		length;				/*Argument length without terminating '\0'*/
+}cli_token_t;
+
 /**
  * @brief Context handler function
  * @param data 		Pointer to data array
@@ -110,6 +276,26 @@ typedef struct
 */
 typedef bool (*context_handler_f)(char *data, size_t length, void * _context);
 
+/**
+ * @brief Data region lent to bulk context handler. Second segment is used when 
+ * region wraps around the end of DMA or ring buffer, otherwise its length is 0
+ */
+typedef struct
+{
+	char* 		data[2];			/*Segments of data region*/
+	size_t 		length[2];			/*Number of bytes in each segment*/
+}cli_data_view_t;
+
+/**
+ * @brief Bulk context handler function. Handles data in place, without copying
+ * @param view 		Data region. Valid only during the call
+ * @param complete 	[out] Set to true when transfer is finished. Context is released by context manager
+ * @param _context 	Pointer to CliContextManager_t object
+ * @return Number of bytes consumed from the beginning of view. Larger value is cut to view size.
+ * 0 - handler can't take data now, FeedContextInput() returns the rest to its caller
+*/
+typedef size_t (*context_bulk_f)(const cli_data_view_t *view, bool *complete, void * _context);
+
 /**
 * @brief Context handler structure
 */ 
@@ -117,19 +303,175 @@ typedef struct
 {
 	char 				Name[16];			/*Context handler name*/
 	context_handler_f 	context_handler;	/*Context handler function*/
+	context_bulk_f 		bulk_handler;		/*Bulk data handler function. Can be NULL*/
+	uint32_t 			rx_window;			/*Flow control receive window, bytes. 0 - no flow control*/
 }Context_t;
 
 /**
-* @brief Context handlers stack. Used to save context switching operations
+* @brief Context handlers stack. Acquired contexts are kept by value, level N is stackbuf[N-1]
 */
 typedef struct
 {
 	uint8_t 	currentSize;					/*Number of elements in stack*/
-	Context_t* 	stackbuf[CLI_STACK_SIZE];		/*Array of saved context_t-type pointers*/
+	Context_t* 	root;							/*Main context (level 0). It is not stored in stackbuf*/
+	Context_t 	stackbuf[CLI_STACK_SIZE];		/*Acquired contexts*/
 }context_stack_t;
 
 typedef uint32_t (*stdout_f)(const char *data, size_t length);
 
+/**
+ * @brief Output segment of vectored output function
+ */
+typedef struct
+{
+	const char* base;				/*Segment data*/
+	size_t 		length;				/*Number of bytes in segment*/
+}cli_iovec_t;
+
+/**
+ * @brief Vectored output function. Sends all segments as one response, e.g. by one writev() or DMA transfer
+ * @param iov 		Array of segments
+ * @param iovcnt 	Number of segments
+ * @param _context 	Pointer to CliContextManager_t object
+ * @return Number of bytes sent
+ */
+typedef uint32_t (*stdout_vec_f)(const cli_iovec_t *iov, uint8_t iovcnt, void * _context);
+
+#if (SIMCLI_CACHE_SLOTS>0)
+/**
+ * @brief Cached response of a command. Key is the command and its normalized arguments
+ */
+typedef struct
+{
+	const cli_command_s* 	command;					/*Command in the registry. NULL - free slot*/
+	uint32_t 				hash;						/*Hash of key*/
+	uint32_t 				stamp;						/*SIMCLI_CACHE_TIME() when response was stored*/
+	uint32_t 				version;					/*Value of cache_version counter when response was stored*/
+	uint32_t 				epoch;						/*Value of global invalidation counter when response was stored*/
+	uint32_t 				used;						/*Session LRU clock of the last use*/
+	uint16_t 				length;						/*Response size*/
+	uint8_t 				key_len;
+	char 					key[SIMCLI_CACHE_KEY_SIZE];	/*Argument tokens, each one followed by '\0'*/
+	char 					data[SIMCLI_CACHE_DATA_SIZE];	/*Response*/
+}cli_cache_entry_t;
+#endif
+
+/**
+* @brief Line assembler state. Keeps unfinished command line between FeedContextHandler() calls
+*/
+typedef struct
+{
+	uint16_t 	length;							/*Number of bytes of unfinished line stored in buf*/
+	bool 		skip_lf;						/*Previous line ended with CR. LF that follows it is a part of CRLF pair*/
+	bool 		overflow;						/*Current line doesn't fit into buf and is being discarded*/
+	uint32_t 	line_count;						/*Number of lines passed to main context handler*/
+#if (SIMCLI_USE_BINARY==1)
+	bool 		binary;							/*buf holds unfinished binary frame*/
+	uint32_t 	frame_skip;						/*Bytes of too long binary frame that are still to be discarded*/
+#endif
+	char 		buf[SIMCLI_MAX_CMD_LEN];		/*Unfinished command line or binary frame*/
+}cli_line_framer_t;
+
+/**
+* @brief Bump allocator of per-command scratch memory. Rewound in O(1) when command returns
+*/
+typedef struct
+{
+	char* 		base;							/*Arena block. NULL - arena is disabled*/
+	size_t 		size;							/*Size of the block*/
+	size_t 		used;							/*Bytes allocated by commands being executed*/
+	size_t 		peak;							/*Max used value since the block was set*/
+}cli_arena_t;
+
+/**
+ * @brief Flow control messages sent to the data sender through session output
+ */
+typedef enum
+{
+	  CLI_FLOW_CREDIT = 0			/*Window updates: SIMCLI_FLOW_CREDIT byte, then 32-bit little-endian number of bytes sender may send more*/
+	, CLI_FLOW_XONXOFF				/*SIMCLI_FLOW_XOFF when handler buffers are 3/4 full, SIMCLI_FLOW_XON when they are drained below 1/4*/
+}cli_flow_mode_t;
+
+/**
+ * @brief Flow control state of the data context acquired with rx_window
+ */
+typedef struct
+{
+	uint8_t 	mode;							/*cli_flow_mode_t*/
+	uint8_t 	level;							/*Context level under flow control. 0 - none*/
+	bool 		stopped;						/*XOFF is sent*/
+	uint32_t 	window;							/*Receive window of the context*/
+	uint32_t 	credit;							/*Bytes the sender may still send*/
+	uint32_t 	buffered;						/*Bytes held by the handler, reported by CliFlowUpdate()*/
+	uint32_t 	overrun;						/*Bytes received beyond the credit*/
+}cli_flow_t;
+
+/**
+ * @brief State of asynchronous command
+ */
+typedef enum
+{
+	  CLI_ASYNC_FREE = 0			/*Slot is not used*/
+	, CLI_ASYNC_PENDING				/*Operation is running*/
+	, CLI_ASYNC_DONE				/*Operation finished successfully, completion callback is not called yet*/
+	, CLI_ASYNC_FAILED				/*Operation failed, completion callback is not called yet*/
+}cli_async_state_t;
+
+struct cli_async_t;
+
+/**
+ * @brief Step function of asynchronous command. Called by PollCliAsync() while operation is pending.
+ * Must not block: it checks or advances the operation and returns at once
+ * @param op 		Operation object
+ * @param _context 	Pointer to CliContextManager_t object
+ * @return CLI_ASYNC_PENDING - not finished yet, CLI_ASYNC_DONE or CLI_ASYNC_FAILED - operation result
+ */
+typedef cli_async_state_t (*cli_async_step_f)(struct cli_async_t *op, void * _context);
+
+/**
+ * @brief Completion callback of asynchronous command. Writes command response with CliWrite()
+ * @param op 		Operation object. Slot is freed after the call
+ * @param result 	True - operation succeeded
+ * @param _context 	Pointer to CliContextManager_t object
+ */
+typedef void (*cli_async_done_f)(struct cli_async_t *op, bool result, void * _context);
+
+/**
+ * @brief Pending asynchronous command. Slots are kept in the session
+ */
+typedef struct cli_async_t
+{
+	cli_async_step_f 	step;						/*Advances operation. NULL - operation is finished by CompleteCliAsync()*/
+	cli_async_done_f 	on_done;					/*Completion callback. Can be NULL*/
+	void* 				user_data;					/*Operation state*/
+	uint16_t 			handle;						/*Operation handle. Not 0*/
+	uint8_t 			cmd_ID;						/*Command that started operation*/
+	volatile uint8_t 	state;						/*cli_async_state_t. Can be changed from interrupt by CompleteCliAsync()*/
+#if (SIMCLI_USE_BINARY==1)
+	bool 				framed;						/*Started by binary frame, response is sent as binary frames*/
+#endif
+}cli_async_t;
+
+
+/**
+ * @brief Counters of RunCliScript()
+ */
+typedef struct
+{
+	uint32_t 	commands;						/*Command lines executed*/
+	uint32_t 	errors;							/*Command lines that failed*/
+	uint64_t 	payload_bytes;					/*Bytes lent to data contexts*/
+	size_t 		processed;						/*Bytes walked. Less than script length - data context stopped consuming data*/
+}cli_script_report_t;
+
+/**
+ * @brief Error callback of RunCliScript()
+ * @param offset 	Offset of failed line in the script
+ * @param cmd_name 	First word of failed line, NUL-terminated copy cut to 15 symbols. Line itself is tokenized in place
+ * @param user_data User pointer
+ * @return True - continue the script, False - stop it
+ */
+typedef bool (*cli_script_error_f)(size_t offset, const char* cmd_name, void *user_data);
 
 /**
 * @brief Context controller stucture
@@ -141,17 +483,66 @@ typedef struct
 	Context_t*		ParentOwner;		/*Pointer to higher level context handler*/ 
 	context_stack_t	CallStack;			/*Context handlers stack*/
 	stdout_f		stdoutFunc;			/*Function that handles stdout data transfer*/
+	cli_line_framer_t LineFramer;		/*Splits input stream passed to FeedContextHandler() into lines*/
+	const cli_registry_t *registry;		/*Command set of the session. NULL - commands added by AddNewCommand()*/
+	const struct cli_trie_t *trie;		/*Names tree of the command set. Not NULL - unique prefixes of command names are accepted*/
+	uint8_t 		DispatchLevel;		/*Context level whose handler is running. Used by PassDownContext()*/
+	uint8_t 		PipeBase;			/*Lowest context level of running command pipeline. 0 - no pipeline*/
+#if (SIMCLI_USE_STATS==1)
+	uint8_t 		StatsCmdID;							/*ID of command being executed*/
+	uint8_t 		ContextCmdID[CLI_STACK_SIZE];		/*ID of command that acquired context, one per context level*/
+	uint32_t 		ContextStart[CLI_STACK_SIZE];		/*SIMCLI_STATS_HOLD_TIME() of context acquisition, one per context level*/
+#endif
+	stdout_vec_f 	stdoutVecFunc;		/*Vectored output function. NULL - stdoutFunc is used*/
+	void* 			userData;			/*User pointer, e.g. state of output backend*/
+	uint8_t 		TxHold;				/*While not 0 TxBuf is flushed only when it is full (command batch)*/
+	uint16_t 		TxLen;				/*Number of bytes gathered in TxBuf*/
+	char 			TxBuf[SIMCLI_TX_BUF_SIZE];			/*Transmit buffer*/
+	cli_arena_t 	Arena;				/*Scratch memory of commands*/
+	cli_flow_t 		Flow;				/*Flow control of data context*/
+#if (SIMCLI_ARENA_SIZE>0)
+	char 			ArenaBuf[SIMCLI_ARENA_SIZE];		/*Inline arena block*/
+#endif
+	uint8_t 		CmdID;				/*ID of command being executed*/
+#if (SIMCLI_USE_BINARY==1)
+	bool 			TxFramed;			/*Output is sent as binary response frames of CmdID command*/
+#endif
+	uint16_t 		AsyncSeq;			/*Last issued asynchronous operation handle*/
+	uint16_t 		AsyncStarted;		/*Handle of operation started by the last command. 0 - command completed synchronously*/
+	cli_async_t 	Async[SIMCLI_ASYNC_SLOTS];			/*Pending asynchronous commands*/
+#if (SIMCLI_CACHE_SLOTS>0)
+	uint32_t 			CacheClock;						/*LRU clock of Cache[]*/
+	cli_cache_entry_t* 	CacheFill;						/*CachePending while it gathers response of running command. NULL - none*/
+	cli_cache_entry_t 	CachePending;					/*Key and response of running command. Copied to a slot of Cache[] when stored*/
+	cli_cache_entry_t 	Cache[SIMCLI_CACHE_SLOTS];		/*Responses of cacheable commands*/
+#endif
 }CliContextManager_t;
 
 /**
  * @brief Command function. 
  * @param argv 		Pointer to (char*) array containing parsed arguments
- * @param self 		Pointer to cli_command_t struct of current command
+ * @param self 		Pointer to dispatcher's copy of the command. Argument variables are bound here. cmd_info is not copied
  * @param _context 	Pointer to CliContextManager_t object
  * @return True - OK, False - command run error
 */
 typedef bool (*cmd_function_t)(char **argv, cli_command_s * self,CliContextManager_t * _context);
 
+/**
+ * @brief Per-call state of a command. Lives in the dispatcher's stack frame, next to the copy of the command it passes as self
+ */
+typedef struct
+{
+	const uint8_t* 	arg_index;							/*Compiled argument name index of the command, SIMCLI_ARG_HASH_SIZE entries*/
+	const struct cli_trie_t* trie;						/*Session names tree: ParseCmdArgs() takes unique prefixes of argument names. NULL - full names only*/
+#if (SIMCLI_USE_STATS==1)
+	uint32_t 		parse_ticks;						/*Time spent in ParseCmdArgs()*/
+#endif
+#if (SIMCLI_USE_BINARY==1)
+	const uint8_t* 	tlv_args;							/*Binary frame: TLV arguments. NULL - text command line*/
+	uint16_t 		tlv_length;							/*Size of tlv_args*/
+#endif
+}cli_cmd_call_t;
+
 /**
  * @brief Describes each CLI command 
  * 
@@ -163,38 +554,318 @@ typedef struct cli_command_t
     cmd_arg_t 		args[SIMCLI_MAX_ARGS];        		/*Array containing all function arguments*/
     cmd_function_t 	c_func;                  			/*Pointer to function thar will be called*/
     char 			cmd_info[64];                      	/*Text description of the command*/
-    uint8_t 		cmd_ID;                         	/*Command ID. 1..255. Should be an unique value.*/
+    uint8_t 		cmd_ID;                         	/*Command ID. 1..255. Should be an unique value. 0 - no ID, command is found by name only*/
+	uint32_t 		cache_ttl;							/*Response is cached for cache_ttl ms (see SIMCLI_CACHE_SLOTS). 0 - not limited by time*/
 	Context_t 		cmd_context;						/*Associated data flow context. Can be NULL if command doesn't handle data flow*/
-
+	const uint32_t*	cache_version;						/*Cached response is valid while this counter is unchanged. NULL - not limited by version.
+														  Command is cacheable when either of the two is set*/
+	cli_cmd_call_t* call;								/*State of current call. Set by dispatcher in its copy of the command, NULL in descriptions*/
 }cli_command_t;
 
+#if (SIMCLI_USE_STATS==1)
+/**
+ * @brief Counters of a single command ID. Histograms are log4-bucketed, see SIMCLI_STATS_BUCKETS
+ */
+typedef struct
+{
+	uint32_t 	calls;								/*Number of command function calls*/
+	uint32_t 	failures;							/*Calls where command function returned false*/
+	uint32_t 	cache_hits;							/*Queries answered from the response cache, the function isn't called*/
+	uint32_t 	acquires;							/*Data contexts acquired by the command*/
+	uint64_t 	context_bytes;						/*Bytes passed to data contexts of the command*/
+	uint32_t 	parse_hist[SIMCLI_STATS_BUCKETS];	/*Tokenizing, lookup and ParseCmdArgs() time*/
+	uint32_t 	exec_hist[SIMCLI_STATS_BUCKETS];	/*Command function time without ParseCmdArgs()*/
+	uint32_t 	hold_hist[SIMCLI_STATS_BUCKETS];	/*Time from AcquireContext() to ReleaseContext(), milliseconds*/
+}cli_cmd_stats_t;
+
+/**
+ * @brief Statistics of all sessions. Counters are updated with relaxed atomic additions
+ */
+typedef struct
+{
+	uint32_t 		errors[SIMCLI_ERRORS_NUM];		/*ParseCmdArgs() results by sim_cli_error code*/
+	uint64_t 		main_bytes;						/*Bytes passed to main context handlers*/
+	cli_cmd_stats_t cmd[SIMCLI_STATS_IDS];			/*Counters by cmd_ID*/
+}cli_stats_t;
+#endif
+
+/**
+ * @brief Command set. Lookup tables are filled when commands are added, after
+ * that registry is only read and can be shared by any number of sessions and threads
+ */
+typedef struct
+{
+	cmd_function_t 	c_func;									/*Command function*/
+	uint32_t 		name_hash;								/*Hash of cmd_name, compared before the name itself*/
+	uint8_t 		cmd_ID;
+	char 			cmd_name[16];
+}cli_cmd_hot_t;
+
+/**
+ * @brief Const command set with precomputed perfect hash index. Generated at build time by
+ * simcli_gen tool (see Tools/), can be placed in flash
+ */
+typedef struct
+{
+	uint16_t 				count;							/*Number of commands*/
+	uint16_t 				hash_size;						/*Slots in name_index. Power of 2*/
+	uint32_t 				seed;							/*Hash seed that maps every name to its own slot*/
+	const uint16_t* 		name_index;						/*Hash slot -> position in commands[] + 1*/
+	const uint16_t* 		id_index;						/*[256] cmd_ID -> position in commands[] + 1*/
+	const cli_cmd_hot_t* 	hot;							/*Lookup data, hashes are made with seed*/
+	const cli_command_t* 	commands;						/*Command descriptions*/
+	const uint8_t 			(*arg_index)[SIMCLI_ARG_HASH_SIZE];	/*Compiled argument name index of each command*/
+}cli_command_table_t;
+
+struct cli_registry_t
+{
+	const cli_command_table_t* table;						/*Const base command set. NULL - RAM commands only*/
+	uint16_t 		count;									/*Number of stored commands*/
+	uint16_t 		copies;									/*Used entries of copy_pool[]*/
+	cli_cmd_index_t name_index[SIMCLI_HASH_SIZE];			/*Open addressing hash table on cmd_name. Position in hot[] + 1*/
+	cli_cmd_index_t id_index[256];							/*Direct cmd_ID -> position in hot[] + 1*/
+	cli_cmd_hot_t 	hot[SIMCLI_MAX_COMMANDS];				/*Data used by lookup and dispatch, a few commands per cache line*/
+	/*Cold data, touched once per dispatched command*/
+	const cli_command_t* cold[SIMCLI_MAX_COMMANDS];			/*Full descriptions: help text, arguments, context*/
+	uint8_t 		arg_index[SIMCLI_MAX_COMMANDS][SIMCLI_ARG_HASH_SIZE];	/*Compiled argument name index of each command*/
+#if (SIMCLI_COMMAND_COPIES > 0)
+	cli_command_t 	copy_pool[SIMCLI_COMMAND_COPIES];		/*Storage of commands added by copy*/
+#endif
+};
+
 /**
  * @brief Parsing received arguments in command. Can be call in 
- * command function to set arguments.
+ * command function to set arguments. Each argument is matched in a single
+ * lookup through the argument index compiled by AddNewCommand(). A command
+ * description that is not a dispatcher's copy (call is NULL) is searched by name.
  *
  * @param argv  [in] List of received arguments
- * @param self  [in] Pointer to current command object
- * @retval      true - all arguments parsed successfully 
- * @retval      false - error parsing 
+ * @param self  [in] Pointer to current command object, the self of command function
+ * @return      SIM_CLI_OK - all arguments parsed successfully, error code otherwise
  */
 sim_cli_error ParseCmdArgs(char **argv, cli_command_t* self);
 
 
+/**
+ * @brief Same as ParseCmdArgs(), but arguments without value pointer get zeroed storage
+ * from the session arena first. ARG_STRING without value_size gets room for the received value.
+ * Storage is valid until the command function returns
+ *
+ * @param argv  	[in] List of received arguments
+ * @param self  	[in] Pointer to current command object
+ * @param _context 	[in] Session that executes the command
+ * @return      SIM_CLI_OK - all arguments parsed successfully, SIM_CLI_NO_MEMORY - arena is full, error code otherwise
+ */
+sim_cli_error ParseCmdArgsArena(char **argv, cli_command_t* self, CliContextManager_t * _context);
+
+
+#if (SIMCLI_USE_BINARY==1)
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021) of binary frames
+ *
+ * @param data 		[in] Data
+ * @param length 	[in] Number of bytes
+ * @param crc 		[in] 0xFFFF or result of previous call for the preceding data
+ * @return Updated CRC
+ */
+uint16_t CliCrc16(const uint8_t* data, size_t length, uint16_t crc);
+
+
+/**
+ * @brief Executes binary command frame. Command is found through the ID table and ParseCmdArgs()
+ * fills its cmd_arg_t.value destinations from TLV arguments. Response is sent as binary frames:
+ * CLI_BIN_MORE frames while command writes, then a frame with the final status
+ *
+ * @param frame 	[in] Complete frame: SIMCLI_BIN_SYNC, payload length, cmd_ID, TLV arguments, CRC-16
+ * @param length 	[in] Frame size
+ * @param _context 	[in] Pointer to CliContextManager_t object
+ * @return #ID of executed command, 0 - if error
+ */
+int8_t ProcessCommandFrame(const uint8_t* frame, size_t length, CliContextManager_t * _context);
+
+
+/**
+ * @brief Starts binary request frame
+ *
+ * @param writer 	[out] Frame writer
+ * @param buf 		[in] Frame buffer
+ * @param size 		[in] Size of buf
+ * @param cmd_ID 	[in] Command ID
+ * @return True - success, False - invalid arguments or buffer is too small
+ */
+bool CliFrameBegin(cli_frame_writer_t *writer, uint8_t *buf, size_t size, uint8_t cmd_ID);
+
+
+/**
+ * @brief Appends TLV argument to request frame. Numbers are little-endian: 4 bytes for
+ * ARG_INT32, ARG_UINT32, ARG_HEX, ARG_SIZE and ARG_FLOAT, 8 bytes for ARG_INT64, 1 byte for ARG_BOOL
+ * and ARG_ENUM position. ARG_STRING is sent without '\0', ARG_ONLY has no value
+ *
+ * @param writer 	[in] Frame writer
+ * @param arg_pos 	[in] Argument position in cli_command_t args[] + 1
+ * @param value 	[in] Value bytes. Can be NULL if length is 0
+ * @param length 	[in] Number of value bytes
+ * @return True - success, False - buffer is too small
+ */
+bool CliFrameArg(cli_frame_writer_t *writer, uint8_t arg_pos, const void *value, uint8_t length);
+
+
+/**
+ * @brief Writes payload length and CRC of request frame
+ *
+ * @param writer 	[in] Frame writer
+ * @return Frame size, 0 - buffer is too small
+ */
+size_t CliFrameEnd(cli_frame_writer_t *writer);
+#endif
+
+
 /**
  * @brief Interface for adding new command to system list
  * The whole cli_command_t object will be copied 
  * 
  *
- * @param new_command [in] Command description to add
- * @return 0 - new_command doesn't have command function instance assigned.
+ * @return 0 - new_command doesn't have command function instance assigned, its ID or name
+ * is already used, name is empty or list is full.
  * 1 - 255 - the number of commands in the list
  */
 uint8_t AddNewCommand(cli_command_t new_command);
 
 
 /**
- * @brief Command parsing function.
- * 
+ * @brief Splits command line into arguments in place. Arguments are separated by
+ * SIMCLI_ARGS_DELIMITER symbols, CR and LF. Text inside "..." or '...' keeps delimiters,
+ * backslash takes the next symbol literally. Quotes and escapes are removed and every 
+ * argument is '\0'-terminated inside line buffer. No heap and no global state are used.
+ *
+ * @param line 			[in,out] Command line. Buffer must hold length+1 bytes
+ * @param length 		[in] Number of characters in line
+ * @param tokens 		[out] Array of argument views
+ * @param max_tokens 	[in] Number of elements in tokens array
+ * @return Number of arguments found, -1 - too many arguments or unterminated quote
+ */
+int TokenizeCmdLine(char* line, size_t length, cli_token_t* tokens, size_t max_tokens);
+
+
+/**
+ * @brief Clears command set object. Must be called before adding commands
+ *
+ * @param registry [in,out] Command set object
+ * @return True - success, False - invalid argument
+ */
+bool InitCliRegistry(cli_registry_t *registry);
+
+
+/**
+ * @brief Adds command to command set. Command is copied to one of SIMCLI_COMMAND_COPIES 
+ * slots, its argument names are compiled into arg_index[]. 
+ *
+ * @param registry 		[in,out] Command set object
+ * @param new_command 	[in] Command description to add
+ * @return 0 - invalid command (see AddNewCommand()), otherwise the number of commands in the set
+ */
+uint16_t AddRegistryCommand(cli_registry_t *registry, const cli_command_t *new_command);
+
+
+/**
+ * @brief Adds command to command set without copying it. Only lookup data and compiled
+ * argument index are stored in RAM, so command description can be placed in a const table (flash).
+ *
+ * @param registry 		[in,out] Command set object
+ * @param command 		[in] Command description. Must stay valid while the command set is used
+ * @return 0 - invalid command (see AddNewCommand()), otherwise the number of commands in the set
+ */
+uint16_t AddRegistryCommandRef(cli_registry_t *registry, const cli_command_t *command);
+
+
+/**
+ * @brief Sets const base command set. Commands added at runtime are an overlay: they can't
+ * reuse names and IDs of the base set
+ *
+ * @param registry 	[in,out] Command set object with no commands added. NULL - default command set
+ * @param table 	[in] Generated command table
+ * @return True - success, False - invalid arguments or commands were already added
+ */
+bool SetRegistryTable(cli_registry_t *registry, const cli_command_table_t *table);
+
+
+/**
+ * @brief Hash of command and argument names. Exposed for build time table generation
+ *
+ * @param name 	[in] '\0'-terminated name
+ * @param seed 	[in] Initial hash value
+ * @return Hash value
+ */
+uint32_t CliHashName(const char* name, uint32_t seed);
+
+
+/**
+ * @brief Builds argument name index of the command. Exposed for build time table generation
+ *
+ * @param command 	[in] Command description
+ * @param arg_index [out] Index of SIMCLI_ARG_HASH_SIZE entries
+ * @return True - success, False - bad or duplicate argument names
+ */
+bool CompileCmdArgs(const cli_command_t* command, uint8_t *arg_index);
+
+
+/**
+ * @brief Find command by its name in command set. Const base set is searched first.
+ * NULL registry - default command set
+ *
+ * @return Pointer to stored command, or NULL if name not found
+ */
+const cli_command_t* FindRegistryCmd(const cli_registry_t *registry, const char* cmd_name);
+
+
+/**
+ * @brief Find command by its ID in command set. NULL registry - default command set
+ *
+ * @return Pointer to stored command, or NULL if ID not found
+ */
+const cli_command_t* FindRegistryCmdByID(const cli_registry_t *registry, uint8_t cmdID);
+
+
+/**
+ * @brief Selects command set used by the session. Registry is only read by sessions,
+ * so one registry can serve many sessions running in different threads.
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
+ * @param registry[in] 			Command set. NULL - commands added by AddNewCommand()
+ * @return True - success, False - invalid arguments
+ */
+bool AttachCliRegistry(CliContextManager_t *ctrl_context_ptr, const cli_registry_t *registry);
+
+
+/**
+ * @brief Returns command set used by the session
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. NULL - default command set
+ * @return Command set
+ */
+const cli_registry_t* GetCliRegistry(const CliContextManager_t *ctrl_context_ptr);
+
+
+/**
+ * @brief Enables abbreviated command names in the session: a command is also found by unique 
+ * prefix of its name (see MatchTrieCmd())
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object
+ * @param trie[in] 				Tree built by BuildCliTrie() from session command set. NULL - full names only
+ * @return True - success, False - invalid arguments
+ */
+bool AttachCliTrie(CliContextManager_t *ctrl_context_ptr, const struct cli_trie_t *trie);
+
+
+/**
+ * @brief Command parsing function. Line is copied to session arena, or to a SIMCLI_MAX_CMD_LEN buffer
+ * on the stack when arena is full. Lines longer than SIMCLI_MAX_CMD_LEN-1 are rejected.
+ * Command function receives its own copy of cli_command_t, so argument bindings
+ * made in self don't touch the command set.
+ * Line "cmd1 | cmd2 | cmd3" is a pipeline: cmd3 and cmd2 are run first and each of them must acquire
+ * a data context, then output of cmd1 written with CliWrite() goes to cmd2 context, output of cmd2
+ * context to cmd3 context, and output of cmd3 context to the session output. Contexts are released
+ * when the line is done.
  *
  * @param input_str [i] Pointer to string with command name and arguments
  * @return #ID of executed command, 0 - if error
@@ -202,6 +873,253 @@ uint8_t AddNewCommand(cli_command_t new_command);
 int8_t ProcessCommand(const char* input_str,CliContextManager_t * _context);
 
 
+/**
+ * @brief Command parsing function working on caller supplied scratch buffer.
+ * Session arena is rewound to its previous position when command returns.
+ *
+ * @param input_str 	[in] Command line, doesn't have to be '\0'-terminated
+ * @param length 		[in] Number of characters in input_str
+ * @param scratch 		[in] Buffer for tokenized line. Must hold length+1 bytes. Can be equal to input_str to tokenize in place
+ * @param scratch_size 	[in] Size of scratch buffer
+ * @param _context 		[in] Pointer to CliContextManager_t object
+ * @return #ID of executed command, 0 - if error
+ */
+int8_t ProcessCommandBuf(const char* input_str, size_t length, char* scratch, size_t scratch_size, CliContextManager_t * _context);
+
+
+/**
+ * @brief Find command by its name in the default command set: const table set by
+ * SetRegistryTable(NULL,...) first, then commands added by AddNewCommand()
+ *
+ * @param cmd_name [in] Command name
+ * @return Pointer to cli_command_t object, or NULL if name not found
+ */
+const cli_command_t* FindCmd(const char* cmd_name);
+
+
+/**
+ * @brief Runs many commands from one buffer. Lines are separated by CR, LF or CRLF and
+ * tokenized in place, so the buffer is modified. Commands are run in order. If a command
+ * acquires data context, the following bytes go to that context (to bulk_handler if it
+ * is set, otherwise line by line) until it is released.
+ * Response data written with CliWrite() is gathered and sent by a single output call
+ * after the batch, unless it doesn't fit into SIMCLI_TX_BUF_SIZE.
+ *
+ * @param _context 		[in] Pointer to CliContextManager_t object
+ * @param batch 		[in,out] Newline separated commands
+ * @param length 		[in] Number of bytes in batch
+ * @param results 		[out] Result of each command: #ID of executed command, 0 - error
+ * @param max_results 	[in] Number of elements in results. Processing stops when it is full
+ * @return Number of commands processed
+ */
+size_t ProcessCommandBatch(CliContextManager_t * _context, char* batch, size_t length, int8_t* results, size_t max_results);
+
+
+/**
+ * @brief Runs command script in place, e.g. memory mapped file (see simple_cli_script.h).
+ * Lines are walked as by ProcessCommandBatch(): command lines are tokenized without copying,
+ * bytes that follow a command which acquired data context are lent to that context
+ * (whole rest of the script to bulk_handler, line by line to context_handler) until it is released.
+ *
+ * @param _context 		[in] Pointer to CliContextManager_t object
+ * @param script 		[in,out] Newline separated commands and data sections
+ * @param length 		[in] Number of bytes in script
+ * @param on_error 		[in] Called for every failed command line. Can be NULL
+ * @param user_data 	[in] User pointer passed to on_error
+ * @param report 		[out] Counters of the run. Can be NULL
+ * @return True - whole script is walked and all commands succeeded
+ */
+bool RunCliScript(CliContextManager_t * _context, char* script, size_t length, cli_script_error_f on_error, void *user_data, cli_script_report_t *report);
+
+
+/**
+ * @brief Appends response data to session transmit buffer. Commands and context handlers
+ * should use it instead of calling stdoutFunc directly. Buffer is flushed at the end of
+ * each command, when context is released, when CallContextHandler(), CallContextBulk() or
+ * FeedContextHandler() returns and when it is full. Data that doesn't fit into the buffer is
+ * sent together with buffer contents by one vectored output call.
+ * Inside a command pipeline data is passed to the next stage handler without copying, the
+ * handler must not change it. Result is what the stage accepted: 0 or less than length - the
+ * stage can't take more now, so the writer should stop (backpressure).
+ *
+ * @param _context 	[in] Pointer to CliContextManager_t object
+ * @param data 		[in] Response data
+ * @param length 	[in] Number of bytes in data
+ * @return Number of bytes accepted
+ */
+uint32_t CliWrite(CliContextManager_t * _context, const char* data, size_t length);
+
+
+/**
+ * @brief Appends '\0'-terminated string to session transmit buffer
+ */
+uint32_t CliWriteStr(CliContextManager_t * _context, const char* str);
+
+
+/**
+ * @brief Appends decimal representation of signed value to session transmit buffer
+ */
+uint32_t CliWriteInt(CliContextManager_t * _context, int64_t value);
+
+
+/**
+ * @brief Appends decimal representation of unsigned value to session transmit buffer
+ */
+uint32_t CliWriteUint(CliContextManager_t * _context, uint64_t value);
+
+
+/**
+ * @brief Appends hexadecimal representation of value to session transmit buffer
+ * @param digits 	Min number of digits, value is padded with zeros. 0 - no padding
+ */
+uint32_t CliWriteHex(CliContextManager_t * _context, uint32_t value, uint8_t digits);
+
+
+/**
+ * @brief Sends data gathered in transmit buffer. Must be called after writing outside of 
+ * command functions and context handlers
+ *
+ * @param _context 	[in] Pointer to CliContextManager_t object
+ * @return True - success, False - invalid argument
+ */
+bool CliFlush(CliContextManager_t * _context);
+
+
+/**
+ * @brief Registers vectored output function. When it is set transmit buffer is flushed by 
+ * a single call even if data doesn't fit into it
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
+ * @param stdout_vec_func[in] 	Vectored output function. NULL - stdoutFunc is used
+ * @param user_data[in] 		User pointer, stored in userData
+ * @return True - success, False - invalid arguments
+ */
+bool SetCliVectorOutput(CliContextManager_t *ctrl_context_ptr, stdout_vec_f stdout_vec_func, void *user_data);
+
+
+/**
+ * @brief Replaces session arena block, e.g. with a static array in USE_STATIC_ALLOCATION builds
+ * or when SIMCLI_ARENA_SIZE is 0. Call after InitCLIcontext()
+ *
+ * @param ctrl_context_ptr 	[in] Pointer to CLI context control object
+ * @param block 			[in] Arena memory. NULL - arena is disabled
+ * @param size 				[in] Size of the block
+ * @return True - success, False - invalid arguments
+ */
+bool SetCliArena(CliContextManager_t *ctrl_context_ptr, void *block, size_t size);
+
+
+/**
+ * @brief Allocates scratch memory from session arena. Memory allocated by a command is released
+ * when ProcessCommand() returns, memory allocated by a data context handler - when the handler returns.
+ * No free call is needed
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @param size 		[in] Number of bytes
+ * @return Pointer aligned to SIMCLI_ARENA_ALIGN, NULL - arena is full or disabled
+ */
+void* CliArenaAlloc(CliContextManager_t * _context, size_t size);
+
+
+/**
+ * @brief Returns current arena position. Used with CliArenaRewind() to release temporary allocations
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @return Number of used arena bytes, 0 - _context is NULL
+ */
+size_t CliArenaMark(const CliContextManager_t * _context);
+
+
+/**
+ * @brief Releases all arena allocations made after CliArenaMark() call
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @param mark 		[in] Value returned by CliArenaMark()
+ */
+void CliArenaRewind(CliContextManager_t * _context, size_t mark);
+
+
+/**
+ * @brief Selects flow control messages of the session. Flow control is enabled for contexts
+ * acquired with non-zero rx_window: in CLI_FLOW_CREDIT mode the sender gets rx_window bytes of
+ * credit on acquisition and window updates as the handler drains its buffers
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @param mode 		[in] cli_flow_mode_t
+ * @return True - success, False - invalid arguments
+ */
+bool SetCliFlowMode(CliContextManager_t * _context, cli_flow_mode_t mode);
+
+
+/**
+ * @brief Reports bytes that data context handler still holds in its buffers, e.g. queued for a slow
+ * SD card. Called by the handler and again from main loop as the buffers drain. Window update or
+ * XON is sent when room is freed, XOFF when buffers fill up. Handler that never calls it is
+ * treated as drained when it returns
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @param buffered 	[in] Bytes held by the handler
+ * @return True - success, False - no context with flow control
+ */
+bool CliFlowUpdate(CliContextManager_t * _context, uint32_t buffered);
+
+
+/**
+ * @brief Turns running command into asynchronous one. Command function calls it, starts the slow
+ * operation and returns true at once, so input keeps being processed. The response is written later
+ * by on_done callback called from PollCliAsync()
+ *
+ * @param _context 	[in] Session that executes the command
+ * @param step 		[in] Step function called by PollCliAsync(). NULL - operation is finished by CompleteCliAsync()
+ * @param on_done 	[in] Completion callback. Can be NULL
+ * @param user_data [in] Operation state. Must stay valid until completion, so it can't point into the arena
+ * @return Operation object, its handle field identifies the operation. NULL - all SIMCLI_ASYNC_SLOTS are used
+ */
+cli_async_t* BeginCliAsync(CliContextManager_t * _context, cli_async_step_f step, cli_async_done_f on_done, void *user_data);
+
+
+/**
+ * @brief Reports result of pending operation, e.g. from driver interrupt or event loop callback.
+ * Completion callback is called by the next PollCliAsync()
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @param handle 	[in] Operation handle
+ * @param result 	[in] True - operation succeeded
+ * @return True - success, False - no pending operation with this handle
+ */
+bool CompleteCliAsync(CliContextManager_t * _context, uint16_t handle, bool result);
+
+
+/**
+ * @brief Advances pending operations of the session: calls step functions, then completion callbacks
+ * of finished operations, and flushes their responses. Call it from the main loop or when an event
+ * loop reports that an operation may have progressed
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @return Number of operations that are still pending
+ */
+uint8_t PollCliAsync(CliContextManager_t * _context);
+
+
+/**
+ * @brief Returns number of pending operations. Input drivers that must keep responses in order
+ * stop reading while it isn't 0, so input stays queued in UART FIFO or kernel socket buffer
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @return Number of used SIMCLI_ASYNC_SLOTS
+ */
+uint8_t CliAsyncPending(const CliContextManager_t * _context);
+
+
+/**
+ * @brief Returns handle of operation started by the last executed command
+ *
+ * @param _context 	[in] Pointer to CLI context control object
+ * @return Operation handle, 0 - the command completed synchronously
+ */
+uint16_t GetCliAsyncHandle(const CliContextManager_t * _context);
+
+
 /**
  * @brief Find command by its ID in the list
  * 
@@ -209,16 +1127,16 @@ int8_t ProcessCommand(const char* input_str,CliContextManager_t * _context);
  * @param cmdID [in] Command ID
  * @return Pointer to cli_command_t object, or NULL if ID not found
  */
-cli_command_t* FindCmdByID(uint8_t cmdID);
+const cli_command_t* FindCmdByID(uint8_t cmdID);
 
 
 /**
  * @brief Calling this func running command receives data flow context and manages all incoming data
- * 
+ * Context object is copied into context manager, so it can be a local or per-call object.
  *
  * @param context_ptr[in] Pointer to CLI context control object
  * @param context_ptr[in] Pointer to context object that will manage the data flow
- * @return True - context handling transferred, False - Context transfer failed. Bad arguments are passed
+ * @return True - context handling transferred, False - Context transfer failed. Bad arguments are passed or all CLI_STACK_SIZE levels are used
  */
 bool AcquireContext(CliContextManager_t *context_ptr, Context_t *_context);
 
@@ -226,13 +1144,48 @@ bool AcquireContext(CliContextManager_t *context_ptr, Context_t *_context);
 /**
  * @brief Calling this func running command releases data flow context. 
  *       Context is transferred to previous context manager which managed data flow before AcquireContext() was called
+ *       The top level is always released, pipeline levels are released from the top.
+ *       While a command pipeline runs, the stage whose handler calls it is detached instead: it takes
+ *       no more data and gets no end of stream call. Stages are popped when the pipeline ends
  * 
  * @param CLI_cont[in] Pointer to CLI context control object
- * @return True - context handling transferred, False - Context transfer failed. Bad argument
+ * @return True - context handling transferred, False - Context transfer failed. Bad argument or no context is acquired
  */
 bool ReleaseContext(CliContextManager_t *CLI_cont);
 
 
+/**
+ * @brief Passes data from the running context handler to context_handler of the level below it, in the same call.
+ * Levels acquired one over another make a pipeline: data enters the top level and each level transforms
+ * the chunk, in place or into arena memory, and passes it down. Main context (level 0) is not a pipeline level
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object
+ * @param data 					Pointer to data array
+ * @param length 				Number of bytes in data array
+ * @return Result of the lower level handler. False - invalid arguments or running handler is the lowest acquired level or the level below has no context_handler
+ */
+bool PassDownContext(CliContextManager_t *ctrl_context_ptr, char *data, size_t length);
+
+
+/**
+ * @brief Copies context to the top of the stack. O(1)
+ *
+ * @param _stack 	[in] Context stack
+ * @param _context 	[in] Context object
+ * @return Pointer to the stored copy, NULL - invalid arguments or all CLI_STACK_SIZE levels are used
+ */
+Context_t* PushContextStack(context_stack_t *_stack, const Context_t *_context);
+
+
+/**
+ * @brief Removes context from the top of the stack. O(1)
+ *
+ * @param _stack 	[in] Context stack
+ * @return Pointer to removed copy, valid until the next push. NULL - invalid argument or stack is empty
+ */
+Context_t* PullContextStack(context_stack_t *_stack);
+
+
 /**
  * @brief Initializes context manager. 
  *
@@ -247,7 +1200,7 @@ bool InitCLIcontext(CliContextManager_t* ctrl_context_ptr,context_handler_f hand
 
 
 /**
- * @brief Calls current context manager function
+ * @brief Calls current context manager function. Context that has only bulk_handler ignores the data
  *
  * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
  * @param data 					Pointer to data array
@@ -256,4 +1209,88 @@ bool InitCLIcontext(CliContextManager_t* ctrl_context_ptr,context_handler_f hand
  */
 bool CallContextHandler(CliContextManager_t *ctrl_context_ptr, char *data, size_t length);
 
+
+/**
+ * @brief Lends data region to acquired data context. If context has bulk_handler the whole
+ * region is passed in a single call and context is released when handler reports completion.
+ * Otherwise each segment is passed to context_handler.
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
+ * @param view 					Data region, one or two segments
+ * @return Number of bytes consumed. 0 - invalid arguments or no data context is acquired
+ */
+size_t CallContextBulk(CliContextManager_t *ctrl_context_ptr, const cli_data_view_t *view);
+
+
+/**
+ * @brief Passes arbitrary chunk of input stream to context handlers.
+ * While main context is active data is split into lines ended by CR, LF or CRLF. Each complete 
+ * line is passed to main context handler as '\0'-terminated string without line ending. 
+ * Lines that are complete inside data are passed in place: their line ending symbol is replaced
+ * with '\0'. Unfinished line is kept in LineFramer until the next call.
+ * While data context is active bytes are passed to its handler as is. If command acquires
+ * context, the rest of the chunk after command line is passed to the acquired context.
+ * Bytes that are left by bulk handler after transfer completion are split into lines again.
+ * Bulk handler that consumes nothing stops the call: the rest of data is dropped, use
+ * FeedContextInput() to keep it
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
+ * @param data 					Pointer to data array
+ * @param length 				Number of bytes in data array
+ * @return True - success, False - invalid arguments, line longer than SIMCLI_MAX_CMD_LEN-1 was dropped
+ * or bulk handler consumed nothing
+ */
+bool FeedContextHandler(CliContextManager_t *ctrl_context_ptr, char *data, size_t length);
+
+
+/**
+ * @brief Same as FeedContextHandler(), but stops when bulk handler of data context consumes
+ * nothing and returns the number of bytes taken. The rest of data, including command lines
+ * after bulk payload, is not touched and must be fed again when the handler can take it
+ *
+ * @param ctrl_context_ptr[in] 	Pointer to CLI context control object. Must be initialized using InitCLIcontext()
+ * @param data 					Pointer to data array
+ * @param length 				Number of bytes in data array
+ * @return Number of bytes taken from the beginning of data. 0 - invalid arguments or nothing taken
+ */
+size_t FeedContextInput(CliContextManager_t *ctrl_context_ptr, char *data, size_t length);
+
+/**
+ * @brief Drops cached responses. Commands that change state shown by cacheable queries call it,
+ * unless the queries use cache_version counter that they increment. Does nothing when
+ * SIMCLI_CACHE_SLOTS is 0
+ *
+ * @param _context 	[in] Pointer to CLI context control object. NULL - responses of all commands in all sessions
+ * @param cmd_name 	[in] Command whose responses are dropped. NULL - all commands of the session
+ */
+void InvalidateCliCache(CliContextManager_t * _context, const char* cmd_name);
+
+#if (SIMCLI_USE_STATS==1)
+/**
+ * @brief Copies statistics of all sessions. Can be called from any thread
+ *
+ * @param snapshot 	[out] Statistics copy
+ * @return True - success, False - invalid argument
+ */
+bool GetCliStats(cli_stats_t *snapshot);
+
+
+/**
+ * @brief Clears statistics of all sessions. Counters are cleared one by one with atomic stores,
+ * so it can be called while other sessions run commands
+ */
+void ResetCliStats(void);
+
+
+/**
+ * @brief Adds built-in "stats" command. It prints counters and histograms of commands that were called,
+ * "stats -r" clears them.
+ *
+ * @param registry 	[in,out] Command set object. NULL - default command set
+ * @param cmd_ID 	[in] ID of stats command
+ * @return 0 - command not added, otherwise the number of commands in the set
+ */
+uint16_t AddStatsCommand(cli_registry_t *registry, uint8_t cmd_ID);
+#endif
+
 #endif
@@ -0,0 +1,259 @@
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "sys/epoll.h"
+#include "simple_cli_sched.h"
+
+#define SCHED_EVENTS_NUM 				64					/*Events taken by poll thread at once*/
+
+#define STAT_ADD(_field,_value)			__atomic_fetch_add(&(_field),(_value),__ATOMIC_RELAXED)
+#define STAT_GET(_field)				__atomic_load_n(&(_field),__ATOMIC_RELAXED)
+#define IS_RUNNING(_sched)				__atomic_load_n(&(_sched)->running,__ATOMIC_ACQUIRE)
+#define PENDING(_sched)					__atomic_load_n(&(_sched)->pending,__ATOMIC_ACQUIRE)
+
+static uint64_t MonotonicNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+}
+
+/*pending is changed under the queue lock together with the queue, so a session is counted before any
+  worker can pop it. Signal is sent under work_lock, so a worker that just saw pending==0 doesn't miss it*/
+static void PushRunQueue(cli_sched_t *sched, cli_sched_worker_t *worker, cli_sched_session_t *session)
+{
+	pthread_mutex_lock(&worker->lock);
+	session->next=NULL;
+	if(worker->tail)
+		worker->tail->next=session;
+	else
+		worker->head=session;
+	worker->tail=session;
+	__atomic_fetch_add(&sched->pending,1,__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&worker->lock);
+
+	pthread_mutex_lock(&sched->work_lock);
+	pthread_cond_signal(&sched->work_cond);
+	pthread_mutex_unlock(&sched->work_lock);
+}
+
+static cli_sched_session_t* PopRunQueue(cli_sched_t *sched, cli_sched_worker_t *worker)
+{
+	pthread_mutex_lock(&worker->lock);
+	cli_sched_session_t *session=worker->head;
+	if(session)
+	{
+		worker->head=session->next;
+		if(worker->head==NULL)
+			worker->tail=NULL;
+		__atomic_fetch_sub(&sched->pending,1,__ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return session;
+}
+
+/*Re-enables input readiness notification. Until that session can't be queued again*/
+static bool ArmSession(cli_sched_t *sched, cli_sched_session_t *session, int op)
+{
+	struct epoll_event event;
+	event.events=EPOLLIN|EPOLLONESHOT;
+	event.data.ptr=session;
+	return epoll_ctl(sched->epoll_fd,op,session->fd,&event)==0;
+}
+
+static void ServeSession(cli_sched_t *sched, cli_sched_worker_t *worker, cli_sched_session_t *session)
+{
+	char buf[SIMCLI_SCHED_READ_SIZE];
+	uint64_t start=MonotonicNs();
+	uint64_t latency=start-__atomic_load_n(&session->ready_ns,__ATOMIC_RELAXED);
+	uint32_t lines_before=session->cli->LineFramer.line_count;
+	uint64_t bytes=0;
+	bool more_input=false;
+	bool closed=false;
+
+	for(int i=0;i<SIMCLI_SCHED_BATCH;++i)
+	{
+		ssize_t received=read(session->fd,buf,sizeof(buf));
+		if(received>0)
+		{
+			bytes+=(uint64_t)received;
+			FeedContextHandler(session->cli,buf,(size_t)received);
+			more_input=(i==SIMCLI_SCHED_BATCH-1);
+			continue;
+		}
+		if((received<0)&&(errno==EINTR))
+			continue;
+		if((received<0)&&((errno==EAGAIN)||(errno==EWOULDBLOCK)))
+			break;
+		closed=true;														/*End of input or error*/
+		break;
+	}
+
+	uint64_t end=MonotonicNs();
+	STAT_ADD(session->stats.bytes_in,bytes);
+	STAT_ADD(session->stats.lines,(uint32_t)(session->cli->LineFramer.line_count-lines_before));
+	STAT_ADD(session->stats.wakeups,1);
+	STAT_ADD(session->stats.busy_ns,end-start);
+	STAT_ADD(session->stats.latency_ns_sum,latency);
+	if(latency>STAT_GET(session->stats.latency_ns_max))
+		__atomic_store_n(&session->stats.latency_ns_max,latency,__ATOMIC_RELAXED);
+	if(worker!=&sched->workers[session->home])
+		STAT_ADD(session->stats.steals,1);
+
+	if(closed)
+	{
+		epoll_ctl(sched->epoll_fd,EPOLL_CTL_DEL,session->fd,NULL);
+		if(session->on_close)
+			session->on_close(session);
+	}
+	else if(more_input)
+	{
+		__atomic_store_n(&session->ready_ns,end,__ATOMIC_RELAXED);											/*Batch is over, let other sessions run*/
+		PushRunQueue(sched,&sched->workers[session->home],session);
+	}
+	else
+		ArmSession(sched,session,EPOLL_CTL_MOD);
+}
+
+static void* WorkerThread(void *arg)
+{
+	cli_sched_worker_t *worker=arg;
+	cli_sched_t *sched=worker->sched;
+	size_t self=(size_t)(worker-sched->workers);
+	while(IS_RUNNING(sched))
+	{
+		cli_sched_session_t *session=PopRunQueue(sched,worker);
+		for(uint8_t i=1;(session==NULL)&&(i<sched->num_workers);++i)		/*Stealing from other workers*/
+			session=PopRunQueue(sched,&sched->workers[(self+i)%sched->num_workers]);
+		if(session)
+		{
+			ServeSession(sched,worker,session);
+			continue;
+		}
+		pthread_mutex_lock(&sched->work_lock);
+		while((PENDING(sched)==0)&&IS_RUNNING(sched))
+			pthread_cond_wait(&sched->work_cond,&sched->work_lock);
+		pthread_mutex_unlock(&sched->work_lock);
+	}
+	return NULL;
+}
+
+static void* PollThread(void *arg)
+{
+	cli_sched_t *sched=arg;
+	struct epoll_event events[SCHED_EVENTS_NUM];
+	while(IS_RUNNING(sched))
+	{
+		int num=epoll_wait(sched->epoll_fd,events,SCHED_EVENTS_NUM,-1);
+		uint64_t now=MonotonicNs();
+		for(int i=0;i<num;++i)
+		{
+			cli_sched_session_t *session=events[i].data.ptr;
+			if(session==NULL)												/*Stop request*/
+				continue;
+			__atomic_store_n(&session->ready_ns,now,__ATOMIC_RELAXED);
+			PushRunQueue(sched,&sched->workers[session->home],session);
+		}
+	}
+	return NULL;
+}
+
+/*Stops and joins first num_started workers, frees scheduler resources. Poll thread is already stopped*/
+static void StopWorkers(cli_sched_t *sched, uint8_t num_started)
+{
+	__atomic_store_n(&sched->running,false,__ATOMIC_RELEASE);
+	pthread_mutex_lock(&sched->work_lock);
+	pthread_cond_broadcast(&sched->work_cond);
+	pthread_mutex_unlock(&sched->work_lock);
+	for(uint8_t i=0;i<num_started;++i)
+		pthread_join(sched->workers[i].thread,NULL);
+	for(uint8_t i=0;i<sched->num_workers;++i)
+		pthread_mutex_destroy(&sched->workers[i].lock);
+	pthread_cond_destroy(&sched->work_cond);
+	pthread_mutex_destroy(&sched->work_lock);
+	close(sched->wake_fd[0]);
+	close(sched->wake_fd[1]);
+	close(sched->epoll_fd);
+}
+
+bool StartCliScheduler(cli_sched_t *sched, uint8_t num_workers)
+{
+	if((sched==NULL)||(num_workers==0)||(num_workers>SIMCLI_SCHED_MAX_WORKERS))
+		return false;
+	memset(sched,0,sizeof(*sched));
+	sched->epoll_fd=epoll_create1(EPOLL_CLOEXEC);
+	if(sched->epoll_fd<0)
+		return false;
+	if(pipe(sched->wake_fd)!=0)
+	{
+		close(sched->epoll_fd);
+		return false;
+	}
+	struct epoll_event event;
+	event.events=EPOLLIN;
+	event.data.ptr=NULL;
+	epoll_ctl(sched->epoll_fd,EPOLL_CTL_ADD,sched->wake_fd[0],&event);
+
+	pthread_mutex_init(&sched->work_lock,NULL);
+	pthread_cond_init(&sched->work_cond,NULL);
+	sched->num_workers=num_workers;
+	sched->running=true;
+	for(uint8_t i=0;i<num_workers;++i)									/*Workers steal from each other, so all queues are ready first*/
+	{
+		pthread_mutex_init(&sched->workers[i].lock,NULL);
+		sched->workers[i].sched=sched;
+	}
+	for(uint8_t i=0;i<num_workers;++i)
+	{
+		if(pthread_create(&sched->workers[i].thread,NULL,WorkerThread,&sched->workers[i])!=0)
+		{
+			StopWorkers(sched,i);
+			return false;
+		}
+	}
+	if(pthread_create(&sched->poll_thread,NULL,PollThread,sched)!=0)
+	{
+		StopWorkers(sched,num_workers);
+		return false;
+	}
+	return true;
+}
+
+void StopCliScheduler(cli_sched_t *sched)
+{
+	if((sched==NULL)||!IS_RUNNING(sched))
+		return;
+	__atomic_store_n(&sched->running,false,__ATOMIC_RELEASE);
+	if(write(sched->wake_fd[1],"",1)<0)
+		return;
+	pthread_join(sched->poll_thread,NULL);
+	StopWorkers(sched,sched->num_workers);
+}
+
+bool AddSchedulerSession(cli_sched_t *sched, cli_sched_session_t *session)
+{
+	if((sched==NULL)||(session==NULL)||(session->cli==NULL)||(session->fd<0))
+		return false;
+	int flags=fcntl(session->fd,F_GETFL);
+	if((flags<0)||(fcntl(session->fd,F_SETFL,flags|O_NONBLOCK)<0))
+		return false;
+	memset(&session->stats,0,sizeof(session->stats));
+	session->next=NULL;
+	session->home=(uint8_t)(__atomic_fetch_add(&sched->next_home,1,__ATOMIC_RELAXED)%sched->num_workers);
+	return ArmSession(sched,session,EPOLL_CTL_ADD);
+}
+
+void GetSessionStats(const cli_sched_session_t *session, cli_session_stats_t *stats)
+{
+	if((session==NULL)||(stats==NULL))
+		return;
+	stats->bytes_in=STAT_GET(session->stats.bytes_in);
+	stats->lines=STAT_GET(session->stats.lines);
+	stats->wakeups=STAT_GET(session->stats.wakeups);
+	stats->steals=STAT_GET(session->stats.steals);
+	stats->busy_ns=STAT_GET(session->stats.busy_ns);
+	stats->latency_ns_sum=STAT_GET(session->stats.latency_ns_sum);
+	stats->latency_ns_max=STAT_GET(session->stats.latency_ns_max);
+}
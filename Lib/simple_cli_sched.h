@@ -0,0 +1,151 @@
+/*
+ * simple_cli_sched.h
+ *
+ * Description: Serves many CLI sessions from a fixed pool of worker threads (POSIX hosts).
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+/*
+ * MIT License
+ *
+ * Copyright (c) [2023] [Alex Trusk]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SIMPLE_CLI_SCHED_H
+#define SIMPLE_CLI_SCHED_H
+
+#include "pthread.h"
+#include "simple_cli.h"
+
+#ifndef SIMCLI_SCHED_MAX_WORKERS
+	#define SIMCLI_SCHED_MAX_WORKERS 	16					/*Max number of worker threads*/
+#endif
+
+#ifndef SIMCLI_SCHED_READ_SIZE
+	#define SIMCLI_SCHED_READ_SIZE 		512					/*Bytes read from session input at once*/
+#endif
+
+#ifndef SIMCLI_SCHED_BATCH
+	#define SIMCLI_SCHED_BATCH 			8					/*Max reads per session wakeup. Session with more input is queued again*/
+#endif
+
+struct cli_sched_t;
+
+/**
+ * @brief Session throughput and latency counters. Updated by workers, read with GetSessionStats()
+ */
+typedef struct
+{
+	uint64_t 	bytes_in;				/*Bytes read from session input*/
+	uint64_t 	lines;					/*Lines passed to main context handler*/
+	uint64_t 	wakeups;				/*Number of times session was processed by a worker*/
+	uint64_t 	steals;					/*Wakeups served by a worker that stole the session from another one*/
+	uint64_t 	busy_ns;				/*Time spent in context handlers*/
+	uint64_t 	latency_ns_sum;			/*Sum of delays between input readiness and start of processing*/
+	uint64_t 	latency_ns_max;			/*Max delay between input readiness and start of processing*/
+}cli_session_stats_t;
+
+/**
+ * @brief Session served by the scheduler. Allocated by the user, must stay valid until it is closed
+ */
+typedef struct cli_sched_session_t
+{
+	CliContextManager_t* 			cli;		/*Context manager of the session*/
+	int 							fd;			/*Session input. Kernel buffer of pipe or socket is the session input queue*/
+	void 							(*on_close)(struct cli_sched_session_t *session);	/*Called by worker after input end. Can be NULL*/
+	void* 							user_data;	/*User pointer*/
+	/*Scheduler internals*/
+	struct cli_sched_session_t* 	next;		/*Next session in worker run queue*/
+	uint64_t 						ready_ns;	/*Time when input became ready*/
+	uint8_t 						home;		/*Worker that gets session when input is ready*/
+	cli_session_stats_t 			stats;
+}cli_sched_session_t;
+
+/**
+ * @brief Worker run queue
+ */
+typedef struct
+{
+	pthread_mutex_t 		lock;
+	cli_sched_session_t* 	head;
+	cli_sched_session_t* 	tail;
+	pthread_t 				thread;
+	struct cli_sched_t* 	sched;
+}cli_sched_worker_t;
+
+/**
+ * @brief Session scheduler
+ */
+typedef struct cli_sched_t
+{
+	int 					epoll_fd;			/*Input readiness of all sessions*/
+	int 					wake_fd[2];			/*Pipe that stops poll thread*/
+	pthread_t 				poll_thread;
+	bool 					running;
+	pthread_mutex_t 		work_lock;
+	pthread_cond_t 			work_cond;			/*Signals idle workers about queued sessions*/
+	uint32_t 				pending;			/*Number of queued sessions in all run queues. Changed under the lock of the run queue*/
+	uint8_t 				num_workers;
+	uint32_t 				next_home;			/*Round robin counter for home worker selection*/
+	cli_sched_worker_t 		workers[SIMCLI_SCHED_MAX_WORKERS];
+}cli_sched_t;
+
+
+/**
+ * @brief Initializes scheduler and starts poll thread and worker threads
+ *
+ * @param sched 		[out] Scheduler object
+ * @param num_workers 	[in] Number of worker threads, 1..SIMCLI_SCHED_MAX_WORKERS
+ * @return True - success, False - invalid arguments or system error, threads already started are stopped
+ */
+bool StartCliScheduler(cli_sched_t *sched, uint8_t num_workers);
+
+
+/**
+ * @brief Stops all threads. Sessions are not closed
+ *
+ * @param sched [in] Scheduler object
+ */
+void StopCliScheduler(cli_sched_t *sched);
+
+
+/**
+ * @brief Adds session to scheduler. Input of the session is read by workers and passed
+ * to FeedContextHandler(). Input of one session is always handled in order by a single
+ * worker at a time, idle workers steal queued sessions from busy ones.
+ *
+ * @param sched 	[in] Scheduler object
+ * @param session 	[in] Session object. cli and fd fields must be set. fd is switched to non-blocking mode
+ * @return True - success, False - invalid arguments or system error
+ */
+bool AddSchedulerSession(cli_sched_t *sched, cli_sched_session_t *session);
+
+
+/**
+ * @brief Reads session counters. Can be called from any thread
+ *
+ * @param session 	[in] Session object
+ * @param stats 	[out] Counters snapshot
+ */
+void GetSessionStats(const cli_sched_session_t *session, cli_session_stats_t *stats);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * simple_cli_script.c
+ *
+ * Description: Runs command scripts from memory mapped files (POSIX hosts).
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+/*
+ * MIT License
+ *
+ * Copyright (c) [2023] [Alex Trusk]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "string.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "simple_cli_script.h"
+
+bool RunCliScriptFile(CliContextManager_t * _context, const char* path, cli_script_error_f on_error, void *user_data, cli_script_report_t *report)
+{
+	cli_script_report_t local;
+	if(report==NULL)
+		report=&local;
+	memset(report,0,sizeof(*report));
+	if((_context==NULL)||(path==NULL))
+		return false;
+	int fd=open(path,O_RDONLY);
+	if(fd<0)
+		return false;
+	struct stat st;
+	if((fstat(fd,&st)!=0)||(st.st_size<0))
+	{
+		close(fd);
+		return false;
+	}
+	size_t length=(size_t)st.st_size;
+	if(length==0)
+	{
+		close(fd);
+		return true;
+	}
+	char *script=mmap(NULL,length,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(script==MAP_FAILED)
+		return false;
+	madvise(script,length,MADV_SEQUENTIAL);
+	bool ret=RunCliScript(_context,script,length,on_error,user_data,report);
+	munmap(script,length);
+	return ret;
+}
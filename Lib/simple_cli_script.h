@@ -0,0 +1,53 @@
+/*
+ * simple_cli_script.h
+ *
+ * Description: Runs command scripts from memory mapped files (POSIX hosts).
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+/*
+ * MIT License
+ *
+ * Copyright (c) [2023] [Alex Trusk]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SIMPLE_CLI_SCRIPT_H
+#define SIMPLE_CLI_SCRIPT_H
+
+#include "simple_cli.h"
+
+/**
+ * @brief Maps command file and runs it with RunCliScript(). Mapping is private and writable:
+ * lines are tokenized in place, pages are copied by the kernel only when they are written,
+ * the file itself is not changed. Data sections of the script are lent to data contexts
+ * as slices of the mapping.
+ *
+ * @param _context 		[in] Pointer to CliContextManager_t object
+ * @param path 			[in] Script file
+ * @param on_error 		[in] Called for every failed command line with its offset in the file. Can be NULL
+ * @param user_data 	[in] User pointer passed to on_error
+ * @param report 		[out] Counters of the run. Can be NULL
+ * @return True - whole script is run and all commands succeeded, False - command errors or file can't be mapped
+ */
+bool RunCliScriptFile(CliContextManager_t * _context, const char* path, cli_script_error_f on_error, void *user_data, cli_script_report_t *report);
+
+#endif
@@ -0,0 +1,471 @@
+#define _GNU_SOURCE
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "errno.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "termios.h"
+#include "sys/epoll.h"
+#include "sys/socket.h"
+#include "sys/uio.h"
+#include "sys/un.h"
+#include "simple_cli_server.h"
+
+#define SERVER_EVENTS_NUM 				64					/*Events taken by PollCliServer() at once*/
+#define SERVER_IOV_NUM 					4					/*Output segments sent by one call. Rest is buffered*/
+#define SERVER_TX_MIN 					256					/*Initial size of output backlog*/
+
+#ifndef UNUSED_PARAMETER
+	#define UNUSED_PARAMETER(x)    ((void)(x))
+#endif
+
+static bool ServerMainHandler(char *data, size_t length, void * _context)
+{
+	UNUSED_PARAMETER(length);
+	if(ProcessCommand(data,_context)==0)
+	{
+		CliWriteStr(_context,"Command unknown\n");
+		return false;
+	}
+	return true;
+}
+
+static bool SetNonBlocking(int fd)
+{
+	int flags=fcntl(fd,F_GETFL);
+	return (flags>=0)&&(fcntl(fd,F_SETFL,flags|O_NONBLOCK)==0);
+}
+
+/*Input is not read while the peer is behind with output: session that sends commands without
+  reading responses is paced instead of growing its backlog*/
+static void UpdateEvents(cli_server_conn_t *conn)
+{
+	uint32_t events=0;
+	if(!conn->input_end&&(conn->tx_len<SIMCLI_SERVER_TX_LIMIT/2))
+		events|=EPOLLIN;
+	if(conn->tx_len)
+		events|=EPOLLOUT;
+	if(events==conn->events)
+		return;
+	struct epoll_event event;
+	event.events=events;
+	event.data.ptr=conn;
+	if(epoll_ctl(conn->server->epoll_fd,EPOLL_CTL_MOD,conn->fd,&event)==0)
+		conn->events=events;
+	else
+		conn->failed=true;
+}
+
+static ssize_t SendVec(cli_server_conn_t *conn, struct iovec *vec, int num)
+{
+	ssize_t sent;
+	do
+	{
+		if(conn->pty_slave<0)
+		{
+			struct msghdr msg;
+			memset(&msg,0,sizeof(msg));
+			msg.msg_iov=vec;
+			msg.msg_iovlen=(size_t)num;
+			sent=sendmsg(conn->fd,&msg,MSG_NOSIGNAL);
+			if((sent<0)&&(errno==ENOTSOCK))							/*Pipe or serial port given to AddCliServerFd()*/
+				sent=writev(conn->fd,vec,num);
+		}
+		else
+			sent=writev(conn->fd,vec,num);
+	}while((sent<0)&&(errno==EINTR));
+	if((sent<0)&&((errno==EAGAIN)||(errno==EWOULDBLOCK)))
+		sent=0;
+	return sent;
+}
+
+static bool AppendBacklog(cli_server_conn_t *conn, const char *data, size_t length)
+{
+	if(length>SIMCLI_SERVER_TX_LIMIT-conn->tx_len)
+		return false;
+	uint32_t need=conn->tx_len+(uint32_t)length;
+	if(need>conn->tx_size)
+	{
+		uint32_t size=conn->tx_size?conn->tx_size:SERVER_TX_MIN;
+		while(size<need)
+			size*=2;
+		char *buf=realloc(conn->tx_buf,size);
+		if(buf==NULL)
+			return false;
+		conn->tx_buf=buf;
+		conn->tx_size=size;
+	}
+	memcpy(&conn->tx_buf[conn->tx_len],data,length);
+	conn->tx_len=need;
+	return true;
+}
+
+/*Output of the session. Sent at once while the peer keeps up, otherwise queued after earlier output*/
+static uint32_t ServerVecWrite(const cli_iovec_t *iov, uint8_t iovcnt, void * _context)
+{
+	cli_server_conn_t *conn=((CliContextManager_t*)_context)->userData;
+	size_t total=0;
+	for(uint8_t i=0;i<iovcnt;++i)
+		total+=iov[i].length;
+	if(conn->failed)
+		return 0;
+	size_t sent=0;
+	if(conn->tx_len==0)
+	{
+		struct iovec vec[SERVER_IOV_NUM];
+		int num=0;
+		for(uint8_t i=0;(i<iovcnt)&&(num<SERVER_IOV_NUM);++i)
+		{
+			vec[num].iov_base=(void*)(uintptr_t)iov[i].base;
+			vec[num++].iov_len=iov[i].length;
+		}
+		ssize_t result=SendVec(conn,vec,num);
+		if(result<0)
+		{
+			conn->failed=true;
+			return 0;
+		}
+		sent=(size_t)result;
+	}
+	conn->server->stats.bytes_out+=sent;
+	for(uint8_t i=0;i<iovcnt;++i)
+	{
+		if(sent>=iov[i].length)
+		{
+			sent-=iov[i].length;
+			continue;
+		}
+		if(!AppendBacklog(conn,&iov[i].base[sent],iov[i].length-sent))
+		{
+			conn->failed=true;
+			return 0;
+		}
+		sent=0;
+	}
+	UpdateEvents(conn);
+	return (uint32_t)total;
+}
+
+static void SendBacklog(cli_server_conn_t *conn)
+{
+	struct iovec vec;
+	vec.iov_base=conn->tx_buf;
+	vec.iov_len=conn->tx_len;
+	ssize_t sent=SendVec(conn,&vec,1);
+	if(sent<0)
+	{
+		conn->failed=true;
+		return;
+	}
+	conn->server->stats.bytes_out+=(uint64_t)sent;
+	conn->tx_len-=(uint32_t)sent;
+	if(conn->tx_len)
+		memmove(conn->tx_buf,&conn->tx_buf[sent],conn->tx_len);
+	else
+	{
+		free(conn->tx_buf);												/*Idle sessions keep no output memory*/
+		conn->tx_buf=NULL;
+		conn->tx_size=0;
+	}
+	UpdateEvents(conn);
+}
+
+static void ReadInput(cli_server_conn_t *conn)
+{
+	cli_server_t *server=conn->server;
+	for(int i=0;(i<SIMCLI_SERVER_BATCH)&&!conn->failed&&(conn->events&EPOLLIN);++i)
+	{
+		ssize_t received=read(conn->fd,server->rx_buf,sizeof(server->rx_buf));
+		if(received>0)
+		{
+			server->stats.bytes_in+=(uint64_t)received;
+			FeedContextHandler(&conn->cli,server->rx_buf,(size_t)received);
+			if((size_t)received<sizeof(server->rx_buf))
+				break;
+			continue;
+		}
+		if((received<0)&&(errno==EINTR))
+			continue;
+		if((received<0)&&((errno==EAGAIN)||(errno==EWOULDBLOCK)))
+			break;
+		conn->input_end=true;											/*End of input or error*/
+		UpdateEvents(conn);
+		break;
+	}
+}
+
+static cli_server_conn_t* OpenConn(cli_server_t *server, int fd, int pty_slave)
+{
+	if(server->stats.sessions>=server->config.max_sessions)
+		return NULL;
+	if(!SetNonBlocking(fd))
+		return NULL;
+	cli_server_conn_t *conn=calloc(1,sizeof(cli_server_conn_t));
+	if(conn==NULL)
+		return NULL;
+	conn->fd=fd;
+	conn->pty_slave=pty_slave;
+	conn->server=server;
+	conn->cli.contextOwner=&conn->root;
+	InitCLIcontext(&conn->cli,server->config.handler,NULL,"Server");
+	if(server->config.registry)
+		AttachCliRegistry(&conn->cli,server->config.registry);
+	if(server->config.trie)
+		AttachCliTrie(&conn->cli,server->config.trie);
+	SetCliVectorOutput(&conn->cli,ServerVecWrite,conn);
+
+	struct epoll_event event;
+	event.events=EPOLLIN;
+	event.data.ptr=conn;
+	if(epoll_ctl(server->epoll_fd,EPOLL_CTL_ADD,fd,&event)!=0)
+	{
+		free(conn);
+		return NULL;
+	}
+	conn->events=EPOLLIN;
+	conn->next=server->conns;
+	if(server->conns)
+		server->conns->prev=conn;
+	server->conns=conn;
+	if(++server->stats.sessions>server->stats.peak_sessions)
+		server->stats.peak_sessions=server->stats.sessions;
+	if(server->config.on_open)
+		server->config.on_open(conn);
+	return conn;
+}
+
+static uint64_t MonotonicMs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000ULL+(uint64_t)ts.tv_nsec/1000000ULL;
+}
+
+static void SetListenEvents(cli_server_t *server, uint32_t events)
+{
+	struct epoll_event event;
+	event.events=events;
+	event.data.ptr=NULL;
+	epoll_ctl(server->epoll_fd,EPOLL_CTL_MOD,server->listen_fd,&event);
+}
+
+/*Level-triggered listening socket stays ready while connections can't be taken off the backlog.
+  It is removed from the poll set, so the loop does not spin, and pending peers wait in the backlog*/
+static void PauseAccept(cli_server_t *server, int error)
+{
+	SetListenEvents(server,0);
+	server->accept_resume=MonotonicMs()+SIMCLI_SERVER_ACCEPT_PAUSE_MS;
+	server->stats.accept_pauses++;
+	if(server->config.on_accept_error)
+		server->config.on_accept_error(server,error);
+}
+
+static void ResumeAccept(cli_server_t *server)
+{
+	if(server->accept_resume==0)
+		return;
+	server->accept_resume=0;
+	if(server->listen_fd>=0)
+		SetListenEvents(server,EPOLLIN);
+}
+
+static void AcceptConns(cli_server_t *server)
+{
+	for(;;)
+	{
+		int fd=accept4(server->listen_fd,NULL,NULL,SOCK_NONBLOCK|SOCK_CLOEXEC);
+		if(fd<0)
+		{
+			if((errno==EINTR)||(errno==ECONNABORTED))
+				continue;
+			if((errno==EMFILE)||(errno==ENFILE)||(errno==ENOBUFS)||(errno==ENOMEM))
+				PauseAccept(server,errno);
+			return;															/*Backlog is empty or accept() failed*/
+		}
+		server->stats.accepted++;
+		if(OpenConn(server,fd,-1)==NULL)
+		{
+			server->stats.rejected++;
+			close(fd);
+		}
+	}
+}
+
+bool InitCliServer(cli_server_t *server, const cli_server_config_t *config)
+{
+	if(server==NULL)
+		return false;
+	memset(server,0,sizeof(*server));
+	if(config)
+		server->config=*config;
+	if(server->config.handler==NULL)
+		server->config.handler=ServerMainHandler;
+	if(server->config.max_sessions==0)
+		server->config.max_sessions=SIMCLI_SERVER_MAX_SESSIONS;
+	server->listen_fd=-1;
+	server->epoll_fd=epoll_create1(EPOLL_CLOEXEC);
+	return server->epoll_fd>=0;
+}
+
+bool ListenCliServer(cli_server_t *server, const char *path)
+{
+	struct sockaddr_un addr;
+	if((server==NULL)||(path==NULL)||(server->listen_fd>=0)||(strlen(path)>=sizeof(addr.sun_path)))
+		return false;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,path);
+	int fd=socket(AF_UNIX,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+	if(fd<0)
+		return false;
+	unlink(path);
+	struct epoll_event event;
+	event.events=EPOLLIN;
+	event.data.ptr=NULL;													/*Listening socket*/
+	if((bind(fd,(struct sockaddr*)&addr,sizeof(addr))!=0)||(listen(fd,SOMAXCONN)!=0)||
+		(epoll_ctl(server->epoll_fd,EPOLL_CTL_ADD,fd,&event)!=0))
+	{
+		close(fd);
+		return false;
+	}
+	server->listen_fd=fd;
+	strcpy(server->path,path);
+	return true;
+}
+
+cli_server_conn_t* AddCliServerFd(cli_server_t *server, int fd)
+{
+	if((server==NULL)||(fd<0))
+		return NULL;
+	return OpenConn(server,fd,-1);
+}
+
+cli_server_conn_t* OpenCliServerPty(cli_server_t *server, char *slave_name, size_t size)
+{
+	if((server==NULL)||(slave_name==NULL)||(size==0))
+		return NULL;
+	int master=posix_openpt(O_RDWR|O_NOCTTY|O_CLOEXEC);
+	if(master<0)
+		return NULL;
+	int slave=-1;
+	if((grantpt(master)==0)&&(unlockpt(master)==0)&&(ptsname_r(master,slave_name,size)==0))
+		slave=open(slave_name,O_RDWR|O_NOCTTY|O_CLOEXEC);
+	struct termios tio;
+	if((slave>=0)&&(tcgetattr(slave,&tio)==0))
+	{
+		cfmakeraw(&tio);
+		if(tcsetattr(slave,TCSANOW,&tio)==0)
+		{
+			cli_server_conn_t *conn=OpenConn(server,master,slave);
+			if(conn)
+				return conn;
+		}
+	}
+	if(slave>=0)
+		close(slave);
+	close(master);
+	return NULL;
+}
+
+void CloseCliServerConn(cli_server_conn_t *conn)
+{
+	if(conn==NULL)
+		return;
+	cli_server_t *server=conn->server;
+	if(server->config.on_close)
+		server->config.on_close(conn);
+	epoll_ctl(server->epoll_fd,EPOLL_CTL_DEL,conn->fd,NULL);
+	close(conn->fd);
+	if(conn->pty_slave>=0)
+		close(conn->pty_slave);
+	if(conn->prev)
+		conn->prev->next=conn->next;
+	else
+		server->conns=conn->next;
+	if(conn->next)
+		conn->next->prev=conn->prev;
+	server->stats.sessions--;
+	free(conn->tx_buf);
+	free(conn);
+	ResumeAccept(server);												/*Descriptor is free for a new connection*/
+}
+
+int PollCliServer(cli_server_t *server, int timeout_ms)
+{
+	if(server==NULL)
+		return -1;
+	if(server->accept_resume)												/*Wake up to poll paused listening socket again*/
+	{
+		uint64_t now=MonotonicMs();
+		if(now>=server->accept_resume)
+			ResumeAccept(server);
+		else if((timeout_ms<0)||((uint64_t)timeout_ms>server->accept_resume-now))
+			timeout_ms=(int)(server->accept_resume-now);
+	}
+	struct epoll_event events[SERVER_EVENTS_NUM];
+	int num=epoll_wait(server->epoll_fd,events,SERVER_EVENTS_NUM,timeout_ms);
+	if(num<0)
+		return (errno==EINTR)?0:-1;
+	if(server->accept_resume&&(MonotonicMs()>=server->accept_resume))
+		ResumeAccept(server);
+	for(int i=0;i<num;++i)
+	{
+		cli_server_conn_t *conn=events[i].data.ptr;
+		if(conn==NULL)
+		{
+			AcceptConns(server);
+			continue;
+		}
+		if(events[i].events&EPOLLOUT)
+			SendBacklog(conn);
+		if(events[i].events&(EPOLLIN|EPOLLHUP|EPOLLERR))
+			ReadInput(conn);
+		if(conn->failed||(events[i].events&EPOLLERR))
+		{
+			server->stats.dropped++;
+			CloseCliServerConn(conn);
+		}
+		else if(conn->input_end&&(conn->tx_len==0))
+			CloseCliServerConn(conn);
+		else if((events[i].events&EPOLLHUP)&&!(conn->events&EPOLLIN))			/*Peer is gone, output can't be sent*/
+			CloseCliServerConn(conn);
+	}
+	return num;
+}
+
+bool RunCliServer(cli_server_t *server)
+{
+	if(server==NULL)
+		return false;
+	server->running=true;
+	while(server->running)
+	{
+		if(PollCliServer(server,-1)<0)
+			return false;
+	}
+	return true;
+}
+
+void StopCliServer(cli_server_t *server)
+{
+	if(server)
+		server->running=false;
+}
+
+void CloseCliServer(cli_server_t *server)
+{
+	if(server==NULL)
+		return;
+	while(server->conns)
+		CloseCliServerConn(server->conns);
+	if(server->listen_fd>=0)
+	{
+		close(server->listen_fd);
+		unlink(server->path);
+		server->listen_fd=-1;
+	}
+	if(server->epoll_fd>=0)
+		close(server->epoll_fd);
+	server->epoll_fd=-1;
+}
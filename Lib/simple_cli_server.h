@@ -0,0 +1,216 @@
+/*
+ * simple_cli_server.h
+ *
+ * Description: Serves CLI sessions over UNIX domain sockets and PTYs from one epoll loop (Linux hosts).
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+/*
+ * MIT License
+ *
+ * Copyright (c) [2023] [Alex Trusk]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SIMPLE_CLI_SERVER_H
+#define SIMPLE_CLI_SERVER_H
+
+#include "simple_cli.h"
+
+#ifndef SIMCLI_SERVER_READ_SIZE
+	#define SIMCLI_SERVER_READ_SIZE 	4096				/*Receive buffer shared by all sessions of the server*/
+#endif
+
+#ifndef SIMCLI_SERVER_BATCH
+	#define SIMCLI_SERVER_BATCH 		4					/*Max reads per session wakeup. Rest of the input waits for the next loop pass*/
+#endif
+
+#ifndef SIMCLI_SERVER_TX_LIMIT
+	#define SIMCLI_SERVER_TX_LIMIT 		65536				/*Max output waiting for a slow peer. Session is dropped when it is exceeded*/
+#endif
+
+#ifndef SIMCLI_SERVER_MAX_SESSIONS
+	#define SIMCLI_SERVER_MAX_SESSIONS 	4096				/*Default limit of concurrent sessions*/
+#endif
+
+#ifndef SIMCLI_SERVER_ACCEPT_PAUSE_MS
+	#define SIMCLI_SERVER_ACCEPT_PAUSE_MS 1000				/*Listening socket is paused when descriptors are exhausted, until a session is closed or this time passes*/
+#endif
+
+struct cli_server_t;
+
+/**
+ * @brief Connection of the server. Allocated when the peer connects, freed when it is closed
+ */
+typedef struct cli_server_conn_t
+{
+	CliContextManager_t 			cli;		/*Session of the connection*/
+	Context_t 						root;		/*Main context of the session*/
+	int 							fd;			/*Socket or PTY master. Non-blocking*/
+	int 							pty_slave;	/*PTY slave kept open by the server, so master is not hung up between peers. -1 - no PTY*/
+	void* 							user_data;	/*User pointer*/
+	/*Server internals*/
+	char* 							tx_buf;		/*Output the peer has not taken yet. Allocated only while there is such output*/
+	uint32_t 						tx_len;
+	uint32_t 						tx_size;
+	uint32_t 						events;		/*Registered epoll events*/
+	bool 							input_end;	/*Peer closed its side, session is closed when output is sent*/
+	bool 							failed;		/*I/O error or output limit, session is closed*/
+	struct cli_server_t* 			server;
+	struct cli_server_conn_t* 		prev;
+	struct cli_server_conn_t* 		next;
+}cli_server_conn_t;
+
+/**
+ * @brief Settings of server sessions
+ */
+typedef struct
+{
+	context_handler_f 			handler;		/*Main context handler of sessions. NULL - lines are run by ProcessCommand()*/
+	const cli_registry_t* 		registry;		/*Command set of sessions. NULL - commands added by AddNewCommand()*/
+	const struct cli_trie_t* 	trie;			/*Names tree for abbreviated commands. Can be NULL*/
+	uint32_t 					max_sessions;	/*0 - SIMCLI_SERVER_MAX_SESSIONS*/
+	void 						(*on_open)(cli_server_conn_t *conn);	/*Called when session is ready, e.g. to send a banner. Can be NULL*/
+	void 						(*on_close)(cli_server_conn_t *conn);	/*Called before session is freed. Can be NULL*/
+	void 						(*on_accept_error)(struct cli_server_t *server, int error);	/*Called with errno when accept() runs out of descriptors and new connections are paused. Can be NULL*/
+}cli_server_config_t;
+
+/**
+ * @brief Server counters
+ */
+typedef struct
+{
+	uint32_t 	sessions;				/*Open sessions*/
+	uint32_t 	peak_sessions;			/*Max number of open sessions*/
+	uint64_t 	accepted;				/*Connections accepted on the socket*/
+	uint64_t 	rejected;				/*Connections closed at once because of max_sessions*/
+	uint64_t 	accept_pauses;			/*Listening socket paused because accept() ran out of descriptors*/
+	uint64_t 	dropped;				/*Sessions closed because of I/O error or SIMCLI_SERVER_TX_LIMIT*/
+	uint64_t 	bytes_in;
+	uint64_t 	bytes_out;
+}cli_server_stats_t;
+
+/**
+ * @brief Session server. All sessions are served by the thread that calls PollCliServer()
+ */
+typedef struct cli_server_t
+{
+	int 						epoll_fd;
+	int 						listen_fd;		/*UNIX domain socket. -1 - not listening*/
+	uint64_t 					accept_resume;	/*Monotonic time (ms) when paused listening socket is polled again. 0 - not paused*/
+	char 						path[108];		/*Socket path, removed by CloseCliServer()*/
+	volatile bool 				running;
+	cli_server_config_t 		config;
+	cli_server_stats_t 			stats;
+	cli_server_conn_t* 			conns;			/*Open sessions*/
+	char 						rx_buf[SIMCLI_SERVER_READ_SIZE];
+}cli_server_t;
+
+
+/**
+ * @brief Initializes server
+ *
+ * @param server 	[out] Server object
+ * @param config 	[in] Session settings. NULL - defaults
+ * @return True - success, False - invalid arguments or system error
+ */
+bool InitCliServer(cli_server_t *server, const cli_server_config_t *config);
+
+
+/**
+ * @brief Starts accepting connections on UNIX domain socket. Stale socket file is removed
+ *
+ * @param server 	[in] Server object
+ * @param path 		[in] Socket path
+ * @return True - success, False - invalid arguments, already listening or system error
+ */
+bool ListenCliServer(cli_server_t *server, const char *path);
+
+
+/**
+ * @brief Adds session on any stream descriptor: accepted socket, serial port, pipe.
+ * fd is switched to non-blocking mode and is closed with the session
+ *
+ * @param server 	[in] Server object
+ * @param fd 		[in] Session input and output
+ * @return Session or NULL - invalid arguments, max_sessions reached or system error
+ */
+cli_server_conn_t* AddCliServerFd(cli_server_t *server, int fd);
+
+
+/**
+ * @brief Creates PTY and serves a session on its master side. Peers open the slave device
+ * (e.g. with screen or minicom), the slave is set to raw mode so input reaches the line
+ * assembler as is. Session lives until the server is closed
+ *
+ * @param server 		[in] Server object
+ * @param slave_name 	[out] Path of the slave device
+ * @param size 			[in] Size of slave_name buffer
+ * @return Session or NULL - invalid arguments, max_sessions reached or system error
+ */
+cli_server_conn_t* OpenCliServerPty(cli_server_t *server, char *slave_name, size_t size);
+
+
+/**
+ * @brief Waits for events and serves ready sessions: accepts connections, reads input into
+ * FeedContextHandler(), sends output that was waiting for the peer and closes finished sessions
+ *
+ * @param server 		[in] Server object
+ * @param timeout_ms 	[in] Max wait time, -1 - no limit
+ * @return Number of events handled, -1 - error. Wait interrupted by a signal returns 0
+ */
+int PollCliServer(cli_server_t *server, int timeout_ms);
+
+
+/**
+ * @brief Calls PollCliServer() until StopCliServer()
+ *
+ * @param server 	[in] Server object
+ * @return True - stopped, False - error
+ */
+bool RunCliServer(cli_server_t *server);
+
+
+/**
+ * @brief Stops RunCliServer(). Can be called from a signal handler
+ *
+ * @param server 	[in] Server object
+ */
+void StopCliServer(cli_server_t *server);
+
+
+/**
+ * @brief Closes all sessions, the socket and the epoll descriptor
+ *
+ * @param server 	[in] Server object
+ */
+void CloseCliServer(cli_server_t *server);
+
+
+/**
+ * @brief Closes session. Its output that the peer has not taken yet is dropped.
+ * Must not be called from the handlers of this session
+ *
+ * @param conn 	[in] Session
+ */
+void CloseCliServerConn(cli_server_conn_t *conn);
+
+#endif
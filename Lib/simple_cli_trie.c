@@ -0,0 +1,268 @@
+#include "string.h"
+#include "simple_cli_trie.h"
+
+#define TRIE_NONE 						0xFFFFu				/*No node*/
+
+static const char* NodeLabel(const cli_trie_node_t *node)
+{
+	return node->key+node->offset;
+}
+
+static uint16_t NewNode(cli_trie_t *trie, const char* key, uint8_t offset, const cli_command_t *command)
+{
+	if(trie->count>=SIMCLI_TRIE_NODES)
+		return TRIE_NONE;
+	cli_trie_node_t *node=&trie->nodes[trie->count];
+	memset(node,0,sizeof(*node));
+	node->key=key;
+	node->offset=offset;
+	node->length=(uint8_t)(strlen(key)-offset);
+	node->command=command;
+	return trie->count++;
+}
+
+/*Links new child keeping children sorted by the first label symbol*/
+static void LinkChild(cli_trie_t *trie, uint16_t parent, uint16_t child)
+{
+	uint16_t *link=&trie->nodes[parent].child;
+	char first=NodeLabel(&trie->nodes[child])[0];
+	while(*link&&(NodeLabel(&trie->nodes[*link-1])[0]<first))
+		link=&trie->nodes[*link-1].sibling;
+	trie->nodes[child].sibling=*link;
+	*link=(uint16_t)(child+1);
+}
+
+/*Finds child whose label starts with symbol. Returns link that points to it*/
+static uint16_t* FindChild(cli_trie_t *trie, uint16_t parent, char symbol)
+{
+	uint16_t *link=&trie->nodes[parent].child;
+	while(*link&&(NodeLabel(&trie->nodes[*link-1])[0]!=symbol))
+		link=&trie->nodes[*link-1].sibling;
+	return link;
+}
+
+/*Adds key to the tree with root node. Returns terminal node of the key, TRIE_NONE - no free nodes or duplicate key*/
+static uint16_t InsertKey(cli_trie_t *trie, uint16_t root, const char* key, const cli_command_t *command)
+{
+	uint16_t node=root;
+	uint8_t pos=0;
+	while(key[pos])
+	{
+		uint16_t *link=FindChild(trie,node,key[pos]);
+		if(*link==0)
+		{
+			uint16_t leaf=NewNode(trie,key,pos,command);
+			if(leaf==TRIE_NONE)
+				return TRIE_NONE;
+			LinkChild(trie,node,leaf);
+			trie->nodes[leaf].terminal=true;
+			return leaf;
+		}
+		uint16_t child=(uint16_t)(*link-1);
+		const char *label=NodeLabel(&trie->nodes[child]);
+		uint8_t common=0;
+		while((common<trie->nodes[child].length)&&(label[common]==key[pos+common]))
+			++common;
+		if(common<trie->nodes[child].length)					/*Key diverges inside the label: split the edge*/
+		{
+			uint16_t mid=NewNode(trie,trie->nodes[child].key,trie->nodes[child].offset,trie->nodes[child].command);
+			if(mid==TRIE_NONE)
+				return TRIE_NONE;
+			cli_trie_node_t *edge=&trie->nodes[child];
+			trie->nodes[mid].length=common;
+			trie->nodes[mid].sibling=edge->sibling;
+			trie->nodes[mid].child=(uint16_t)(child+1);
+			*link=(uint16_t)(mid+1);
+			edge->sibling=0;
+			edge->offset=(uint8_t)(edge->offset+common);
+			edge->length=(uint8_t)(edge->length-common);
+			child=mid;
+		}
+		node=child;
+		pos=(uint8_t)(pos+common);
+	}
+	if(trie->nodes[node].terminal||(node==root))
+		return TRIE_NONE;										/*Duplicate or empty key*/
+	trie->nodes[node].terminal=true;
+	trie->nodes[node].key=key;									/*Key ends here, label is its suffix*/
+	trie->nodes[node].command=command;
+	return node;
+}
+
+static bool AddTrieCommand(cli_trie_t *trie, const cli_command_t *command)
+{
+	uint16_t node=InsertKey(trie,0,command->cmd_name,command);
+	if(node==TRIE_NONE)
+		return false;
+	if(command->args_num==0)
+		return true;
+	uint16_t args_root=NewNode(trie,"",0,command);
+	if(args_root==TRIE_NONE)
+		return false;
+	trie->nodes[node].args=(uint16_t)(args_root+1);
+	for(uint8_t i=0;i<command->args_num;++i)
+	{
+		if(InsertKey(trie,args_root,command->args[i].arg_name,command)==TRIE_NONE)
+			return false;
+	}
+	return true;
+}
+
+bool BuildCliTrie(cli_trie_t *trie, const cli_registry_t *registry)
+{
+	if(trie==NULL)
+		return false;
+	registry=registry?registry:GetCliRegistry(NULL);
+	trie->count=0;
+	NewNode(trie,"",0,NULL);									/*Root of command names*/
+	for(uint16_t i=0;registry->table&&(i<registry->table->count);++i)
+	{
+		if(!AddTrieCommand(trie,&registry->table->commands[i]))
+			return false;
+	}
+	for(uint16_t i=0;i<registry->count;++i)
+	{
+		if(!AddTrieCommand(trie,registry->cold[i]))
+			return false;
+	}
+	return true;
+}
+
+/*Walks length symbols of prefix from root. Returns the node whose subtree holds all keys that 
+  start with prefix, TRIE_NONE - no such keys. exact - prefix ends at the end of node label*/
+static uint16_t WalkPrefix(const cli_trie_t *trie, uint16_t root, const char* prefix, size_t length, bool *exact)
+{
+	uint16_t node=root;
+	size_t pos=0;
+	*exact=true;
+	while(pos<length)
+	{
+		uint16_t child=trie->nodes[node].child;
+		while(child&&(NodeLabel(&trie->nodes[child-1])[0]!=prefix[pos]))
+			child=trie->nodes[child-1].sibling;
+		if(child==0)
+			return TRIE_NONE;
+		const cli_trie_node_t *edge=&trie->nodes[child-1];
+		size_t num=length-pos;
+		if(num>edge->length)
+			num=edge->length;
+		if(strncmp(NodeLabel(edge),&prefix[pos],num)!=0)
+			return TRIE_NONE;
+		node=(uint16_t)(child-1);
+		pos+=num;
+		*exact=(num==edge->length);
+	}
+	return node;
+}
+
+/*Returns the only key of the subtree, TRIE_NONE - subtree holds several keys*/
+static uint16_t UniqueKey(const cli_trie_t *trie, uint16_t node)
+{
+	while(!trie->nodes[node].terminal)
+	{
+		uint16_t child=trie->nodes[node].child;
+		if((child==0)||trie->nodes[child-1].sibling)
+			return TRIE_NONE;
+		node=(uint16_t)(child-1);
+	}
+	return trie->nodes[node].child?TRIE_NONE:node;
+}
+
+/*Full name or unique prefix lookup. Returns terminal node*/
+static uint16_t MatchKey(const cli_trie_t *trie, uint16_t root, const char* name, size_t length)
+{
+	bool exact;
+	if(length==0)
+		return TRIE_NONE;
+	uint16_t node=WalkPrefix(trie,root,name,length,&exact);
+	if(node==TRIE_NONE)
+		return TRIE_NONE;
+	if(exact&&trie->nodes[node].terminal)
+		return node;
+	return UniqueKey(trie,node);
+}
+
+const cli_command_t* MatchTrieCmd(const cli_trie_t *trie, const char* name)
+{
+	if((trie==NULL)||(name==NULL)||(trie->count==0))
+		return NULL;
+	uint16_t node=MatchKey(trie,0,name,strlen(name));
+	return (node==TRIE_NONE)?NULL:trie->nodes[node].command;
+}
+
+uint8_t MatchTrieArg(const cli_trie_t *trie, const cli_command_t *command, const char* name)
+{
+	if((trie==NULL)||(command==NULL)||(name==NULL)||(trie->count==0))
+		return 0;
+	uint16_t cmd_node=MatchKey(trie,0,command->cmd_name,strlen(command->cmd_name));
+	if((cmd_node==TRIE_NONE)||(trie->nodes[cmd_node].args==0))
+		return 0;
+	uint16_t node=MatchKey(trie,(uint16_t)(trie->nodes[cmd_node].args-1),name,strlen(name));
+	if(node==TRIE_NONE)
+		return 0;
+	const cli_command_t *owner=trie->nodes[node].command;
+	for(uint8_t i=0;i<owner->args_num;++i)
+	{
+		if(owner->args[i].arg_name==trie->nodes[node].key)
+			return (uint8_t)(i+1);
+	}
+	return 0;
+}
+
+static void CollectKeys(const cli_trie_t *trie, uint16_t node, const char** candidates, uint16_t max_candidates, uint16_t *count)
+{
+	if(trie->nodes[node].terminal)
+	{
+		if(*count<max_candidates)
+			candidates[*count]=trie->nodes[node].key;
+		(*count)++;
+	}
+	for(uint16_t child=trie->nodes[node].child;child;child=trie->nodes[child-1].sibling)
+		CollectKeys(trie,(uint16_t)(child-1),candidates,max_candidates,count);
+}
+
+static bool IsDelimiter(char symbol)
+{
+	return (symbol!='\0')&&strchr(SIMCLI_ARGS_DELIMITER,symbol);
+}
+
+uint16_t CompleteCmdLine(const cli_trie_t *trie, const char* line, const char** candidates, uint16_t max_candidates, size_t *common_len)
+{
+	uint16_t count=0;
+	bool exact;
+	if(common_len)
+		*common_len=0;
+	if((trie==NULL)||(line==NULL)||(trie->count==0))
+		return 0;
+	while(IsDelimiter(*line))
+		++line;
+	size_t cmd_len=0;
+	while(line[cmd_len]&&!IsDelimiter(line[cmd_len]))
+		++cmd_len;
+
+	uint16_t root=0;
+	const char *word=line;
+	size_t word_len=cmd_len;
+	if(line[cmd_len])											/*Command name is complete, last word is an argument*/
+	{
+		uint16_t cmd_node=MatchKey(trie,0,line,cmd_len);
+		if((cmd_node==TRIE_NONE)||(trie->nodes[cmd_node].args==0))
+			return 0;
+		root=(uint16_t)(trie->nodes[cmd_node].args-1);
+		word=line+strlen(line);
+		while((word>line)&&!IsDelimiter(word[-1]))
+			--word;
+		word_len=strlen(word);
+	}
+	uint16_t node=WalkPrefix(trie,root,word,word_len,&exact);
+	if(node==TRIE_NONE)
+		return 0;
+	CollectKeys(trie,node,candidates,max_candidates,&count);
+	if(common_len&&count)
+	{
+		while(!trie->nodes[node].terminal&&trie->nodes[node].child&&!trie->nodes[trie->nodes[node].child-1].sibling)
+			node=(uint16_t)(trie->nodes[node].child-1);
+		*common_len=(size_t)trie->nodes[node].offset+trie->nodes[node].length;
+	}
+	return count;
+}
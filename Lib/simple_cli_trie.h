@@ -0,0 +1,114 @@
+/*
+ * simple_cli_trie.h
+ *
+ * Description: Radix tree of command and argument names: prefix matching and completion.
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+/*
+ * MIT License
+ *
+ * Copyright (c) [2023] [Alex Trusk]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef SIMPLE_CLI_TRIE_H
+#define SIMPLE_CLI_TRIE_H
+
+#include "simple_cli.h"
+
+#ifndef SIMCLI_TRIE_NODES
+	#define SIMCLI_TRIE_NODES 			(2*SIMCLI_MAX_COMMANDS*(SIMCLI_MAX_ARGS+2))	/*Node pool size. Radix tree of N names takes up to 2*N nodes*/
+#endif
+
+/**
+ * @brief Radix tree node. Edge label is not copied, it points into stored command or argument name
+ */
+typedef struct
+{
+	const char* 			key;			/*Full name of a key in the subtree. Edge label is key[offset]..key[offset+length-1]*/
+	const cli_command_t* 	command;		/*Command that owns the key*/
+	uint8_t 				offset;
+	uint8_t 				length;
+	bool 					terminal;		/*Name ends in this node*/
+	uint16_t 				child;			/*First child, node index + 1. Children are sorted by label*/
+	uint16_t 				sibling;		/*Next sibling, node index + 1*/
+	uint16_t 				args;			/*Command name node: root of its argument name tree + 1*/
+}cli_trie_node_t;
+
+/**
+ * @brief Radix tree of command names. Each command name node refers to the tree of its argument names
+ */
+typedef struct cli_trie_t
+{
+	uint16_t 			count;							/*Used nodes. Node 0 is the root of command names*/
+	cli_trie_node_t 	nodes[SIMCLI_TRIE_NODES];
+}cli_trie_t;
+
+
+/**
+ * @brief Builds tree of command and argument names of command set. Must be rebuilt after commands are added
+ *
+ * @param trie 		[out] Tree object
+ * @param registry 	[in] Command set. NULL - default command set
+ * @return True - success, False - invalid arguments or SIMCLI_TRIE_NODES is too small
+ */
+bool BuildCliTrie(cli_trie_t *trie, const cli_registry_t *registry);
+
+
+/**
+ * @brief Finds command by its full name or by unique prefix. Full name wins over longer names 
+ * that start with it
+ *
+ * @param trie 		[in] Tree object
+ * @param name 		[in] Command name or its prefix
+ * @return Command description, NULL - not found or prefix is ambiguous
+ */
+const cli_command_t* MatchTrieCmd(const cli_trie_t *trie, const char* name);
+
+
+/**
+ * @brief Finds argument of the command by its full name or by unique prefix
+ *
+ * @param trie 		[in] Tree object
+ * @param command 	[in] Command returned by MatchTrieCmd()
+ * @param name 		[in] Argument name or its prefix
+ * @return Position of the argument in command args[] + 1, 0 - not found or prefix is ambiguous
+ */
+uint8_t MatchTrieArg(const cli_trie_t *trie, const cli_command_t *command, const char* name);
+
+
+/**
+ * @brief Lists completion candidates for the last word of partial command line. The first word
+ * is completed with command names, the next ones with argument names of that command.
+ *
+ * @param trie 				[in] Tree object
+ * @param line 				[in] Partial command line, '\0'-terminated
+ * @param candidates 		[out] Full names that start with the last word, sorted
+ * @param max_candidates 	[in] Size of candidates array
+ * @param common_len 		[out] Length of the prefix shared by all candidates. Characters of candidates[0]
+ * 							after the last word up to common_len can be appended to the line. Can be NULL
+ * @return Number of matching names. Can be greater than max_candidates
+ */
+uint16_t CompleteCmdLine(const cli_trie_t *trie, const char* line, const char** candidates, uint16_t max_candidates, size_t *common_len);
+
+#endif
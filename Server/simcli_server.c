@@ -0,0 +1,96 @@
+/*
+ * simcli_server.c
+ *
+ * Description: Linux host service that serves the demo command set over a UNIX domain socket and PTYs.
+ *              Usage: simcli_server [-s socket_path] [-p pty_count] [-n max_sessions]
+ *              Connect with e.g. "socat - UNIX-CONNECT:/tmp/simple_cli.sock" or "screen /dev/pts/N".
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "signal.h"
+#include "unistd.h"
+#include "simple_cli_server.h"
+#include "cli_command_set.h"
+
+static cli_server_t Server;
+
+static void OnSignal(int signum)
+{
+	(void)(signum);
+	StopCliServer(&Server);
+}
+
+static void OnAcceptError(cli_server_t *server, int error)
+{
+	(void)(server);
+	fprintf(stderr,"accept: %s, new connections paused for %u ms\n",strerror(error),(unsigned)SIMCLI_SERVER_ACCEPT_PAUSE_MS);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path=NULL;
+	unsigned ptys=0;
+	cli_server_config_t config={.on_accept_error=OnAcceptError};
+	int opt;
+	while((opt=getopt(argc,argv,"s:p:n:"))!=-1)
+	{
+		switch(opt)
+		{
+			case 's': path=optarg; break;
+			case 'p': ptys=(unsigned)strtoul(optarg,NULL,10); break;
+			case 'n': config.max_sessions=(uint32_t)strtoul(optarg,NULL,10); break;
+			default:
+				fprintf(stderr,"Usage: %s [-s socket_path] [-p pty_count] [-n max_sessions]\n",argv[0]);
+				return 1;
+		}
+	}
+	if((path==NULL)&&(ptys==0))
+		path="/tmp/simple_cli.sock";
+
+	/*Commands are added once and are only read by sessions*/
+	initSimpleCliSet();
+#if (SIMCLI_USE_STATS==1)
+	AddStatsCommand(NULL,0x10);
+#endif
+	if(!InitCliServer(&Server,&config))
+	{
+		perror("InitCliServer");
+		return 1;
+	}
+	if(path&&!ListenCliServer(&Server,path))
+	{
+		perror(path);
+		return 1;
+	}
+	if(path)
+		printf("Listening on %s\n",path);
+	for(unsigned i=0;i<ptys;++i)
+	{
+		char name[64];
+		if(OpenCliServerPty(&Server,name,sizeof(name))==NULL)
+		{
+			perror("OpenCliServerPty");
+			return 1;
+		}
+		printf("PTY session on %s\n",name);
+	}
+	fflush(stdout);
+
+	struct sigaction action={0};
+	action.sa_handler=OnSignal;											/*No SA_RESTART: signal interrupts epoll_wait()*/
+	sigaction(SIGINT,&action,NULL);
+	sigaction(SIGTERM,&action,NULL);
+	signal(SIGPIPE,SIG_IGN);											/*Write errors are handled per session*/
+
+	bool result=RunCliServer(&Server);
+	printf("Sessions: %u open, %u peak, %llu accepted, %llu rejected, %llu dropped, %llu accept pauses. Bytes: %llu in, %llu out\n",
+			(unsigned)Server.stats.sessions,(unsigned)Server.stats.peak_sessions,
+			(unsigned long long)Server.stats.accepted,(unsigned long long)Server.stats.rejected,
+			(unsigned long long)Server.stats.dropped,(unsigned long long)Server.stats.accept_pauses,(unsigned long long)Server.stats.bytes_in,
+			(unsigned long long)Server.stats.bytes_out);
+	CloseCliServer(&Server);
+	return result?0:1;
+}
@@ -1,12 +1,13 @@
 #include "string.h"
 #include "stdbool.h"
 #include "simple_cli.h"
-#include "stdio.h"
+#include "SimpleCliCommands.h"
 
 static const uint8_t minAsciiArr[] = {33, 35, 45, 65, 97};      // Array of min values of ASCII codes
 static const uint8_t maxAsciiArr[] = {33, 41, 57, 90, 122};     // Array of max values of ASCII codes
 static const int numRanges = 5;                         		// Number of ranges in arrays
 static size_t file_size_global;
+static size_t bytes_written_global;
 #ifndef UNUSED_PARAMETER
 	#define UNUSED_PARAMETER(x)    ((void)(x))
 #endif
@@ -29,30 +30,28 @@ uint8_t checkAllowedCharacters(const char* str) {
     return true;
 }
 
-uint8_t test_write_buffered(char* data,uint16_t length)
+uint8_t test_write_buffered(CliContextManager_t * _context, char* data,uint16_t length)
 {
-	static size_t bytesWritten=0;
 	if(data==NULL)
 		return 0;
-	if((bytesWritten+length)<file_size_global)
+	CliWriteUint(_context,length);									/*Just for test purposes*/
+	CliWriteStr(_context," bytes have been written\n");
+	if((bytes_written_global+length)<file_size_global)
 	{
-		printf("%d bytes have been written\n", length);				/*Just for test purposes*/
-		bytesWritten+=length;
+		bytes_written_global+=length;
 		return 1;
 	}
 	else
 	{
-		printf("%d bytes have been written\n", length);	
-		bytesWritten=0;
+		bytes_written_global=0;
 		return 0;
 	}
-	
-	
 }
 
 void SDC_drv_fopen(const char *file_name, uint8_t attributes, size_t file_size)
 {
 	file_size_global=file_size;
+	bytes_written_global=0;
 	UNUSED_PARAMETER(file_name);
 	UNUSED_PARAMETER(attributes);
 }
@@ -72,11 +71,16 @@ bool sendfile_cmd(char **argv, cli_command_t* self, CliContextManager_t * _conte
 	const char *err_msg_list[]={	"Unknown argument\n" ,
 									"Bad argument value\n",
 									"Missing argument value\n",
-									"Restricted character in filename\n"};
+									"Restricted character in filename\n",
+									"Argument value out of range\n",
+									"Argument value too long\n"};
     /*default values*/
     uint32_t file_size=1024;
     uint8_t overwrite_flag=0;
-    char file_name[32]= "Default";
+    char *file_name=CliArenaAlloc(_context,self->args[2].value_size);	/*Released when command returns*/
+    if(file_name==NULL)
+		return false;
+    strcpy(file_name,"Default");
     /*Here we MUST initialize  ALL possible command attributes with therefore used addresses of variables*/
     self->args[0].value=&file_size;
     self->args[1].value=&overwrite_flag;
@@ -88,13 +92,19 @@ bool sendfile_cmd(char **argv, cli_command_t* self, CliContextManager_t * _conte
 			case SIM_CLI_OK:
 				break;
 			case SIM_CLI_ARG_UNKNOWN:
-				_context->stdoutFunc(err_msg_list[0],strlen(err_msg_list[0]));
+				CliWrite(_context,err_msg_list[0],strlen(err_msg_list[0]));
 				return false;
 			case SIM_CLI_ARG_BAD_VALUE:
-				_context->stdoutFunc(err_msg_list[1],strlen(err_msg_list[1]));
+				CliWrite(_context,err_msg_list[1],strlen(err_msg_list[1]));
 				return false;
 			case SIM_CLI_ARG_MISSING_VALUE:
-				_context->stdoutFunc(err_msg_list[2],strlen(err_msg_list[2]));
+				CliWrite(_context,err_msg_list[2],strlen(err_msg_list[2]));
+				return false;
+			case SIM_CLI_ARG_OUT_OF_RANGE:
+				CliWrite(_context,err_msg_list[4],strlen(err_msg_list[4]));
+				return false;
+			case SIM_CLI_ARG_TOO_LONG:
+				CliWrite(_context,err_msg_list[5],strlen(err_msg_list[5]));
 				return false;
 			default:
 				break;
@@ -102,23 +112,29 @@ bool sendfile_cmd(char **argv, cli_command_t* self, CliContextManager_t * _conte
 	
     if(!checkAllowedCharacters(file_name))
     {
-		printf("File name should contain only allowed character\n");
-		_context->stdoutFunc(err_msg_list[3],strlen(err_msg_list[3]));
+		CliWriteStr(_context,"File name should contain only allowed character\n");
+		CliWrite(_context,err_msg_list[3],strlen(err_msg_list[3]));
         return false;
     }
 	
+	CliWriteStr(_context,"Will open file named ");
+	CliWriteStr(_context,file_name);
 	if(file_size== 1024)
-		{printf("Will open file named %s. Size is not set\n",file_name);}
+		{CliWriteStr(_context,". Size is not set\n");}
 	else
-		{printf("Will open file named %s with the size of %u bytes\n",file_name,file_size);}
+	{
+		CliWriteStr(_context," with the size of ");
+		CliWriteUint(_context,file_size);
+		CliWriteStr(_context," bytes\n");
+	}
     
 	/*!!! Data flow management transferred to sendfile command context*/		
 	if(!AcquireContext(_context,&self->cmd_context))					
 	{
-		printf("sendfile_cmd: Context not acquired!\n");	
+		CliWriteStr(_context,"sendfile_cmd: Context not acquired!\n");
 		return false;
 	}
-	printf("Context acquired\n");
+	CliWriteStr(_context,"Context acquired\n");
 	SDC_drv_fopen(file_name, 0,file_size);	/*Simulating file open procedure*/
 	return true;
 }
@@ -131,10 +147,10 @@ bool sendfile_cmd(char **argv, cli_command_t* self, CliContextManager_t * _conte
 bool sendfile_context_handler(char *data, size_t length,void * _context)
 {
 	/*Checking for end line sequence.*/
-	if((*(data+length-1)==0x00)&&(*(data+length-2)==0x0A)&&(*(data+length-3)==0x0D))
+	if((length>=3)&&(*(data+length-1)==0x00)&&(*(data+length-2)==0x0A)&&(*(data+length-3)==0x0D))
 		length-=3;
 	
-	if (test_write_buffered(data,length)==true)
+	if (test_write_buffered(_context,data,(uint16_t)length)==true)
 	{
 		return true;
 	}
@@ -142,11 +158,39 @@ bool sendfile_context_handler(char *data, size_t length,void * _context)
 	{
 		file_size_global=0;
 		ReleaseContext(_context);
-		printf("Context released\n");
+		CliWriteStr(_context,"Context released\n");
 		return false;
 	}
 }
 
+/**
+ * @brief Bulk data handler of sendfile command.
+ * Whole DMA/ring buffer region is passed at once. Handler takes only the bytes
+ * that belong to the file and reports completion, so context manager releases the context.
+ */
+size_t sendfile_bulk_handler(const cli_data_view_t *view, bool *complete, void * _context)
+{
+	size_t consumed=0;
+	for(int i=0;i<2;++i)
+	{
+		size_t chunk=file_size_global-bytes_written_global;
+		if(view->length[i]<chunk)
+			chunk=view->length[i];
+		/*SD card write of view->data[i] would be here*/
+		bytes_written_global+=chunk;
+		consumed+=chunk;
+	}
+	if(bytes_written_global>=file_size_global)
+	{
+		CliWriteUint(_context,bytes_written_global);
+		CliWriteStr(_context," bytes have been written\n");
+		CliWriteStr(_context,"Context released\n");
+		bytes_written_global=0;
+		file_size_global=0;
+		*complete=true;
+	}
+	return consumed;
+}
 
 bool SDC_driver_mount()
 {
@@ -160,51 +204,67 @@ bool mountSD_cmd(char **argv, cli_command_t* self, CliContextManager_t * _contex
 	const char err_SD_pass_msg[]=	"Mount success\n";
 	if ((argv[0])&&(!self->args_num)) /*Checking if there any arguments are passed*/
     {
-        printf("%s",err_arg_msg);
-		_context->stdoutFunc(err_arg_msg,strlen(err_arg_msg));
+		CliWrite(_context,err_arg_msg,strlen(err_arg_msg));
         return false;
     }
 	if(SDC_driver_mount())
 	{
-		_context->stdoutFunc(err_SD_pass_msg,strlen(err_SD_pass_msg));
+		CliWrite(_context,err_SD_pass_msg,strlen(err_SD_pass_msg));
 		return 1;
 	}
 	else
 	{
-		_context->stdoutFunc(err_SD_fail_msg,strlen(err_SD_fail_msg));
+		CliWrite(_context,err_SD_fail_msg,strlen(err_SD_fail_msg));
 		return 0;
 	}
 }
 
+/*Asynchronous mount simulation: driver needs a few polls to finish*/
+static uint8_t mount_polls;
+
+static cli_async_state_t SDC_mount_step(cli_async_t *op, void * _context)
+{
+	UNUSED_PARAMETER(op);
+	UNUSED_PARAMETER(_context);
+	if(mount_polls)
+	{
+		mount_polls--;
+		return CLI_ASYNC_PENDING;
+	}
+	return CLI_ASYNC_DONE;
+}
+
+static void SDC_mount_done(cli_async_t *op, bool result, void * _context)
+{
+	CliWriteStr(_context,"Mount #");
+	CliWriteUint(_context,op->handle);
+	CliWriteStr(_context,result?" success\n":" failed\n");
+}
+
+/**
+ * @brief Same as mountsd, but returns at once. Mount result is written by completion
+ * callback when PollCliAsync() finds the operation finished
+ */
+bool mountSD_async_cmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	UNUSED_PARAMETER(self);
+	if(argv[0])
+	{
+		CliWriteStr(_context,"Command doesn't have arguments\n");
+		return false;
+	}
+	if(BeginCliAsync(_context,SDC_mount_step,SDC_mount_done,NULL)==NULL)
+	{
+		CliWriteStr(_context,"Busy\n");
+		return false;
+	}
+	mount_polls=2;
+	return true;
+}
+
 void initSimpleCliSet(void)
 {
-	/* First command*/
-	Context_t s_f_context;
-	s_f_context.context_handler=sendfile_context_handler;
-	cli_command_t sendfile=
-    {
-        .cmd_name = "sendfile",
-        .args_num = 3,
-        .args = {   {.arg_name="-n", .arg_type=ARG_INT32    }, 				// args[0]
-                    {.arg_name="-o", .arg_type=ARG_ONLY     }, 				// args[1]
-                    {.arg_name="-f", .arg_type=ARG_STRING, .value=NULL   }  // args[2]
-                },
-        .c_func = sendfile_cmd,
-        .cmd_info = "Sends file over UART",
-        .cmd_ID= 0x01,
-		.cmd_context = s_f_context					/*Command with context handler*/
-    };
-    AddNewCommand(sendfile);
-    
-	/*Second command*/
-    cli_command_t mountSD =
-    {
-        .cmd_name = "mountsd",
-        .args_num = 0,
-        .c_func = mountSD_cmd,
-        .cmd_info = "Initializes SD card interface",
-        .cmd_ID= 0x02,
-		.cmd_context={{0}}					/*Command without context handler. Double brackets for GCC compiler (GCC bug # 53119)  */
-    };
-    AddNewCommand(mountSD);
+	/*Commands are described in cli_commands.txt. Const table with lookup index is generated at build time,
+	so nothing is copied to RAM. Commands added by AddNewCommand() extend it*/
+	SetRegistryTable(NULL,&SimpleCliCommands);
 }
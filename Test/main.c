@@ -10,21 +10,18 @@ from command content handler function. For example it could be code that sends
 data over TX pin of UART interface */
 uint32_t StdOutWrite(const char* data, size_t length)
 {
-	for(size_t i=0;i<length;++i)
-        printf("%c", data[i]);
-	return 0;
+	return (uint32_t)fwrite(data,1,length,stdout);
 }
 
 /*Highest level context handler. Starts command parse sequence.*/
 bool MainContextHandler(char *data, size_t length, void * _context)
 {
-	const char unknown_cmd[]="Command unknown\n";
     ((void)(length));
-	int8_t com_res=ProcessCommand(data,(SimpleCliContext_t*)_context);
+	int8_t com_res=ProcessCommand(data,(CliContextManager_t*)_context);
 	printf("Command : #%d\n",com_res);
 	if(!com_res)
     {
-        StdOutWrite(unknown_cmd, sizeof(unknown_cmd));
+        CliWriteStr((CliContextManager_t*)_context, "Command unknown\n");
         return false;
     } 						
 	return true;
@@ -36,12 +33,16 @@ int main()
     InitCLIcontext(&MainC,MainContextHandler,StdOutWrite,"Main_context");
     /*Initializing commands set*/
     initSimpleCliSet();
+#if (SIMCLI_USE_STATS==1)
+    AddStatsCommand(NULL,0x10);
+#endif
 
     char str1[]="sendfile -n 10 -o -f feriX1.tct\r\n";
     char str2[]="sendfile -n 100";
     char str3[]="mountsd";
     char str4[]="mount_sd";
     char str5[]="sendfile -f -n 100";
+    char str6[]="sendfile -f very_long_file_name_that_does_not_fit.txt";
 
     bool ret_res;
     printf("\nString 1= %s\n",str1);
@@ -72,5 +73,51 @@ int main()
     if(!ret_res)
         printf("Command unknown\n");
 
+    printf("\nString 6= %s\n",str6);
+    CallContextHandler(&MainC,str6,strlen(str6));   //Command received
+
+    /*Input stream split into arbitrary chunks*/
+    char chunk1[]="mou";
+    char chunk2[]="ntsd\r\nsendfile -n 5\r\n01234mountsd\n";
+    printf("\nStream = %s%s\n",chunk1,chunk2);
+    FeedContextHandler(&MainC,chunk1,strlen(chunk1));
+    FeedContextHandler(&MainC,chunk2,strlen(chunk2));
+
+    /*Bulk transfer of DMA ring buffer region that wraps around buffer end*/
+    char ring[16]="89ABCDEF01234567";
+    char cmd[]="sendfile -n 16";
+    printf("\nBulk = %s\n",cmd);
+    CallContextHandler(&MainC,cmd,strlen(cmd));
+    cli_data_view_t view={{&ring[8],&ring[0]},{8,8}};
+    CallContextBulk(&MainC,&view);
+
+    /*Batch of commands with data flow inside*/
+    char batch[]="mountsd\nsendfile -n 4\nABCDmountsd\r\nmount_sd\n";
+    int8_t results[8];
+    printf("\nBatch = %s\n",batch);
+    size_t num=ProcessCommandBatch(&MainC,batch,strlen(batch),results,8);
+    for(size_t i=0;i<num;++i)
+        printf("Command %u : #%d\n",(unsigned)i,results[i]);
+
+    /*Pipeline: response of mountsd is passed to sendfile data context instead of the output*/
+    char pipe_cmd[]="mountsd | sendfile -n 14";
+    printf("\nPipe = %s\n",pipe_cmd);
+    CallContextHandler(&MainC,pipe_cmd,strlen(pipe_cmd));
+
+    /*Asynchronous command. Input is processed while mount is in progress*/
+    char async_cmd[]="mountbg";
+    printf("\nAsync = %s\n",async_cmd);
+    CallContextHandler(&MainC,async_cmd,strlen(async_cmd));
+    printf("Pending operation #%u\n",GetCliAsyncHandle(&MainC));
+    CallContextHandler(&MainC,str3,strlen(str3));
+    while(PollCliAsync(&MainC))             /*Main loop*/
+        printf("Polled\n");
+
+#if (SIMCLI_USE_STATS==1)
+    char stats_cmd[]="stats";
+    printf("\nStats = %s\n",stats_cmd);
+    CallContextHandler(&MainC,stats_cmd,strlen(stats_cmd));
+#endif
+
     return 0;
 }
\ No newline at end of file
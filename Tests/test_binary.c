@@ -0,0 +1,262 @@
+/*
+ * test_binary.c
+ *
+ * Description: Binary command frames: CRC-16, TLV arguments and response frames, frames with bad
+ *              CRC or length, frames split between input chunks, sync byte inside text lines and
+ *              resync after a frame longer than SIMCLI_MAX_CMD_LEN.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "test_util.h"
+
+#define SET_ID 				1
+#define ECHO_ID 			2
+#define FRAME_SIZE 			64
+
+#if (SIMCLI_USE_BINARY==1)
+static uint32_t Number;
+static char Text[16];
+static unsigned SetCalls;
+
+typedef struct
+{
+	uint8_t 	cmd_ID;
+	uint8_t 	status;
+	size_t 		data_len;
+	size_t 		size;								/*Frame size, 0 - no valid frame*/
+	char 		data[FRAME_SIZE];
+}response_t;
+
+static bool SetCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	SetCalls++;
+	self->args[0].value=&Number;
+	self->args[1].value=Text;
+	if(ParseCmdArgs(argv,self)!=SIM_CLI_OK)
+		return false;
+	CliWriteStr(_context,Text);
+	return Number!=0;
+}
+
+static bool EchoCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(self);
+	for(size_t i=0;argv[i];++i)
+		CliWriteStr(_context,argv[i]);
+	return true;
+}
+
+static bool RunLine(char *data, size_t length, void * _context)
+{
+	(void)(length);
+	return ProcessCommand(data,_context)!=0;
+}
+
+static void Setup(void)
+{
+	const cli_command_t commands[]=
+	{
+		{
+			.cmd_name="set", .c_func=SetCmd, .cmd_ID=SET_ID, .args_num=2,
+			.args={{.arg_name="-n", .arg_type=ARG_UINT32},{.arg_name="-s", .arg_type=ARG_STRING, .value_size=sizeof(Text)}}
+		},
+		{.cmd_name="echo", .c_func=EchoCmd, .cmd_ID=ECHO_ID},
+	};
+	SetupSession(commands,sizeof(commands)/sizeof(commands[0]));
+	Session.contextOwner->context_handler=RunLine;
+}
+
+/*Request frame of set command*/
+static size_t BuildSet(uint8_t *frame, uint32_t number, const char *text)
+{
+	cli_frame_writer_t writer;
+	TEST_CHECK(CliFrameBegin(&writer,frame,FRAME_SIZE,SET_ID));
+	TEST_CHECK(CliFrameArg(&writer,1,&number,sizeof(number)));
+	TEST_CHECK(CliFrameArg(&writer,2,text,(uint8_t)strlen(text)));
+	return CliFrameEnd(&writer);
+}
+
+/*Parses response frame at Output[offset], checks its CRC*/
+static response_t Response(size_t offset)
+{
+	response_t resp={0};
+	const uint8_t *frame=(const uint8_t*)&Output[offset];
+	if((OutputLen<offset+SIMCLI_BIN_OVERHEAD+2)||(frame[0]!=SIMCLI_BIN_SYNC))
+		return resp;
+	size_t payload=(size_t)frame[1]|((size_t)frame[2]<<8);
+	size_t size=payload+SIMCLI_BIN_OVERHEAD;
+	if((payload<2)||(offset+size>OutputLen)||(payload-2>sizeof(resp.data)))
+		return resp;
+	if(CliCrc16(&frame[1],size-3,0xFFFF)!=(uint16_t)(frame[size-2]|(frame[size-1]<<8)))
+		return resp;
+	resp.cmd_ID=frame[SIMCLI_BIN_HEADER];
+	resp.status=frame[SIMCLI_BIN_HEADER+1];
+	resp.data_len=payload-2;
+	memcpy(resp.data,&frame[SIMCLI_BIN_HEADER+2],resp.data_len);
+	resp.size=size;
+	return resp;
+}
+
+static void TestCrc(void)
+{
+	TEST_CHECK(CliCrc16((const uint8_t*)"123456789",9,0xFFFF)==0x29B1);	/*CRC-16/CCITT-FALSE check value*/
+	TEST_CHECK(CliCrc16((const uint8_t*)"56789",5,CliCrc16((const uint8_t*)"1234",4,0xFFFF))==0x29B1);
+	TEST_CHECK(CliCrc16(NULL,0,0xFFFF)==0xFFFF);
+}
+
+static void TestFrame(void)
+{
+	uint8_t frame[FRAME_SIZE];
+	size_t size=BuildSet(frame,77,"abc");
+	TEST_CHECK(size==SIMCLI_BIN_OVERHEAD+1+(2+4)+(2+3));
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==SET_ID);
+	TEST_CHECK((Number==77)&&(strcmp(Text,"abc")==0));
+	response_t resp=Response(0);
+	TEST_CHECK((resp.size==OutputLen)&&(resp.cmd_ID==SET_ID)&&(resp.status==CLI_BIN_OK));
+	TEST_CHECK((resp.data_len==3)&&(memcmp(resp.data,"abc",3)==0));
+
+	size=BuildSet(frame,0,"x");										/*Command returns false*/
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	resp=Response(0);
+	TEST_CHECK((resp.status==CLI_BIN_FAILED)&&(resp.data_len==1));
+
+	cli_frame_writer_t writer;
+	TEST_CHECK(CliFrameBegin(&writer,frame,sizeof(frame),0x7E));
+	size=CliFrameEnd(&writer);
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	resp=Response(0);
+	TEST_CHECK((resp.cmd_ID==0x7E)&&(resp.status==CLI_BIN_UNKNOWN_CMD));
+	TEST_CHECK(Session.context_level==0);
+}
+
+static void TestBadFrame(void)
+{
+	uint8_t frame[FRAME_SIZE];
+	size_t size=BuildSet(frame,5,"bad");
+	unsigned calls=SetCalls;
+	frame[SIMCLI_BIN_HEADER+3]^=0x01;									/*Value byte changed*/
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	TEST_CHECK(Response(0).status==CLI_BIN_BAD_FRAME);
+	frame[SIMCLI_BIN_HEADER+3]^=0x01;
+	frame[size-1]^=0x80;												/*CRC changed*/
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	TEST_CHECK(Response(0).status==CLI_BIN_BAD_FRAME);
+	frame[size-1]^=0x80;
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size-1,&Session)==0);			/*Truncated: shorter than its length field*/
+	TEST_CHECK(Response(0).status==CLI_BIN_BAD_FRAME);
+	frame[1]++;															/*Length field longer than the frame*/
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	TEST_CHECK(Response(0).status==CLI_BIN_BAD_FRAME);
+	frame[1]--;
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,SIMCLI_BIN_OVERHEAD,&Session)==0);	/*No room for cmd_ID*/
+	TEST_CHECK(OutputLen==0);
+
+	/*TLV value longer than the payload left*/
+	cli_frame_writer_t writer;
+	uint32_t number=1;
+	TEST_CHECK(CliFrameBegin(&writer,frame,sizeof(frame),SET_ID));
+	TEST_CHECK(CliFrameArg(&writer,1,&number,sizeof(number)));
+	frame[SIMCLI_BIN_HEADER+2]=8;
+	size=CliFrameEnd(&writer);
+	ClearOutput();
+	TEST_CHECK(ProcessCommandFrame(frame,size,&Session)==0);
+	TEST_CHECK(Response(0).status==CLI_BIN_FAILED);
+	TEST_CHECK(SetCalls==calls+1);
+}
+
+/*Frame split between input chunks, text lines around it*/
+static void TestFeedSplit(void)
+{
+	char input[FRAME_SIZE+32];
+	size_t length=0;
+	memcpy(input,"echo one\r\n",10);
+	length+=10;
+	length+=BuildSet((uint8_t*)&input[length],9,"split");
+	memcpy(&input[length],"echo two\n",9);
+	length+=9;
+	for(size_t chunk=1;chunk<=length;chunk+=(chunk<4)?1:7)
+	{
+		char work[sizeof(input)];
+		memcpy(work,input,length);									/*Framer writes line terminators in place*/
+		Number=0;
+		ClearOutput();
+		for(size_t pos=0;pos<length;pos+=chunk)
+			FeedContextHandler(&Session,&work[pos],(length-pos<chunk)?length-pos:chunk);
+		TEST_CHECK(strncmp(Output,"one",3)==0);
+		response_t resp=Response(3);
+		TEST_CHECK((resp.status==CLI_BIN_OK)&&(resp.data_len==5)&&(memcmp(resp.data,"split",5)==0));
+		TEST_CHECK(Number==9);
+		TEST_CHECK((OutputLen==3+resp.size+3)&&(strcmp(&Output[3+resp.size],"two")==0));
+	}
+	TEST_CHECK(Session.LineFramer.length==0);
+}
+
+/*Sync byte starts a frame only at a line start*/
+static void TestSyncInLine(void)
+{
+	char input[]="echo a\xA5z \xA5\n";
+	ClearOutput();
+	TEST_CHECK(FeedContextHandler(&Session,input,sizeof(input)-1));
+	TEST_CHECK(strcmp(Output,"a\xA5z\xA5")==0);
+	char split[]="echo b";
+	char rest[]="\xA5y\n";
+	ClearOutput();
+	FeedContextHandler(&Session,split,sizeof(split)-1);
+	FeedContextHandler(&Session,rest,sizeof(rest)-1);					/*Chunk starts inside unfinished line*/
+	TEST_CHECK(strcmp(Output,"b\xA5y")==0);
+	TEST_CHECK(!Session.LineFramer.binary);
+}
+
+/*Frame longer than SIMCLI_MAX_CMD_LEN is answered with CLI_BIN_TOO_LONG and skipped to its end*/
+static void TestResync(void)
+{
+	size_t size=SIMCLI_MAX_CMD_LEN+100;
+	size_t payload=size-SIMCLI_BIN_OVERHEAD;
+	char header[SIMCLI_BIN_HEADER]={(char)SIMCLI_BIN_SYNC,(char)(uint8_t)payload,(char)(uint8_t)(payload>>8)};
+	ClearOutput();
+	FeedContextHandler(&Session,header,1);
+	FeedContextHandler(&Session,&header[1],2);
+	TEST_CHECK(Response(0).status==CLI_BIN_TOO_LONG);
+	unsigned calls=SetCalls;
+	size_t rest=size-SIMCLI_BIN_HEADER;
+	char body[37];
+	for(size_t i=0;i<sizeof(body);++i)
+		body[i]=(i%3)?'\n':(char)SIMCLI_BIN_SYNC;						/*Line endings and sync bytes are skipped too*/
+	while(rest)
+	{
+		size_t chunk=(rest<sizeof(body))?rest:sizeof(body);
+		TEST_CHECK(Session.LineFramer.frame_skip==rest);
+		FeedContextHandler(&Session,body,chunk);
+		rest-=chunk;
+	}
+	TEST_CHECK(Session.LineFramer.frame_skip==0);
+	TEST_CHECK(SetCalls==calls);
+	char line[]="echo again\n";
+	ClearOutput();
+	FeedContextHandler(&Session,line,sizeof(line)-1);
+	TEST_CHECK(strcmp(Output,"again")==0);
+}
+
+#endif
+
+int main(void)
+{
+#if (SIMCLI_USE_BINARY==1)												/*Nothing to test without binary frames*/
+	Setup();
+	TestCrc();
+	TestFrame();
+	TestBadFrame();
+	TestFeedSplit();
+	TestSyncInLine();
+	TestResync();
+#endif
+	return TEST_RESULT();
+}
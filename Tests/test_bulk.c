@@ -0,0 +1,126 @@
+/*
+ * test_bulk.c
+ *
+ * Description: Bulk data path: bulk handler result is cut to the lent region, handler that takes
+ *              nothing stops FeedContextInput() and the caller feeds the rest again, command lines
+ *              after the payload are run. Contexts with bulk handler only ignore line data.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "test_util.h"
+
+#define RECV_ID 			1
+#define ECHO_ID 			2
+
+static size_t Expected;										/*Payload size of recv command*/
+static size_t Received;
+static size_t Budget;										/*Bytes the handler takes in the next call*/
+static size_t Extra;										/*Added to the result of the handler*/
+
+static size_t RecvBulk(const cli_data_view_t *view, bool *complete, void * _context)
+{
+	(void)(_context);
+	size_t length=view->length[0]+view->length[1];
+	if(length>Expected-Received)
+		length=Expected-Received;
+	if(length>Budget)
+		length=Budget;
+	Budget-=length;
+	Received+=length;
+	*complete=(Received==Expected);
+	return length?length+Extra:0;
+}
+
+static bool RecvCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(argv);
+	Received=0;
+	return AcquireContext(_context,&self->cmd_context);
+}
+
+static bool EchoCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(self);
+	for(size_t i=0;argv[i];++i)
+		CliWriteStr(_context,argv[i]);
+	return true;
+}
+
+static bool RunLine(char *data, size_t length, void * _context)
+{
+	(void)(length);
+	return ProcessCommand(data,_context)!=0;
+}
+
+static void Setup(void)
+{
+	const cli_command_t commands[]=
+	{
+		{.cmd_name="recv", .c_func=RecvCmd, .cmd_ID=RECV_ID, .cmd_context={.Name="recv", .bulk_handler=RecvBulk}},
+		{.cmd_name="echo", .c_func=EchoCmd, .cmd_ID=ECHO_ID},
+	};
+	SetupSession(commands,sizeof(commands)/sizeof(commands[0]));
+	Session.contextOwner->context_handler=RunLine;
+}
+
+/*Handler that reports more than it was lent does not move input past the region*/
+static void TestClamp(void)
+{
+	char input[]="recv\n0123456789";
+	Expected=10;
+	Budget=(size_t)-1;
+	Extra=1000;
+	TEST_CHECK(FeedContextInput(&Session,input,sizeof(input)-1)==sizeof(input)-1);
+	TEST_CHECK(Received==10);
+	TEST_CHECK(Session.context_level==0);
+	char line[]="echo done\n";
+	ClearOutput();
+	TEST_CHECK(FeedContextInput(&Session,line,sizeof(line)-1)==sizeof(line)-1);
+	TEST_CHECK(strcmp(Output,"done")==0);
+
+	char view_data[4]="abcd";
+	Expected=2;
+	Extra=50;
+	TEST_CHECK(ProcessCommand("recv",&Session)==RECV_ID);
+	cli_data_view_t view={{view_data,NULL},{sizeof(view_data),0}};
+	TEST_CHECK(CallContextBulk(&Session,&view)==sizeof(view_data));	/*2 taken, result cut to the view*/
+	TEST_CHECK(Session.context_level==0);
+	Extra=0;
+}
+
+/*Handler that takes nothing keeps the rest of the chunk with the caller*/
+static void TestStall(void)
+{
+	char input[]="recv\n0123456789echo after\n";
+	size_t length=sizeof(input)-1;
+	Expected=10;
+	Budget=4;
+	ClearOutput();
+	size_t taken=FeedContextInput(&Session,input,length);
+	TEST_CHECK(taken==5+4);
+	TEST_CHECK((Received==4)&&(Session.context_level==1));
+	TEST_CHECK(FeedContextInput(&Session,&input[taken],length-taken)==0);
+	Budget=3;
+	taken+=FeedContextInput(&Session,&input[taken],length-taken);
+	TEST_CHECK(taken==5+7);
+	TEST_CHECK(OutputLen==0);
+	Budget=100;
+	taken+=FeedContextInput(&Session,&input[taken],length-taken);
+	TEST_CHECK(taken==length);
+	TEST_CHECK((Received==10)&&(Session.context_level==0));
+	TEST_CHECK(strcmp(Output,"after")==0);
+
+	char again[]="recv\n01234";									/*FeedContextHandler() reports the stall*/
+	Budget=2;
+	TEST_CHECK(!FeedContextHandler(&Session,again,sizeof(again)-1));
+	TEST_CHECK(Received==2);
+	TEST_CHECK(ReleaseContext(&Session));
+}
+
+int main(void)
+{
+	Setup();
+	TestClamp();
+	TestStall();
+	return TEST_RESULT();
+}
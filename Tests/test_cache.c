@@ -0,0 +1,196 @@
+/*
+ * test_cache.c
+ *
+ * Description: Response cache (built with SIMCLI_CACHE_SLOTS=2): hit, miss, InvalidateCliCache(),
+ *              cache_version and cache_ttl expiry. Failed commands and responses that don't fit
+ *              don't evict stored responses. Abbreviated argument names share the key of full ones,
+ *              hits are counted in statistics.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "time.h"
+#include "test_util.h"
+#include "simple_cli_trie.h"
+
+#define QUERY_ID 			1
+#define STATUS_ID 			2
+#define SHORT_ID 			3
+#define FAIL_ID 			4
+#define LONG_ID 			5
+#define ARGS_ID 			6
+#define SHORT_TTL_MS 		30
+
+#if (SIMCLI_CACHE_SLOTS!=2)
+	#error "Test expects SIMCLI_CACHE_SLOTS=2"
+#endif
+
+static unsigned Calls;												/*Command function calls of all commands*/
+static uint32_t Version;
+static cli_trie_t Trie;
+
+/*Response: command name, its arguments and call number*/
+static bool QueryCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	CliWriteStr(_context,self->cmd_name);
+	for(size_t i=0;argv[i];++i)
+	{
+		CliWriteStr(_context," ");
+		CliWriteStr(_context,argv[i]);
+	}
+	CliWriteStr(_context," #");
+	CliWriteUint(_context,++Calls);
+	return true;
+}
+
+static bool FailCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	QueryCmd(argv,self,_context);
+	return false;
+}
+
+static bool LongCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(argv);
+	(void)(self);
+	Calls++;
+	for(size_t i=0;i<=SIMCLI_CACHE_DATA_SIZE/8;++i)
+		CliWriteStr(_context,"12345678");
+	return true;
+}
+
+static void Setup(void)
+{
+	const cli_command_t commands[]=
+	{
+		{.cmd_name="query", .c_func=QueryCmd, .cmd_ID=QUERY_ID, .cache_ttl=60000},
+		{.cmd_name="status", .c_func=QueryCmd, .cmd_ID=STATUS_ID, .cache_version=&Version},
+		{.cmd_name="short", .c_func=QueryCmd, .cmd_ID=SHORT_ID, .cache_ttl=SHORT_TTL_MS},
+		{.cmd_name="fail", .c_func=FailCmd, .cmd_ID=FAIL_ID, .cache_ttl=60000},
+		{.cmd_name="long", .c_func=LongCmd, .cmd_ID=LONG_ID, .cache_ttl=60000},
+		{
+			.cmd_name="args", .c_func=QueryCmd, .cmd_ID=ARGS_ID, .cache_ttl=60000, .args_num=3,
+			.args={{.arg_name="-verbose", .arg_type=ARG_UINT32},{.arg_name="-all", .arg_type=ARG_ONLY},{.arg_name="-name", .arg_type=ARG_STRING}}
+		},
+	};
+	SetupSession(commands,sizeof(commands)/sizeof(commands[0]));
+	TEST_CHECK(BuildCliTrie(&Trie,&Registry));
+}
+
+/*Runs line, returns true when command function was not called. Response is in Output*/
+static bool Cached(const char* line, int8_t id)
+{
+	unsigned calls=Calls;
+	ClearOutput();
+	TEST_CHECK(ProcessCommand(line,&Session)==id);
+	return Calls==calls;
+}
+
+static void TestHitMiss(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	TEST_CHECK(!Cached("query -a 1",QUERY_ID));
+	TEST_CHECK(strcmp(Output,"query -a 1 #1")==0);
+	TEST_CHECK(Cached("query  -a   1",QUERY_ID));					/*Same normalized arguments*/
+	TEST_CHECK(strcmp(Output,"query -a 1 #1")==0);
+	TEST_CHECK(!Cached("query -a 2",QUERY_ID));						/*Other arguments*/
+	TEST_CHECK(strcmp(Output,"query -a 2 #2")==0);
+	TEST_CHECK(Cached("query -a 1",QUERY_ID));
+	TEST_CHECK(strcmp(Output,"query -a 1 #1")==0);
+	TEST_CHECK(Session.CacheFill==NULL);
+}
+
+static void TestInvalidate(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	TEST_CHECK(!Cached("query",QUERY_ID));
+	TEST_CHECK(!Cached("status",STATUS_ID));
+	InvalidateCliCache(&Session,"status");							/*Other command keeps its response*/
+	TEST_CHECK(Cached("query",QUERY_ID));
+	TEST_CHECK(!Cached("status",STATUS_ID));
+	TEST_CHECK(Cached("status",STATUS_ID));
+	Version++;														/*Shown state changed*/
+	TEST_CHECK(!Cached("status",STATUS_ID));
+	TEST_CHECK(Cached("status",STATUS_ID));
+	InvalidateCliCache(NULL,NULL);									/*All sessions*/
+	TEST_CHECK(!Cached("query",QUERY_ID));
+	TEST_CHECK(!Cached("status",STATUS_ID));
+}
+
+static void TestExpiry(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	TEST_CHECK(!Cached("short",SHORT_ID));
+	TEST_CHECK(!Cached("query",QUERY_ID));
+	struct timespec ts={0,2*SHORT_TTL_MS*1000000L};
+	nanosleep(&ts,NULL);
+	TEST_CHECK(!Cached("short",SHORT_ID));							/*Expired*/
+	TEST_CHECK(Cached("query",QUERY_ID));
+}
+
+/*Both slots are taken. Responses that are not stored must not evict them*/
+static void TestNoEviction(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	TEST_CHECK(!Cached("query -a 1",QUERY_ID));
+	TEST_CHECK(!Cached("query -a 2",QUERY_ID));
+	TEST_CHECK(ProcessCommand("fail",&Session)==0);
+	TEST_CHECK(ProcessCommand("fail",&Session)==0);
+	TEST_CHECK(!Cached("fail",0));							/*Failed response is not stored*/
+	TEST_CHECK(!Cached("long",LONG_ID));
+	TEST_CHECK(!Cached("long",LONG_ID));							/*Response longer than SIMCLI_CACHE_DATA_SIZE*/
+	TEST_CHECK(OutputLen>SIMCLI_CACHE_DATA_SIZE);
+	TEST_CHECK(!Cached("query -a x -b y -c z -d 0123456789abcdef",QUERY_ID));	/*Key longer than SIMCLI_CACHE_KEY_SIZE*/
+	TEST_CHECK(Cached("query -a 1",QUERY_ID));
+	TEST_CHECK(Cached("query -a 2",QUERY_ID));
+	TEST_CHECK(!Cached("query -a 3",QUERY_ID));						/*Stored response evicts the least recently used one*/
+	TEST_CHECK(Cached("query -a 3",QUERY_ID));
+	TEST_CHECK(Cached("query -a 2",QUERY_ID));
+	TEST_CHECK(!Cached("query -a 1",QUERY_ID));
+}
+
+/*Key holds full argument names, values are not expanded*/
+static void TestArgPrefix(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	AttachCliTrie(&Session,&Trie);
+	TEST_CHECK(!Cached("args -verbose 1",ARGS_ID));
+	TEST_CHECK(Cached("args -v 1",ARGS_ID));
+	TEST_CHECK(Cached("args -verb 1",ARGS_ID));
+	TEST_CHECK(strncmp(Output,"args -verbose 1 #",17)==0);			/*Stored response of the first query*/
+	TEST_CHECK(!Cached("args -a -n -v",ARGS_ID));
+	TEST_CHECK(Cached("args -all -name -v",ARGS_ID));
+	TEST_CHECK(!Cached("args -a -n -verbose",ARGS_ID));				/*Value that looks like a name*/
+	AttachCliTrie(&Session,NULL);
+	TEST_CHECK(!Cached("args -verbose 1",ARGS_ID));
+	TEST_CHECK(!Cached("args -v 1",ARGS_ID));						/*Without tree -v is not an argument name*/
+	TEST_CHECK(Cached("args -verbose 1",ARGS_ID));
+}
+
+#if (SIMCLI_USE_STATS==1)
+static cli_stats_t Stats;
+
+static void TestStats(void)
+{
+	InvalidateCliCache(&Session,NULL);
+	ResetCliStats();
+	TEST_CHECK(!Cached("query",QUERY_ID));
+	TEST_CHECK(Cached("query",QUERY_ID));
+	TEST_CHECK(Cached("query",QUERY_ID));
+	TEST_CHECK(GetCliStats(&Stats));
+	TEST_CHECK((Stats.cmd[QUERY_ID].calls==1)&&(Stats.cmd[QUERY_ID].cache_hits==2));
+}
+#endif
+
+int main(void)
+{
+	Setup();
+	TestHitMiss();
+	TestInvalidate();
+	TestExpiry();
+	TestNoEviction();
+	TestArgPrefix();
+#if (SIMCLI_USE_STATS==1)
+	TestStats();
+#endif
+	return TEST_RESULT();
+}
@@ -0,0 +1,164 @@
+/*
+ * test_pipeline.c
+ *
+ * Description: Command pipelines: quoted and escaped '|' is a part of argument, not a separator.
+ *              Inner stage that releases its context early is detached, other stages keep running.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "test_util.h"
+
+#define ECHO_ID 			1
+#define CAT_ID 				2
+#define WORDS_ID 			3
+#define ONCE_ID 			4
+#define MAX_WORDS 			4
+
+static uint32_t Accepted[MAX_WORDS];							/*Returned by CliWrite() of words command*/
+static unsigned CatEnds;											/*End of stream calls*/
+static unsigned OnceCalls;
+static unsigned OnceEnds;
+
+/*Writes arguments separated by spaces*/
+static bool EchoCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(self);
+	for(size_t i=0;argv[i];++i)
+	{
+		if(i)
+			CliWriteStr(_context," ");
+		CliWriteStr(_context,argv[i]);
+	}
+	return true;
+}
+
+/*Stage that passes data through*/
+static bool CatHandler(char *data, size_t length, void * _context)
+{
+	if(length==0)
+		CatEnds++;
+	return CliWrite(_context,data,length)==length;
+}
+
+static bool CatCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(argv);
+	(void)(self);
+	static Context_t cat_context={.Name="cat", .context_handler=CatHandler};
+	return AcquireContext(_context,&cat_context);
+}
+
+/*Writes each argument with own CliWrite() call*/
+static bool WordsCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(self);
+	for(size_t i=0;argv[i]&&(i<MAX_WORDS);++i)
+		Accepted[i]=CliWriteStr(_context,argv[i]);
+	return true;
+}
+
+/*Stage that takes the first chunk only*/
+static bool OnceHandler(char *data, size_t length, void * _context)
+{
+	if(length==0)
+	{
+		OnceEnds++;
+		return true;
+	}
+	OnceCalls++;
+	CliWrite(_context,data,length);
+	return ReleaseContext(_context);
+}
+
+static bool OnceCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(argv);
+	(void)(self);
+	static Context_t once_context={.Name="once", .context_handler=OnceHandler};
+	return AcquireContext(_context,&once_context);
+}
+
+static void Setup(void)
+{
+	const cli_command_t commands[]=
+	{
+		{.cmd_name="echo", .c_func=EchoCmd, .cmd_ID=ECHO_ID},
+		{.cmd_name="cat", .c_func=CatCmd, .cmd_ID=CAT_ID},
+		{.cmd_name="words", .c_func=WordsCmd, .cmd_ID=WORDS_ID},
+		{.cmd_name="once", .c_func=OnceCmd, .cmd_ID=ONCE_ID},
+	};
+	SetupSession(commands,sizeof(commands)/sizeof(commands[0]));
+}
+
+/*Runs line, returns command result, output is in Output*/
+static int8_t Run(const char* line)
+{
+	ClearOutput();
+	return ProcessCommand(line,&Session);
+}
+
+static void TestQuotedPipe(void)
+{
+	TEST_CHECK(Run("echo \"a | b\" c")==ECHO_ID);
+	TEST_CHECK(strcmp(Output,"a | b c")==0);
+	TEST_CHECK(Run("echo 'x|' '|' \"|\"")==ECHO_ID);
+	TEST_CHECK(strcmp(Output,"x| | |")==0);
+	TEST_CHECK(Run("echo \"q\\\" | \" z")==ECHO_ID);				/*Escaped quote does not end quoted part*/
+	TEST_CHECK(strcmp(Output,"q\" |  z")==0);
+	TEST_CHECK(Session.context_level==0);
+}
+
+static void TestEscapedPipe(void)
+{
+	TEST_CHECK(Run("echo a \\| b")==ECHO_ID);
+	TEST_CHECK(strcmp(Output,"a | b")==0);
+	TEST_CHECK(Session.context_level==0);
+}
+
+static void TestPipeAfterQuotes(void)
+{
+	TEST_CHECK(Run("echo \"a | b\" c | cat")==ECHO_ID);
+	TEST_CHECK(strcmp(Output,"a | b c")==0);
+	TEST_CHECK(Run("echo a\\ \\| | cat | cat")==ECHO_ID);
+	TEST_CHECK(strcmp(Output,"a |")==0);
+	TEST_CHECK(Session.context_level==0);
+}
+
+/*Lowest stage releases on its first data: it is detached, the stage above keeps running*/
+static void TestInnerRelease(void)
+{
+	memset(Accepted,0,sizeof(Accepted));
+	CatEnds=OnceCalls=OnceEnds=0;
+	TEST_CHECK(Run("words hi there | cat | once")==WORDS_ID);
+	TEST_CHECK(strcmp(Output,"hi")==0);
+	TEST_CHECK((Accepted[0]==2)&&(Accepted[1]==0));				/*Detached stage takes no more data*/
+	TEST_CHECK((OnceCalls==1)&&(OnceEnds==0));
+	TEST_CHECK(CatEnds==1);
+	TEST_CHECK(Session.context_level==0);
+}
+
+/*Middle stage releases: output of the writer stops there, lower stage still gets end of stream*/
+static void TestMiddleRelease(void)
+{
+	memset(Accepted,0,sizeof(Accepted));
+	CatEnds=OnceCalls=OnceEnds=0;
+	TEST_CHECK(Run("words a b c | once | cat")==WORDS_ID);
+	TEST_CHECK(strcmp(Output,"a")==0);
+	TEST_CHECK((Accepted[0]==1)&&(Accepted[1]==0)&&(Accepted[2]==0));
+	TEST_CHECK((OnceCalls==1)&&(OnceEnds==0));
+	TEST_CHECK(CatEnds==1);
+	TEST_CHECK(Session.context_level==0);
+	TEST_CHECK(Run("echo ok")==ECHO_ID);							/*Session is usable after pipeline*/
+	TEST_CHECK(strcmp(Output,"ok")==0);
+}
+
+int main(void)
+{
+	Setup();
+	TestQuotedPipe();
+	TestEscapedPipe();
+	TestPipeAfterQuotes();
+	TestInnerRelease();
+	TestMiddleRelease();
+	return TEST_RESULT();
+}
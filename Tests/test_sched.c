@@ -0,0 +1,151 @@
+/*
+ * test_sched.c
+ *
+ * Description: Session scheduler over socketpairs: several sessions are served by a pool of workers,
+ *              lines of each session are executed in order and by one worker at a time, session
+ *              counters match the sent input.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdlib.h"
+#include "stdio.h"
+#include "time.h"
+#include "unistd.h"
+#include "sys/socket.h"
+#include "simple_cli_sched.h"
+#include "test_util.h"
+
+#define NUM_SESSIONS 		8
+#define NUM_WORKERS 		3
+#define NUM_LINES 			3000							/*Lines per session*/
+#define LINES_PER_WRITE 	50								/*Lines sent to a session before switching to the next one*/
+#define WAIT_MS 			10000
+
+static Context_t Roots[NUM_SESSIONS];
+static CliContextManager_t Clis[NUM_SESSIONS];
+static cli_sched_session_t Links[NUM_SESSIONS];
+static cli_sched_t Sched;
+
+static uint32_t NextSeq[NUM_SESSIONS];							/*Expected number of the next line*/
+static uint32_t Busy[NUM_SESSIONS];								/*Session is being served by a worker*/
+static uint32_t Errors;
+static uint32_t Closed;
+
+static bool MainHandler(char *data, size_t length, void * _context)
+{
+	(void)(length);
+	if(ProcessCommand(data,_context)==0)
+	{
+		__atomic_fetch_add(&Errors,1,__ATOMIC_RELAXED);
+		return false;
+	}
+	return true;
+}
+
+/*seq <session> <number>: lines of a session must arrive to its own context manager in order*/
+static bool SeqCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(self);
+	if((argv[0]==NULL)||(argv[1]==NULL))
+		return false;
+	unsigned long session=strtoul(argv[0],NULL,10);
+	uint32_t seq=(uint32_t)strtoul(argv[1],NULL,10);
+	if((session>=NUM_SESSIONS)||(_context!=&Clis[session]))
+		return false;
+	if(__atomic_exchange_n(&Busy[session],1,__ATOMIC_ACQUIRE))		/*Another worker serves the session*/
+		__atomic_fetch_add(&Errors,1,__ATOMIC_RELAXED);
+	bool ok=(seq==NextSeq[session]);
+	NextSeq[session]=seq+1;
+	__atomic_store_n(&Busy[session],0,__ATOMIC_RELEASE);
+	return ok;
+}
+
+static void OnClose(cli_sched_session_t *session)
+{
+	close(session->fd);
+	__atomic_fetch_add(&Closed,1,__ATOMIC_RELEASE);
+}
+
+static void SleepMs(long ms)
+{
+	struct timespec ts={ms/1000,(ms%1000)*1000000L};
+	nanosleep(&ts,NULL);
+}
+
+static bool WriteAll(int fd, const char* data, size_t length)
+{
+	while(length)
+	{
+		ssize_t sent=write(fd,data,length);
+		if(sent<=0)
+			return false;
+		data+=sent;
+		length-=(size_t)sent;
+	}
+	return true;
+}
+
+int main(void)
+{
+	cli_command_t seq={.cmd_name="seq", .c_func=SeqCmd, .cmd_ID=1};
+	InitCliRegistry(&Registry);
+	AddRegistryCommand(&Registry,&seq);
+	TEST_CHECK(StartCliScheduler(&Sched,NUM_WORKERS));
+
+	int writers[NUM_SESSIONS];
+	uint64_t sent_bytes[NUM_SESSIONS]={0};
+	for(size_t i=0;i<NUM_SESSIONS;++i)
+	{
+		int pair[2];
+		TEST_CHECK(socketpair(AF_UNIX,SOCK_STREAM,0,pair)==0);
+		Clis[i].contextOwner=&Roots[i];
+		InitCLIcontext(&Clis[i],MainHandler,NullWrite,"Test");
+		AttachCliRegistry(&Clis[i],&Registry);
+		Links[i]=(cli_sched_session_t){.cli=&Clis[i], .fd=pair[0], .on_close=OnClose};
+		TEST_CHECK(AddSchedulerSession(&Sched,&Links[i]));
+		writers[i]=pair[1];
+	}
+
+	/*Sessions get input in turns, lines are split between writes. CRLF and LF endings are mixed*/
+	char buf[LINES_PER_WRITE*32];
+	for(uint32_t line=0;line<NUM_LINES;line+=LINES_PER_WRITE)
+	{
+		for(size_t i=0;i<NUM_SESSIONS;++i)
+		{
+			size_t length=0;
+			for(uint32_t n=line;(n<line+LINES_PER_WRITE)&&(n<NUM_LINES);++n)
+				length+=(size_t)snprintf(&buf[length],sizeof(buf)-length,"seq %u %u%s",(unsigned)i,(unsigned)n,(n&1)?"\r\n":"\n");
+			size_t half=length/2+i;
+			TEST_CHECK(WriteAll(writers[i],buf,half));
+			TEST_CHECK(WriteAll(writers[i],&buf[half],length-half));
+			sent_bytes[i]+=length;
+		}
+	}
+	for(size_t i=0;i<NUM_SESSIONS;++i)
+		close(writers[i]);											/*End of input closes the session*/
+
+	for(int ms=0;(__atomic_load_n(&Closed,__ATOMIC_ACQUIRE)<NUM_SESSIONS)&&(ms<WAIT_MS);++ms)
+		SleepMs(1);
+	TEST_CHECK(__atomic_load_n(&Closed,__ATOMIC_ACQUIRE)==NUM_SESSIONS);
+	TEST_CHECK(__atomic_load_n(&Sched.pending,__ATOMIC_ACQUIRE)==0);		/*Every queued session was taken*/
+	StopCliScheduler(&Sched);
+
+	TEST_CHECK(Errors==0);
+	uint64_t wakeups=0;
+	for(size_t i=0;i<NUM_SESSIONS;++i)
+	{
+		cli_session_stats_t stats;
+		GetSessionStats(&Links[i],&stats);
+		TEST_CHECK(NextSeq[i]==NUM_LINES);
+		TEST_CHECK(stats.bytes_in==sent_bytes[i]);
+		TEST_CHECK(stats.lines==NUM_LINES);
+		/*One wakeup reads at most SIMCLI_SCHED_BATCH buffers, bigger input is queued again*/
+		TEST_CHECK(stats.wakeups>=(sent_bytes[i]+SIMCLI_SCHED_BATCH*SIMCLI_SCHED_READ_SIZE-1)/(SIMCLI_SCHED_BATCH*SIMCLI_SCHED_READ_SIZE));
+		TEST_CHECK(stats.steals<=stats.wakeups);
+		TEST_CHECK(stats.latency_ns_max*stats.wakeups>=stats.latency_ns_sum);
+		TEST_CHECK(stats.busy_ns>0);
+		wakeups+=stats.wakeups;
+	}
+	TEST_CHECK(wakeups>=NUM_SESSIONS);
+	return TEST_RESULT();
+}
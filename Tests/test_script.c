@@ -0,0 +1,113 @@
+/*
+ * test_script.c
+ *
+ * Description: RunCliScript() and RunCliScriptFile(): error callback gets the first word of failed
+ *              line, also when the last line has no line ending and the script fills its buffer.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdlib.h"
+#include "unistd.h"
+#include "simple_cli_script.h"
+#include "test_util.h"
+
+#define MAX_ERRORS 			4
+
+typedef struct
+{
+	size_t 		num;
+	size_t 		offset[MAX_ERRORS];
+	char 		name[MAX_ERRORS][16];
+}errors_t;
+
+static bool OkCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(argv);
+	(void)(self);
+	(void)(_context);
+	return true;
+}
+
+static bool OnError(size_t offset, const char* cmd_name, void *user_data)
+{
+	errors_t *errors=user_data;
+	if(errors->num<MAX_ERRORS)
+	{
+		errors->offset[errors->num]=offset;
+		strncpy(errors->name[errors->num],cmd_name,sizeof(errors->name[0])-1);
+		errors->num++;
+	}
+	return true;
+}
+
+static void Setup(void)
+{
+	const cli_command_t commands[]={{.cmd_name="ok", .c_func=OkCmd, .cmd_ID=1}};
+	SetupSession(commands,1);
+}
+
+/*Script in the middle of a buffer, bytes after it are not NUL*/
+static void TestLastLine(void)
+{
+	static const char text[]="ok\n  bad1 -x\nok\nlastbad";
+	size_t length=sizeof(text)-1;
+	char *buf=malloc(length+8);
+	memcpy(buf,text,length);
+	memset(&buf[length],'X',8);
+	errors_t errors={0};
+	cli_script_report_t report;
+	TEST_CHECK(!RunCliScript(&Session,buf,length,OnError,&errors,&report));
+	TEST_CHECK(report.commands==4);
+	TEST_CHECK(report.errors==2);
+	TEST_CHECK(report.processed==length);
+	TEST_CHECK(errors.num==2);
+	TEST_CHECK((errors.offset[0]==3)&&(strcmp(errors.name[0],"bad1")==0));
+	TEST_CHECK((errors.offset[1]==16)&&(strcmp(errors.name[1],"lastbad")==0));
+	free(buf);
+}
+
+/*Script that ends exactly at the end of heap block*/
+static void TestExactBuffer(void)
+{
+	static const char text[]="ok\nvery_long_unknown_command_name";
+	char *buf=malloc(sizeof(text)-1);
+	memcpy(buf,text,sizeof(text)-1);
+	errors_t errors={0};
+	TEST_CHECK(!RunCliScript(&Session,buf,sizeof(text)-1,OnError,&errors,NULL));
+	TEST_CHECK(errors.num==1);
+	TEST_CHECK(strcmp(errors.name[0],"very_long_unkno")==0);		/*Cut to cmd_name size*/
+	free(buf);
+}
+
+/*File of page size without line ending: the mapping has no byte after the last line*/
+static void TestFile(void)
+{
+	char path[]="/tmp/simple_cli_scriptXXXXXX";
+	int fd=mkstemp(path);
+	TEST_CHECK(fd>=0);
+	if(fd<0)
+		return;
+	char text[4096];
+	for(size_t pos=0;pos<4092;pos+=3)
+		memcpy(&text[pos],"ok\n",3);
+	memcpy(&text[4092],"badx",4);
+	TEST_CHECK(write(fd,text,sizeof(text))==(ssize_t)sizeof(text));
+	close(fd);
+	errors_t errors={0};
+	cli_script_report_t report;
+	TEST_CHECK(!RunCliScriptFile(&Session,path,OnError,&errors,&report));
+	TEST_CHECK(report.commands==1365);
+	TEST_CHECK(report.errors==1);
+	TEST_CHECK(report.processed==sizeof(text));
+	TEST_CHECK((errors.num==1)&&(errors.offset[0]==4092)&&(strcmp(errors.name[0],"badx")==0));
+	unlink(path);
+}
+
+int main(void)
+{
+	Setup();
+	TestLastLine();
+	TestExactBuffer();
+	TestFile();
+	return TEST_RESULT();
+}
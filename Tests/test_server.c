@@ -0,0 +1,105 @@
+/*
+ * test_server.c
+ *
+ * Description: Session server out of descriptors: listening socket is paused instead of being
+ *              polled in a busy loop and on_accept_error is called, pending peers wait in the backlog
+ *              and are accepted later.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "stdio.h"
+#include "errno.h"
+#include "time.h"
+#include "unistd.h"
+#include "sys/resource.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "simple_cli_server.h"
+#include "test_util.h"
+
+#define NUM_CLIENTS 		4
+#define POLL_MS 			20
+#define BUSY_MS 			200							/*Time polled while accept() fails*/
+
+static cli_server_t Server;
+static unsigned AcceptErrors;
+
+static void OnAcceptError(cli_server_t *server, int error)
+{
+	TEST_CHECK((server==&Server)&&((error==EMFILE)||(error==ENFILE)));
+	AcceptErrors++;
+}
+
+static uint64_t NowMs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000ULL+(uint64_t)ts.tv_nsec/1000000ULL;
+}
+
+static int Connect(const char *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,path);
+	int fd=socket(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0);
+	if((fd>=0)&&(connect(fd,(struct sockaddr*)&addr,sizeof(addr))!=0))
+	{
+		close(fd);
+		fd=-1;
+	}
+	return fd;
+}
+
+int main(void)
+{
+	char path[64];
+	snprintf(path,sizeof(path),"/tmp/simcli_test_%d.sock",(int)getpid());
+	cli_server_config_t config={.on_accept_error=OnAcceptError};
+	TEST_CHECK(InitCliServer(&Server,&config));
+	TEST_CHECK(ListenCliServer(&Server,path));
+	int clients[NUM_CLIENTS];
+	int max_fd=Server.listen_fd;
+	for(size_t i=0;i<NUM_CLIENTS;++i)
+	{
+		clients[i]=Connect(path);										/*Wait in the backlog*/
+		TEST_CHECK(clients[i]>=0);
+		if(clients[i]>max_fd)
+			max_fd=clients[i];
+	}
+
+	/*No descriptor is left for accept()*/
+	struct rlimit saved;
+	TEST_CHECK(getrlimit(RLIMIT_NOFILE,&saved)==0);
+	struct rlimit limit=saved;
+	limit.rlim_cur=(rlim_t)max_fd+1;
+	TEST_CHECK(setrlimit(RLIMIT_NOFILE,&limit)==0);
+	unsigned polls=0;
+	uint64_t start=NowMs();
+	while(NowMs()-start<BUSY_MS)
+	{
+		TEST_CHECK(PollCliServer(&Server,POLL_MS)>=0);
+		polls++;
+	}
+	TEST_CHECK(polls<=BUSY_MS/POLL_MS+2);							/*Poll waits instead of reporting the listening socket again*/
+	TEST_CHECK(Server.stats.accept_pauses==1);
+	TEST_CHECK(AcceptErrors==1);
+	TEST_CHECK(Server.stats.accepted==0);
+	TEST_CHECK(Server.stats.sessions==0);
+
+	/*Descriptors are available again: pending peers are accepted after the pause*/
+	TEST_CHECK(setrlimit(RLIMIT_NOFILE,&saved)==0);
+	start=NowMs();
+	while((Server.stats.sessions<NUM_CLIENTS)&&(NowMs()-start<SIMCLI_SERVER_ACCEPT_PAUSE_MS+1000))
+		TEST_CHECK(PollCliServer(&Server,-1)>=0);
+	TEST_CHECK(Server.stats.sessions==NUM_CLIENTS);
+	TEST_CHECK(Server.stats.accepted==NUM_CLIENTS);
+	TEST_CHECK(Server.stats.accept_pauses==1);
+	TEST_CHECK(Server.accept_resume==0);
+
+	for(size_t i=0;i<NUM_CLIENTS;++i)
+		close(clients[i]);
+	CloseCliServer(&Server);
+	return TEST_RESULT();
+}
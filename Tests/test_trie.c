@@ -0,0 +1,118 @@
+/*
+ * test_trie.c
+ *
+ * Description: Names tree: CompleteCmdLine() candidates and common_len for unique and ambiguous
+ *              prefixes, abbreviated command and argument names in a session with attached tree.
+ *              This file is licensed under the MIT License.
+ */
+
+#include "simple_cli_trie.h"
+#include "test_util.h"
+
+#define MOUNT_ID 			1
+#define MOUNTSD_ID 			2
+#define MKDIR_ID 			3
+#define MAX_CANDIDATES 		4
+
+static cli_trie_t Trie;
+
+static uint32_t Size;
+static uint32_t Sync;
+static char Name[16];
+
+static bool MountCmd(char **argv, cli_command_t* self, CliContextManager_t * _context)
+{
+	(void)(_context);
+	self->args[0].value=&Size;
+	self->args[1].value=&Sync;
+	self->args[2].value=Name;
+	return ParseCmdArgs(argv,self)==SIM_CLI_OK;
+}
+
+static void Setup(void)
+{
+	cli_command_t commands[3]=
+	{
+		{
+			.cmd_name="mount", .c_func=MountCmd, .cmd_ID=MOUNT_ID, .args_num=3,
+			.args={{.arg_name="-size", .arg_type=ARG_UINT32},{.arg_name="-sync", .arg_type=ARG_UINT32},
+				{.arg_name="-name", .arg_type=ARG_STRING, .value_size=sizeof(Name)}}
+		},
+		{.cmd_name="mkdir", .c_func=MountCmd, .cmd_ID=MKDIR_ID},
+	};
+	commands[2]=commands[0];
+	strcpy(commands[2].cmd_name,"mountsd");
+	commands[2].cmd_ID=MOUNTSD_ID;
+	SetupSession(commands,3);
+	TEST_CHECK(BuildCliTrie(&Trie,&Registry));
+}
+
+static void TestCompleteCommand(void)
+{
+	const char* names[MAX_CANDIDATES];
+	size_t common;
+	TEST_CHECK(CompleteCmdLine(&Trie,"mo",names,MAX_CANDIDATES,&common)==2);	/*Ambiguous*/
+	TEST_CHECK((strcmp(names[0],"mount")==0)&&(strcmp(names[1],"mountsd")==0));
+	TEST_CHECK(common==5);
+	TEST_CHECK(CompleteCmdLine(&Trie,"m",names,MAX_CANDIDATES,&common)==3);
+	TEST_CHECK(common==1);
+	TEST_CHECK(CompleteCmdLine(&Trie,"m",names,1,NULL)==3);						/*Count of all matches*/
+	TEST_CHECK(CompleteCmdLine(&Trie,"  mk",names,MAX_CANDIDATES,&common)==1);	/*Unique*/
+	TEST_CHECK((strcmp(names[0],"mkdir")==0)&&(common==5));
+	TEST_CHECK(CompleteCmdLine(&Trie,"mountsd",names,MAX_CANDIDATES,&common)==1);
+	TEST_CHECK(common==7);
+	TEST_CHECK(CompleteCmdLine(&Trie,"x",names,MAX_CANDIDATES,&common)==0);
+	TEST_CHECK(common==0);
+}
+
+static void TestCompleteArg(void)
+{
+	const char* names[MAX_CANDIDATES];
+	size_t common;
+	TEST_CHECK(CompleteCmdLine(&Trie,"mountsd -s",names,MAX_CANDIDATES,&common)==2);
+	TEST_CHECK((strcmp(names[0],"-size")==0)&&(strcmp(names[1],"-sync")==0));
+	TEST_CHECK(common==2);
+	TEST_CHECK(CompleteCmdLine(&Trie,"mou -size 1 -n",names,MAX_CANDIDATES,&common)==0);	/*Ambiguous command*/
+	TEST_CHECK(CompleteCmdLine(&Trie,"mounts -size 1 -n",names,MAX_CANDIDATES,&common)==1);
+	TEST_CHECK((strcmp(names[0],"-name")==0)&&(common==5));
+	TEST_CHECK(CompleteCmdLine(&Trie,"mountsd ",names,MAX_CANDIDATES,&common)==3);
+	TEST_CHECK(common==1);
+	TEST_CHECK(CompleteCmdLine(&Trie,"mkdir -",names,MAX_CANDIDATES,&common)==0);	/*No arguments*/
+}
+
+static void TestMatch(void)
+{
+	const cli_command_t *mountsd=MatchTrieCmd(&Trie,"mounts");
+	TEST_CHECK(mountsd&&(mountsd->cmd_ID==MOUNTSD_ID));
+	TEST_CHECK(MatchTrieCmd(&Trie,"mou")==NULL);
+	TEST_CHECK(MatchTrieCmd(&Trie,"mount")->cmd_ID==MOUNT_ID);					/*Full name wins*/
+	TEST_CHECK(MatchTrieArg(&Trie,mountsd,"-si")==1);
+	TEST_CHECK(MatchTrieArg(&Trie,mountsd,"-sy")==2);
+	TEST_CHECK(MatchTrieArg(&Trie,mountsd,"-n")==3);
+	TEST_CHECK(MatchTrieArg(&Trie,mountsd,"-s")==0);
+}
+
+/*ParseCmdArgs() takes unique prefixes of argument names only when the session has the tree*/
+static void TestParseArgs(void)
+{
+	TEST_CHECK(ProcessCommand("mountsd -si 10 -n abc",&Session)==0);
+	AttachCliTrie(&Session,&Trie);
+	Size=Sync=0;
+	TEST_CHECK(ProcessCommand("mountsd -si 10 -sy 3 -n abc",&Session)==MOUNTSD_ID);
+	TEST_CHECK((Size==10)&&(Sync==3)&&(strcmp(Name,"abc")==0));
+	TEST_CHECK(ProcessCommand("mounts -size 20 -na x",&Session)==MOUNTSD_ID);
+	TEST_CHECK((Size==20)&&(strcmp(Name,"x")==0));
+	TEST_CHECK(ProcessCommand("mountsd -s 10",&Session)==0);					/*Ambiguous argument*/
+	TEST_CHECK(ProcessCommand("mountsd -sizes 10",&Session)==0);
+	AttachCliTrie(&Session,NULL);
+}
+
+int main(void)
+{
+	Setup();
+	TestCompleteCommand();
+	TestCompleteArg();
+	TestMatch();
+	TestParseArgs();
+	return TEST_RESULT();
+}
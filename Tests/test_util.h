@@ -0,0 +1,68 @@
+/*
+ * test_util.h
+ *
+ * Description: Check macro of unit tests. Failed checks are printed, test returns non-zero exit code.
+ *              Shared fixture: Session with commands of Registry, its output is captured in Output.
+ *              This file is licensed under the MIT License.
+ */
+
+#ifndef SIMPLE_CLI_TEST_UTIL_H
+#define SIMPLE_CLI_TEST_UTIL_H
+
+#include "stdio.h"
+#include "string.h"
+#include "simple_cli.h"
+
+static int test_failures;
+
+#define TEST_CHECK(cond) 																\
+	do{																					\
+		if(!(cond))																		\
+		{																				\
+			fprintf(stderr,"%s:%d: check failed: %s\n",__FILE__,__LINE__,#cond);		\
+			test_failures++;															\
+		}																				\
+	}while(0)
+
+#define TEST_RESULT() 		(test_failures?1:0)
+
+static cli_registry_t Registry;
+SIMPLE_CLI_DEF (Session);
+
+static char Output[256];										/*Session output, cut to buffer size*/
+static size_t OutputLen;
+
+static inline uint32_t CaptureWrite(const char* data, size_t length)
+{
+	if(length>sizeof(Output)-1-OutputLen)
+		length=sizeof(Output)-1-OutputLen;
+	memcpy(&Output[OutputLen],data,length);
+	OutputLen+=length;
+	Output[OutputLen]='\0';
+	return (uint32_t)length;
+}
+
+static inline uint32_t NullWrite(const char* data, size_t length)
+{
+	(void)(data);
+	return (uint32_t)length;
+}
+
+static inline void ClearOutput(void)
+{
+	OutputLen=0;
+	Output[0]='\0';
+}
+
+/*Adds commands to Registry, Session runs them with ProcessCommand() and writes to Output*/
+static inline void SetupSession(const cli_command_t *commands, size_t num)
+{
+	InitCliRegistry(&Registry);
+	for(size_t i=0;i<num;++i)
+		AddRegistryCommand(&Registry,&commands[i]);
+	InitCLIcontext(&Session,NULL,CaptureWrite,"Test");
+	AttachCliRegistry(&Session,&Registry);
+	ClearOutput();
+}
+
+#endif
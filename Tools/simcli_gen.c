@@ -0,0 +1,408 @@
+/*
+ * simcli_gen.c
+ *
+ * Description: Build time generator of const Simple CLI command tables.
+ *              Reads command set description and writes <name>.c and <name>.h with
+ *              cli_command_table_t object: command descriptions with compiled argument
+ *              index, perfect hash name index and ID index.
+ *
+ *              Usage: simcli_gen <spec file> <output dir> <table name>
+ *
+ *              Spec file format, one item per line, '#' starts a comment:
+ *              command <name> <ID> <function> "<info>" [<context handler> [<bulk handler>]]
+ *              arg <name> <type> [<value_size> | <enum list>]
+ *              cache <ttl ms> [<version counter>]
+ *              arg and cache lines belong to the last command. <type> is arg_type_t name, ARG_ENUM
+ *              takes the name of NULL-terminated "const char* const" array.
+ *
+ *              This file is licensed under the MIT License.
+ *              For more information, please refer to the LICENSE file.
+ */
+
+#include "stdio.h"
+#include "string.h"
+#include "simple_cli.h"
+
+#define GEN_MAX_COMMANDS 			1024
+#define GEN_MAX_LINE 				256
+#define GEN_NAME_SIZE 				64					/*Max length of C identifiers in spec*/
+#define GEN_SEED_ATTEMPTS 			100000				/*Seeds tried for each hash size*/
+#define GEN_MAX_HASH_SIZE 			65536
+
+typedef struct
+{
+	cli_command_t 	cmd;
+	uint8_t 		arg_index[SIMCLI_ARG_HASH_SIZE];
+	char 			function[GEN_NAME_SIZE];
+	char 			context_handler[GEN_NAME_SIZE];
+	char 			bulk_handler[GEN_NAME_SIZE];
+	char 			enum_list[SIMCLI_MAX_ARGS][GEN_NAME_SIZE];
+	char 			cache_version[GEN_NAME_SIZE];
+}gen_command_t;
+
+static gen_command_t commands[GEN_MAX_COMMANDS];
+static uint16_t num_commands;
+static uint16_t name_index[GEN_MAX_HASH_SIZE];
+
+static const char* const arg_type_names[]={"ARG_ONLY","ARG_INT32","ARG_STRING","ARG_UINT32","ARG_INT64",
+											"ARG_HEX","ARG_BOOL","ARG_ENUM","ARG_FLOAT","ARG_SIZE",NULL};
+
+static bool CopyName(char *dst, size_t size, const char *src)
+{
+	size_t len=strlen(src);
+	if(len>=size)
+		return false;
+	memcpy(dst,src,len+1);
+	return true;
+}
+
+static bool ParseCommandLine(cli_token_t *tokens, int num_tokens)
+{
+	if((num_tokens<5)||(num_tokens>7)||(num_commands>=GEN_MAX_COMMANDS))
+		return false;
+	gen_command_t *gen=&commands[num_commands];
+	char *end;
+	unsigned long id=strtoul(tokens[2].ptr,&end,0);
+	if((*end!='\0')||(id>255))
+		return false;
+	gen->cmd.cmd_ID=(uint8_t)id;
+	if(!CopyName(gen->cmd.cmd_name,sizeof(gen->cmd.cmd_name),tokens[1].ptr)||
+		!CopyName(gen->function,sizeof(gen->function),tokens[3].ptr)||
+		!CopyName(gen->cmd.cmd_info,sizeof(gen->cmd.cmd_info),tokens[4].ptr))
+		return false;
+	if((num_tokens>5)&&!CopyName(gen->context_handler,sizeof(gen->context_handler),tokens[5].ptr))
+		return false;
+	if((num_tokens>6)&&!CopyName(gen->bulk_handler,sizeof(gen->bulk_handler),tokens[6].ptr))
+		return false;
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		if(strcmp(commands[i].cmd.cmd_name,gen->cmd.cmd_name)==0)
+			return false;
+		if(gen->cmd.cmd_ID&&(commands[i].cmd.cmd_ID==gen->cmd.cmd_ID))
+			return false;
+	}
+	num_commands++;
+	return true;
+}
+
+static bool ParseArgLine(cli_token_t *tokens, int num_tokens)
+{
+	if((num_tokens<3)||(num_tokens>4)||(num_commands==0))
+		return false;
+	gen_command_t *gen=&commands[num_commands-1];
+	if(gen->cmd.args_num>=SIMCLI_MAX_ARGS)
+		return false;
+	cmd_arg_t *arg=&gen->cmd.args[gen->cmd.args_num];
+	if(!CopyName(arg->arg_name,sizeof(arg->arg_name),tokens[1].ptr))
+		return false;
+	uint8_t type=0;
+	while(arg_type_names[type]&&strcmp(arg_type_names[type],tokens[2].ptr))
+		++type;
+	if(arg_type_names[type]==NULL)
+		return false;
+	arg->arg_type=(arg_type_t)type;
+	if(arg->arg_type==ARG_ENUM)
+	{
+		if((num_tokens!=4)||!CopyName(gen->enum_list[gen->cmd.args_num],GEN_NAME_SIZE,tokens[3].ptr))
+			return false;
+	}
+	else if(num_tokens==4)
+	{
+		char *end;
+		unsigned long size=strtoul(tokens[3].ptr,&end,0);
+		if((*end!='\0')||(size>UINT16_MAX))
+			return false;
+		arg->value_size=(uint16_t)size;
+	}
+	gen->cmd.args_num++;
+	return true;
+}
+
+static bool ParseCacheLine(cli_token_t *tokens, int num_tokens)
+{
+	if((num_tokens<2)||(num_tokens>3)||(num_commands==0))
+		return false;
+	gen_command_t *gen=&commands[num_commands-1];
+	char *end;
+	unsigned long ttl=strtoul(tokens[1].ptr,&end,0);
+	if((*end!='\0')||(ttl>UINT32_MAX))
+		return false;
+	gen->cmd.cache_ttl=(uint32_t)ttl;
+	if((num_tokens==3)&&!CopyName(gen->cache_version,sizeof(gen->cache_version),tokens[2].ptr))
+		return false;
+	return ttl||gen->cache_version[0];
+}
+
+static bool ReadSpec(const char *path)
+{
+	FILE *spec=fopen(path,"r");
+	char line[GEN_MAX_LINE];
+	unsigned line_num=0;
+	if(spec==NULL)
+	{
+		fprintf(stderr,"simcli_gen: can't open %s\n",path);
+		return false;
+	}
+	while(fgets(line,sizeof(line),spec))
+	{
+		cli_token_t tokens[8];
+		++line_num;
+		char *comment=strchr(line,'#');
+		if(comment)
+			*comment='\0';
+		int num_tokens=TokenizeCmdLine(line,strlen(line),tokens,8);
+		bool ok=(num_tokens==0);
+		if(num_tokens>0)
+		{
+			if(strcmp(tokens[0].ptr,"command")==0)
+				ok=ParseCommandLine(tokens,num_tokens);
+			else if(strcmp(tokens[0].ptr,"arg")==0)
+				ok=ParseArgLine(tokens,num_tokens);
+			else if(strcmp(tokens[0].ptr,"cache")==0)
+				ok=ParseCacheLine(tokens,num_tokens);
+		}
+		if(!ok)
+		{
+			fprintf(stderr,"%s:%u: invalid command description\n",path,line_num);
+			fclose(spec);
+			return false;
+		}
+	}
+	fclose(spec);
+	for(uint16_t i=0;i<num_commands;++i)						/*Argument index is built by the library itself*/
+	{
+		cli_command_t *cmd=&commands[i].cmd;
+		if(!CompileCmdArgs(cmd,commands[i].arg_index))
+		{
+			fprintf(stderr,"simcli_gen: bad arguments of command %s\n",cmd->cmd_name);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool TrySeed(uint32_t seed, uint32_t hash_size)
+{
+	memset(name_index,0,hash_size*sizeof(name_index[0]));
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		uint32_t slot=CliHashName(commands[i].cmd.cmd_name,seed)&(hash_size-1);
+		if(name_index[slot])
+			return false;
+		name_index[slot]=(uint16_t)(i+1);
+	}
+	return true;
+}
+
+/*Finds seed that maps every command name to its own slot*/
+static bool FindPerfectHash(uint32_t *seed, uint32_t *hash_size)
+{
+	for(*hash_size=2;*hash_size<2u*num_commands;*hash_size*=2);
+	for(;*hash_size<=GEN_MAX_HASH_SIZE;*hash_size*=2)
+	{
+		*seed=SIMCLI_HASH_SEED;
+		for(uint32_t attempt=0;attempt<GEN_SEED_ATTEMPTS;++attempt)
+		{
+			if(TrySeed(*seed,*hash_size))
+				return true;
+			*seed=(*seed^attempt)*0x01000193u+0x9E3779B9u;
+		}
+	}
+	return false;
+}
+
+static bool IsDeclared(const char *symbol, uint16_t command, int field)
+{
+	for(uint16_t i=0;i<=command;++i)
+	{
+		const char *names[3]={commands[i].function,commands[i].context_handler,commands[i].bulk_handler};
+		for(int j=0;j<3;++j)
+		{
+			if((i==command)&&(j==field))
+				return false;
+			if(strcmp(names[j],symbol)==0)
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool IsEnumDeclared(uint16_t command, uint8_t arg)
+{
+	const char *symbol=commands[command].enum_list[arg];
+	for(uint16_t i=0;i<=command;++i)
+	{
+		for(uint8_t j=0;j<SIMCLI_MAX_ARGS;++j)
+		{
+			if((i==command)&&(j==arg))
+				return false;
+			if(strcmp(commands[i].enum_list[j],symbol)==0)
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool IsVersionDeclared(uint16_t command)
+{
+	for(uint16_t i=0;i<command;++i)
+	{
+		if(strcmp(commands[i].cache_version,commands[command].cache_version)==0)
+			return true;
+	}
+	return false;
+}
+
+static void WriteString(FILE *out, const char *str)
+{
+	fputc('"',out);
+	for(;*str;++str)
+	{
+		if((*str=='"')||(*str=='\\'))
+			fputc('\\',out);
+		fputc(*str,out);
+	}
+	fputc('"',out);
+}
+
+static void WriteDeclarations(FILE *out)
+{
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		const gen_command_t *gen=&commands[i];
+		if(!IsDeclared(gen->function,i,0))
+			fprintf(out,"bool %s(char **argv, cli_command_t* self, CliContextManager_t * _context);\n",gen->function);
+		if(gen->context_handler[0]&&!IsDeclared(gen->context_handler,i,1))
+			fprintf(out,"bool %s(char *data, size_t length, void * _context);\n",gen->context_handler);
+		if(gen->bulk_handler[0]&&!IsDeclared(gen->bulk_handler,i,2))
+			fprintf(out,"size_t %s(const cli_data_view_t *view, bool *complete, void * _context);\n",gen->bulk_handler);
+		for(uint8_t j=0;j<gen->cmd.args_num;++j)
+		{
+			if(gen->enum_list[j][0]&&!IsEnumDeclared(i,j))
+				fprintf(out,"extern const char* const %s[];\n",gen->enum_list[j]);
+		}
+		if(gen->cache_version[0]&&!IsVersionDeclared(i))
+			fprintf(out,"extern uint32_t %s;\n",gen->cache_version);
+	}
+}
+
+static void WriteCommands(FILE *out)
+{
+	fprintf(out,"\nstatic const cli_command_t commands[%u]=\n{\n",(unsigned)num_commands);
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		const gen_command_t *gen=&commands[i];
+		const cli_command_t *cmd=&gen->cmd;
+		fprintf(out,"\t{\n\t\t.cmd_name=");
+		WriteString(out,cmd->cmd_name);
+		fprintf(out,",\n\t\t.args_num=%u,\n",(unsigned)cmd->args_num);
+		if(cmd->args_num)
+			fprintf(out,"\t\t.args={");
+		for(uint8_t j=0;j<cmd->args_num;++j)
+		{
+			const cmd_arg_t *arg=&cmd->args[j];
+			fprintf(out,"%s\t{.arg_name=",j?",\n\t\t\t":"");
+			WriteString(out,arg->arg_name);
+			fprintf(out,", .arg_type=%s",arg_type_names[arg->arg_type]);
+			if(arg->value_size)
+				fprintf(out,", .value_size=%u",(unsigned)arg->value_size);
+			if(gen->enum_list[j][0])
+				fprintf(out,", .enum_list=%s",gen->enum_list[j]);
+			fprintf(out,"}");
+		}
+		if(cmd->args_num)
+			fprintf(out,"},\n");
+		fprintf(out,"\t\t.c_func=%s,\n\t\t.cmd_info=",gen->function);
+		WriteString(out,cmd->cmd_info);
+		fprintf(out,",\n\t\t.cmd_ID=%u,\n",(unsigned)cmd->cmd_ID);
+		if(gen->context_handler[0])
+			fprintf(out,"\t\t.cmd_context={.context_handler=%s, .bulk_handler=%s},\n",gen->context_handler,
+					gen->bulk_handler[0]?gen->bulk_handler:"NULL");
+		if(cmd->cache_ttl)
+			fprintf(out,"\t\t.cache_ttl=%u,\n",(unsigned)cmd->cache_ttl);
+		if(gen->cache_version[0])
+			fprintf(out,"\t\t.cache_version=&%s,\n",gen->cache_version);
+		fprintf(out,"\t}%s\n",(i+1<num_commands)?",":"");
+	}
+	fprintf(out,"};\n\nstatic const uint8_t arg_index[%u][SIMCLI_ARG_HASH_SIZE]=\n{\n",(unsigned)num_commands);
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		fprintf(out,"\t{");
+		for(uint8_t j=0;j<SIMCLI_ARG_HASH_SIZE;++j)
+			fprintf(out,"%s%u",j?",":"",(unsigned)commands[i].arg_index[j]);
+		fprintf(out,"}%s\n",(i+1<num_commands)?",":"");
+	}
+	fprintf(out,"};\n");
+}
+
+static void WriteIndex(FILE *out, const char *name, uint32_t seed, uint32_t hash_size)
+{
+	fprintf(out,"\nstatic const cli_cmd_hot_t hot[%u]=\n{\n",(unsigned)num_commands);
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		const cli_command_t *cmd=&commands[i].cmd;
+		fprintf(out,"\t{.c_func=%s, .name_hash=0x%08Xu, .cmd_ID=%u, .cmd_name=",commands[i].function,
+				(unsigned)CliHashName(cmd->cmd_name,seed),(unsigned)cmd->cmd_ID);
+		WriteString(out,cmd->cmd_name);
+		fprintf(out,"}%s\n",(i+1<num_commands)?",":"");
+	}
+	fprintf(out,"};\n\nstatic const uint16_t name_index[%u]=\n{",(unsigned)hash_size);
+	for(uint32_t i=0;i<hash_size;++i)
+		fprintf(out,"%s%u",(i%16)?",":(i?",\n\t":"\n\t"),(unsigned)name_index[i]);
+	fprintf(out,"\n};\n\nstatic const uint16_t id_index[256]=\n{\n");
+	for(uint16_t i=0;i<num_commands;++i)
+	{
+		if(commands[i].cmd.cmd_ID)
+			fprintf(out,"\t[%u]=%u,\n",(unsigned)commands[i].cmd.cmd_ID,(unsigned)(i+1));
+	}
+	fprintf(out,"};\n\nconst cli_command_table_t %s=\n{\n\t.count=%u,\n\t.hash_size=%u,\n\t.seed=0x%08Xu,\n"
+				"\t.name_index=name_index,\n\t.id_index=id_index,\n\t.hot=hot,\n\t.commands=commands,\n\t.arg_index=arg_index\n};\n",
+				name,(unsigned)num_commands,(unsigned)hash_size,(unsigned)seed);
+}
+
+static bool WriteTable(const char *dir, const char *name, const char *spec_path, uint32_t seed, uint32_t hash_size)
+{
+	char path[512];
+	snprintf(path,sizeof(path),"%s/%s.h",dir,name);
+	FILE *out=fopen(path,"w");
+	if(out==NULL)
+		return false;
+	fprintf(out,"/*Generated by simcli_gen from %s. Do not edit*/\n\n#ifndef %s_H\n#define %s_H\n\n"
+				"#include \"simple_cli.h\"\n\nextern const cli_command_table_t %s;\n\n#endif\n",spec_path,name,name,name);
+	fclose(out);
+
+	snprintf(path,sizeof(path),"%s/%s.c",dir,name);
+	out=fopen(path,"w");
+	if(out==NULL)
+		return false;
+	fprintf(out,"/*Generated by simcli_gen from %s. Do not edit*/\n\n#include \"%s.h\"\n\n",spec_path,name);
+	WriteDeclarations(out);
+	WriteCommands(out);
+	WriteIndex(out,name,seed,hash_size);
+	fclose(out);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t seed,hash_size;
+	if(argc!=4)
+	{
+		fprintf(stderr,"Usage: simcli_gen <spec file> <output dir> <table name>\n");
+		return 1;
+	}
+	if(!ReadSpec(argv[1]))
+		return 1;
+	if((num_commands==0)||!FindPerfectHash(&seed,&hash_size))
+	{
+		fprintf(stderr,"simcli_gen: no perfect hash for command set\n");
+		return 1;
+	}
+	const char *spec_name=strrchr(argv[1],'/');
+	if(!WriteTable(argv[2],argv[3],spec_name?spec_name+1:argv[1],seed,hash_size))
+	{
+		fprintf(stderr,"simcli_gen: can't write %s/%s\n",argv[2],argv[3]);
+		return 1;
+	}
+	return 0;
+}